@@ -30,3 +30,19 @@ CFeature::~CFeature()
 {
 	// TODO Auto-generated destructor stub
 }
+
+/// Fills `descriptor` with a flat description of this feature. Returns false
+/// if the feature cannot be described this way, in which case models must
+/// fall back to calling `apply`.
+bool CFeature::getDescriptor(CFeatureDescriptor & descriptor)
+{
+	return false;
+}
+
+/// Returns true if this feature should be evaluated per-fragment by the
+/// model's shader rather than being applied to the pixel temperatures.
+/// Models which cannot do so will call `apply` instead.
+bool CFeature::isAnalytic()
+{
+	return false;
+}
@@ -28,6 +28,18 @@ using namespace std;
 
 class CModel;
 
+/// \brief A flat description of a feature's effect on a model's surface.
+///
+/// The center and extent are given in the model's generalized coordinates
+/// (see `CModel::FindPixels`). Models which own a pixelated surface use these
+/// descriptors to apply every feature in a single pass over their pixels.
+struct CFeatureDescriptor
+{
+	double s0, s1, s2;		///< Center of the feature in generalized coordinates
+	double ds0, ds1, ds2;	///< Extent of the feature in generalized coordinates
+	double delta_T;			///< Temperature offset applied to covered pixels (kelvin)
+};
+
 class CFeature: public CParameterMap
 {
 public:
@@ -35,6 +47,8 @@ public:
 	virtual ~CFeature();
 
 	virtual void apply(CModel * model) = 0;
+	virtual bool getDescriptor(CFeatureDescriptor & descriptor);
+	virtual bool isAnalytic();
 };
 
 #endif /* CFEATURE_H_ */
@@ -0,0 +1,88 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#include "CFraming.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+const unsigned int CFraming::MinSize;
+const unsigned int CFraming::MaxSize;
+
+// Conversion from milliarcseconds to radians
+static const double MAS_TO_RAD = M_PI / (180.0 * 3600.0 * 1000.0);
+
+CFraming::CFraming()
+{
+	width = 0;
+	height = 0;
+	scale = 0;
+	error = 0;
+}
+
+/// Computes the framing for data sampling spatial frequencies [u_min, u_max]
+/// (wavelengths) and models enclosed by a circle of radius `extent` (mas)
+/// about the origin, or a negative extent if the models are unbounded.
+///
+/// If the field of view would need more than MaxSize pixels the scale is
+/// coarsened to fit, which increases the error.
+CFraming CFraming::Create(double u_min, double u_max, double extent,
+		double margin, double padding)
+{
+	if(u_max <= 0 || margin <= 0)
+		throw runtime_error("Auto-framing requires data which samples spatial frequencies and a positive margin.");
+
+	if(extent < 0 && u_min <= 0)
+		throw runtime_error("Auto-framing requires bounded models or the shortest baseline of the data.");
+
+	CFraming framing;
+	framing.scale = 1 / (2 * margin * u_max) / MAS_TO_RAD;
+
+	const double field = (extent >= 0) ? 2 * extent * padding : margin / u_min / MAS_TO_RAD;
+	unsigned int size = ceil(field / framing.scale);
+	size += size % 2;
+	size = max(size, MinSize);
+
+	if(size > MaxSize)
+	{
+		size = MaxSize;
+		framing.scale = field / size;
+	}
+
+	framing.width = size;
+	framing.height = size;
+
+	const double x = M_PI * u_max * framing.scale * MAS_TO_RAD;
+	framing.error = 1 - sin(x) / x;
+
+	return framing;
+}
+
+/// Returns a one-line description of the framing.
+string CFraming::Describe() const
+{
+	stringstream output;
+	output << "Auto-framing: " << width << " x " << height << " pixels at "
+		   << scale << " mas/pixel (field of view " << width * scale << " mas), "
+		   << "expected visibility error " << error << " at the longest baseline.";
+
+	return output.str();
+}
@@ -0,0 +1,59 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#ifndef CFRAMING_H_
+#define CFRAMING_H_
+
+#include <string>
+
+using namespace std;
+
+/// \brief An image size and pixel scale chosen from the (u,v) coverage of the
+/// data and the extent of the models (auto-framing).
+///
+/// The pixel scale samples the longest baseline `margin` times more finely
+/// than the Nyquist limit, scale = 1 / (2 margin u_max). The field of view
+/// encloses the models with `padding` to spare. If the models are unbounded
+/// the field of view is instead `margin` times the largest angular scale
+/// probed by the data, 1 / u_min. Images are square with an even number of
+/// pixels.
+///
+/// The expected error is the fractional loss of visibility amplitude at the
+/// longest baseline due to the finite pixel size, 1 - sinc(pi u_max scale).
+class CFraming
+{
+public:
+	static const unsigned int MinSize = 16;
+	static const unsigned int MaxSize = 4096;
+
+	unsigned int width;
+	unsigned int height;
+	double scale;	///< mas per pixel
+	double error;
+
+public:
+	CFraming();
+
+	static CFraming Create(double u_min, double u_max, double extent,
+			double margin, double padding = 1.2);
+
+	string Describe() const;
+};
+
+#endif /* CFRAMING_H_ */
@@ -38,9 +38,11 @@ CModel::CModel()
 
 	// Shader storage location, boolean if it is loaded:
 	mShader = CShaderPtr();
+	mLDLaw = LDL_NONE;
 	mFluxTextureID = 0;
 	mTime = 0;
 	mWavelength = 1.65e-6;	// H-band (meters)
+	mImageScale = 0;
 	mZAxisRotationDelta = 0;
 	mModelReady = false;
 
@@ -73,6 +75,33 @@ void CModel::AddFeature(string feature_id)
 		mFeatures.push_back(feature);
 }
 
+/// \brief Adds this model's visibilities at the (u,v) points to `vis`.
+///
+/// The visibilities from `GetAnalyticVisibilities` are shifted to the
+/// model's position on the sky. (u,v) are in units of wavelengths.
+/// Returns the total flux of the model.
+double CModel::AddVisibilities(const vector<pair<double,double> > & uv,
+		vector<complex<double> > & vis)
+{
+	// Conversion from milliarcseconds to radians
+	const double mas_to_rad = PI / (180.0 * 3600.0 * 1000.0);
+
+	double x = 0, y = 0, z = 0;
+	if(mPosition != NULL)
+		mPosition->GetXYZ(x, y, z);
+
+	vector<complex<double> > model_vis(uv.size());
+	double flux = GetAnalyticVisibilities(uv, model_vis);
+
+	for(unsigned int i = 0; i < uv.size(); i++)
+	{
+		const double phase = -2 * PI * (uv[i].first * x + uv[i].second * y) * mas_to_rad;
+		vis[i] += model_vis[i] * polar(1.0, phase);
+	}
+
+	return flux;
+}
+
 /// \breif Function for finding the IDs of pixels within the bounds
 /// (s0, s1, s2) +/- (ds0, ds1, ds2)
 /// where (s0, s1, s2) are the generalized coordinates in the model's
@@ -85,6 +114,116 @@ void CModel::FindPixels(double s0, double s1, double s2,
 }
 
 
+/// \brief Computes the flux of the model integrated over the sky.
+///
+/// The flux is in units of the (un-normalized) surface brightness from
+/// `TemperatureToFlux` times area in square milliarcseconds. Dividing by the
+/// square of the image scale gives the total flux of a rendered image.
+/// Only models for which `HasAnalyticFlux` is true implement this function.
+double CModel::GetAnalyticFlux()
+{
+	return 0;
+}
+
+/// \brief Computes the complex visibilities of the model, centered at the
+/// origin, at the (u,v) points (in units of wavelengths).
+///
+/// The visibilities are not normalized, that is V(0,0) is the total flux of
+/// the model. Returns the total flux. Only models for which
+/// `HasAnalyticVisibility` is true implement this function.
+double CModel::GetAnalyticVisibilities(const vector<pair<double,double> > & uv,
+		vector<complex<double> > & vis)
+{
+	for(auto & value: vis)
+		value = complex<double>(0, 0);
+
+	return 0;
+}
+
+/// \brief Computes the flux of the model hidden behind an opaque disk.
+///
+/// The disk has the specified radius (mas) and is centered at (x, y) (mas)
+/// relative to the model's position on the sky. The flux is in the units of
+/// `GetAnalyticFlux`. Only models for which `HasAnalyticOccultation` is true
+/// implement this function.
+double CModel::GetOccultedFlux(double x, double y, double radius)
+{
+	return 0;
+}
+
+/// \brief Returns the radius (mas) of a sphere, centered on the model's
+/// position, which encloses the entire model. A negative value indicates the
+/// model is unbounded (or the bound is unknown) and must always be rendered.
+double CModel::GetBoundingRadius()
+{
+	return -1;
+}
+
+/// \brief Computes a conservative window-space bounding box of the model.
+///
+/// The bounding sphere (see `GetBoundingRadius`) is projected through `view`
+/// onto the `viewport` (x, y, width, height). The box is returned as
+/// (x_min, y_min, x_max, y_max) in pixels. Returns false if the model is
+/// unbounded.
+bool CModel::GetScreenBounds(const glm::mat4 & view, const GLint viewport[4], vec4 & bounds)
+{
+	const double radius = GetBoundingRadius();
+	if(radius < 0)
+		return false;
+
+	double x = 0, y = 0, z = 0;
+	if(mPosition != NULL)
+		mPosition->GetXYZ(x, y, z);
+
+	vec4 center = view * vec4(x, y, z, 1.0);
+	center /= center.w;
+
+	// Extent of the sphere along the x and y axes in normalized device
+	// coordinates. Use the length of the rows so rotated views are covered.
+	const float r_x = radius * sqrt(view[0][0] * view[0][0] + view[1][0] * view[1][0] + view[2][0] * view[2][0]);
+	const float r_y = radius * sqrt(view[0][1] * view[0][1] + view[1][1] * view[1][1] + view[2][1] * view[2][1]);
+
+	// Convert to pixels, padding by one pixel for rasterization.
+	const float half_width = 0.5 * viewport[2];
+	const float half_height = 0.5 * viewport[3];
+	bounds.x = viewport[0] + (center.x - r_x + 1) * half_width - 1;
+	bounds.y = viewport[1] + (center.y - r_y + 1) * half_height - 1;
+	bounds.z = viewport[0] + (center.x + r_x + 1) * half_width + 1;
+	bounds.w = viewport[1] + (center.y + r_y + 1) * half_height + 1;
+
+	return true;
+}
+
+/// \brief Returns true if the model's flux can be computed without rendering,
+/// see `GetAnalyticFlux`.
+bool CModel::HasAnalyticFlux()
+{
+	return false;
+}
+
+/// \brief Returns true if the model's silhouette on the sky is a disk of radius
+/// `GetBoundingRadius()` and `GetOccultedFlux` is implemented. Such models can
+/// eclipse one another without being rendered.
+bool CModel::HasAnalyticOccultation()
+{
+	return false;
+}
+
+/// \brief Returns true if the shader implements a limb darkening law which
+/// `Intensity` can evaluate (including the uniform, default, shader).
+bool CModel::HasAnalyticLimbDarkening()
+{
+	UpdateLimbDarkening();
+	return mLDLaw != LDL_NONE;
+}
+
+/// \brief Returns true if the model's visibilities have a closed form, in which
+/// case the model need not be rendered to compute interferometric quantities.
+bool CModel::HasAnalyticVisibility()
+{
+	return false;
+}
+
 /// \brief Static function which creates a lookup table of sine and cosine values
 /// 	used in drawing things in polar coordinates.
 ///
@@ -326,11 +465,17 @@ string CModel::ID()
 /// where (x,y,z) is the position, (n_x, n_y, n_z) are the normals and
 /// (t_x, t_y, t_z) are the texture coordinates.
 /// All values are assumed to be floating point values.
-void CModel::InitShaderVariables()
+///
+/// The locations are looked up in `shader`, or in the model's shader if none
+/// is given.
+void CModel::InitShaderVariables(CShaderPtr shader)
 {
+	if(!shader)
+		shader = mShader;
+
 	// Next we need to define the storage format for this object for the shader.
 	// First get the shader and activate it
-	GLuint shader_program = mShader->GetProgram();
+	GLuint shader_program = shader->GetProgram();
 	glUseProgram(shader_program);
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to activate OpenGL shader");
 
@@ -385,7 +530,7 @@ void CModel::InitTexture()
 		mFluxTexture[i].r = float(i) / mFluxTexture.size();
 		mFluxTexture[i].a = 1.0;
 	}
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, mFluxTexture.size(), 1, 0, GL_RGBA,
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, mFluxTexture.size(), 1, 0, GL_RGBA,
 			GL_FLOAT, &mFluxTexture[0]);
 
 	// Set wrapping and lookup filters
@@ -402,6 +547,31 @@ void CModel::InitTexture()
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to bind back to default buffer.");
 }
 
+/// Evaluates the limb darkening law at mu = cos(theta). The expressions
+/// match those in the `ldl_*` fragment shaders.
+double CModel::Intensity(double mu)
+{
+	const vector<double> & a = mLDCoefficients;
+
+	switch(mLDLaw)
+	{
+	case LDL_CLARET2000:
+		return 1 - a[0] * (1 - sqrt(mu)) - a[1] * (1 - mu) - a[2] * (1 - pow(mu, 1.5)) - a[3] * (1 - mu * mu);
+	case LDL_FIELDS2003:
+		return 1 - a[0] * (1 - 1.5 * mu) - a[1] * (1 - 2.5 * sqrt(mu));
+	case LDL_LOGARITHMIC:
+		return 1 - a[0] * (1 - mu) - a[1] * (mu > 0 ? mu * log(mu) : 0);
+	case LDL_POWER_LAW:
+		return pow(mu, a[0]);
+	case LDL_QUADRATIC:
+		return 1 - a[0] * (1 - mu) - a[1] * (1 - mu) * (1 - mu);
+	case LDL_SQUARE_ROOT:
+		return 1 - a[0] * (1 - mu) - a[1] * (1 - sqrt(mu));
+	default:
+		return 1;
+	}
+}
+
 void CModel::NormalizeFlux(double max_flux)
 {
 	for(int i = 0; i < mFluxTexture.size(); i++)
@@ -464,7 +634,7 @@ glm::mat4 CModel::Rotate()
 void CModel::Restore(Json::Value input)
 {
 	// Restore the base parameters
-	CParameterMap::restore(input["base_data"]);
+	restore(input["base_data"]);
 
 	auto shaders = CShaderFactory::Instance();
 
@@ -622,6 +792,55 @@ void CModel::SetPositionModel(CPositionPtr position)
 	mPosition = position;
 }
 
+/// \brief Sets the size of an image pixel (mas). Models may use this to
+/// choose an appropriate level of detail.
+void CModel::SetImageScale(double scale)
+{
+	assert(scale >= 0);
+	mImageScale = scale;
+}
+
+/// \brief Returns the period (days) on which the model's appearance repeats.
+///
+/// Returns zero if the model does not depend on time and -1 if it is time
+/// dependent, but not periodic. Considers the position and the rotation about
+/// the z-axis.
+double CModel::GetPeriod()
+{
+	double period = 0;
+	if(mPosition != NULL)
+		period = mPosition->GetPeriod();
+
+	return CombinePeriods(period, mParams["z_axis_rotational_period"].getValue());
+}
+
+/// \brief Returns the period of two combined periodic processes.
+///
+/// A period of zero means "not time dependent", -1 means "not periodic".
+/// Only equal periods are considered periodic.
+double CModel::CombinePeriods(double a, double b)
+{
+	if(a < 0 || b < 0)
+		return -1;
+	if(a == 0)
+		return b;
+	if(b == 0)
+		return a;
+	if(fabs(a - b) <= 1E-9 * max(a, b))
+		return a;
+
+	return -1;
+}
+
+/// \brief Sets the times at which the model will be rendered.
+///
+/// Forwarded to the position so that orbits may be solved for all epochs at once.
+void CModel::SetEpochs(const vector<double> & epochs)
+{
+	if(mPosition != NULL)
+		mPosition->SetEpochs(epochs);
+}
+
 /// \brief Sets the time at which the model should be rendered.
 ///
 /// Sets the time for the current model. Internally this updates any time-dependent
@@ -733,6 +952,9 @@ void CModel::TemperatureToFlux(const vector<double> & temperatures, vector<vec4>
 			max_flux = flux;
 
 		fluxes[i].r = flux;
+		// The temperature is kept for shaders which modify the flux (e.g. analytic spots).
+		// Flux textures are stored as GL_RGBA32F so it is not clamped to [0,1].
+		fluxes[i].g = temperatures[i];
 	}
 }
 
@@ -744,3 +966,55 @@ glm::mat4 CModel::Translate()
 
 	return glm::translate(mat4(1.0f), vec3(x, y, z));
 }
+
+/// Caches the limb darkening law and coefficients of the shader. The law
+/// and the coefficients' parameters are only looked up when the shader is
+/// replaced, afterwards the coefficients are copied without string lookups.
+void CModel::UpdateLimbDarkening()
+{
+	if(mShader != mLDShader)
+	{
+		mLDShader = mShader;
+		mLDLaw = LDL_NONE;
+		mLDParameters.clear();
+
+		if(mShader != NULL)
+		{
+			const string law = mShader->ID();
+			vector<string> names;
+			if(law == "default")
+				mLDLaw = LDL_UNIFORM;
+			else if(law == "ldl_claret2000")
+			{
+				mLDLaw = LDL_CLARET2000;
+				names = {"a1", "a2", "a3", "a4"};
+			}
+			else if(law == "ldl_fields2003")
+			{
+				mLDLaw = LDL_FIELDS2003;
+				names = {"Gamma", "Alpha"};
+			}
+			else if(law == "ldl_power_law")
+			{
+				mLDLaw = LDL_POWER_LAW;
+				names = {"alpha"};
+			}
+			else if(law == "ldl_logarithmic")
+				mLDLaw = LDL_LOGARITHMIC;
+			else if(law == "ldl_quadratic")
+				mLDLaw = LDL_QUADRATIC;
+			else if(law == "ldl_square_root")
+				mLDLaw = LDL_SQUARE_ROOT;
+
+			if(mLDLaw == LDL_LOGARITHMIC || mLDLaw == LDL_QUADRATIC || mLDLaw == LDL_SQUARE_ROOT)
+				names = {"a1", "a2"};
+
+			for(auto name: names)
+				mLDParameters.push_back(&mShader->getParameter(name));
+		}
+	}
+
+	mLDCoefficients.resize(mLDParameters.size());
+	for(unsigned int i = 0; i < mLDParameters.size(); i++)
+		mLDCoefficients[i] = mLDParameters[i]->getValue();
+}
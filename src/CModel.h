@@ -34,6 +34,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cassert>
+#include <complex>
 #include <memory>
 
 // OpenGL Math Library code.
@@ -76,10 +77,26 @@ typedef shared_ptr<CFeature> CFeaturePtr;
 /// values of model parameters.
 class CModel: public CParameterMap
 {
+public:
+	/// Limb darkening laws which `Intensity` can evaluate. LDL_NONE denotes
+	/// a shader which has no analytic intensity profile.
+	enum LimbDarkeningLaws
+	{
+		LDL_NONE,
+		LDL_UNIFORM,
+		LDL_CLARET2000,
+		LDL_FIELDS2003,
+		LDL_LOGARITHMIC,
+		LDL_POWER_LAW,
+		LDL_QUADRATIC,
+		LDL_SQUARE_ROOT
+	};
+
 protected:
 
 	double mTime;		///< The current time for this object (days)
 	double mWavelength; ///< The current wavelength of observation (meters)
+	double mImageScale; ///< The size of an image pixel (mas), zero if unknown
 	double mZAxisRotationDelta; ///< A delta applied to the rotation about the z-axis, set by SetTime
 
 	CPositionPtr mPosition;	///< A shared pointer to the position object.
@@ -93,6 +110,14 @@ protected:
 
 	vector<CFeaturePtr> mFeatures;
 
+	// Limb darkening law and its coefficients, used when computing fluxes and
+	// visibilities analytically. The law is looked up when the shader is
+	// replaced, the coefficients are read through mLDParameters.
+	CShaderPtr mLDShader;
+	LimbDarkeningLaws mLDLaw;
+	vector<const CParameter *> mLDParameters;
+	vector<double> mLDCoefficients;
+
 	bool mModelReady;
 
 protected:
@@ -123,22 +148,38 @@ public:
 	virtual ~CModel();
 
 	void AddFeature(string feature_id);
+	double AddVisibilities(const vector<pair<double,double> > & uv, vector<complex<double> > & vis);
 
 	int GetNModelFreeParameters();
 	int GetNPositionFreeParameters();
 	int GetNShaderFreeParameters();
 	int GetNFeatureFreeParameters();
 	vector<double> & GetPixelTemperatures();
+	double GetPeriod();
+	static double CombinePeriods(double a, double b);
 	CPositionPtr GetPosition(void);
 	CShaderPtr GetShader(void);
 
+	virtual double GetBoundingRadius();
+	bool GetScreenBounds(const glm::mat4 & view, const GLint viewport[4], vec4 & bounds);
+
+	virtual double GetAnalyticFlux();
+	virtual double GetAnalyticVisibilities(const vector<pair<double,double> > & uv,
+			vector<complex<double> > & vis);
+	virtual double GetOccultedFlux(double x, double y, double radius);
+	virtual bool HasAnalyticFlux();
+	virtual bool HasAnalyticOccultation();
+	virtual bool HasAnalyticVisibility();
+
 	const vector<CFeaturePtr> & GetFeatures() const;;
 
 	int GetTotalFreeParameters();
 
 protected:
+	bool HasAnalyticLimbDarkening();
 	virtual void InitTexture();
-	virtual void InitShaderVariables();
+	virtual void InitShaderVariables(CShaderPtr shader = CShaderPtr());
+	double Intensity(double mu);
 
 public:
 	void NormalizeFlux(double max_flux);
@@ -146,10 +187,10 @@ public:
 public:
 	virtual void preRender(double & max_flux) = 0;
 	virtual void Render(const glm::mat4 & view, const GLfloat & max_flux) = 0;
-	void Restore(Json::Value input);
+	virtual void Restore(Json::Value input);
 
 public:
-	Json::Value Serialize();
+	virtual Json::Value Serialize();
 
 	virtual void SetFeatures(vector<CFeaturePtr> & features);
 	void SetPositionModel(string position_id);
@@ -157,10 +198,13 @@ public:
 	virtual void SetShader(string shader_id);
 	virtual void SetShader(CShaderPtr shader);
 
+	void SetEpochs(const vector<double> & epochs);
+	void SetImageScale(double scale);
 	virtual void SetTime(double time);
 	void SetWavelength(double wavelength);
 protected:
 	void SetupMatrix();
+	void UpdateLimbDarkening();
 
 public:
 	static void TemperatureToFlux(const vector<double> & temperatures, vector<float> & fluxes,
@@ -21,6 +21,8 @@
 
 #include <sstream>
 #include <algorithm>
+#include <limits>
+#include <iostream>
 
 #include "CModel.h"
 #include "CModelFactory.h"
@@ -32,6 +34,10 @@ using namespace std;
 CModelList::CModelList()
 {
 	mTime = 0;
+	mImageScale = 0;
+
+	// Nothing has been drawn yet.
+	fill(mOccupiedRegion, mOccupiedRegion + 4, 0);
 }
 
 CModelList::~CModelList()
@@ -42,6 +48,7 @@ CModelList::~CModelList()
 /// \brief Adds a new model to the list
 void CModelList::AddModel(CModelPtr model)
 {
+	model->SetImageScale(mImageScale);
 	mModels.push_back(model);
 }
 
@@ -120,6 +127,14 @@ void CModelList::GetFreeParameterSteps(double * steps, unsigned int size)
 	}
 }
 
+/// Returns the region (x, y, width, height), in pixels, in which models were
+/// drawn during the last call to Render. Pixels outside of this region are
+/// zero. The region is empty if no model was visible.
+void CModelList::GetOccupiedRegion(GLint region[4])
+{
+	copy(mOccupiedRegion, mOccupiedRegion + 4, region);
+}
+
 /// Returns a vector of string containing the parameter names.
 vector<string> CModelList::GetFreeParamNames()
 {
@@ -136,14 +151,279 @@ vector<string> CModelList::GetFreeParamNames()
     return tmp1;
 }
 
+/// \brief Returns the radius (mas) of a circle, centered on the origin of the
+/// sky plane, which encloses every model at the current time.
+///
+/// Returns -1 if a model is unbounded (see `CModel::GetBoundingRadius`) or if
+/// there are no models.
+double CModelList::GetExtent()
+{
+	if(mModels.size() == 0)
+		return -1;
+
+	double extent = 0;
+	for(auto model: mModels)
+	{
+		const double radius = model->GetBoundingRadius();
+		if(radius < 0)
+			return -1;
+
+		double x = 0, y = 0, z = 0;
+		model->GetPosition()->GetXYZ(x, y, z);
+		extent = max(extent, sqrt(x * x + y * y) + radius);
+	}
+
+	return extent;
+}
+
+/// \brief Returns the radius (mas) of a circle, centered on the origin of the
+/// sky plane, which encloses every model at all of the epochs (JD).
+///
+/// Uses the current time if there are no epochs, and restores the current
+/// time afterwards. Returns -1 if a model is unbounded or if there are no
+/// models, see `GetExtent()`.
+double CModelList::GetExtent(const vector<double> & epochs)
+{
+	if(epochs.size() == 0)
+		return GetExtent();
+
+	// Observations are often clustered, there is no need to repeat epochs.
+	set<double> unique_epochs(epochs.begin(), epochs.end());
+
+	const double time = mTime;
+	double extent = 0;
+	for(auto jd: unique_epochs)
+	{
+		SetTime(jd);
+		const double epoch_extent = GetExtent();
+		if(epoch_extent < 0)
+		{
+			extent = -1;
+			break;
+		}
+
+		extent = max(extent, epoch_extent);
+	}
+
+	SetTime(time);
+	return extent;
+}
+
+/// \brief Computes the total flux of all models without rendering them.
+///
+/// Only valid if `HasAnalyticFlux()` is true. The flux is expressed in the
+/// same units as the total flux of a rendered image (brightness per image
+/// pixel), thus magnitudes computed from either agree. Eclipses are
+/// computed from the sky-plane separation of the models.
+double CModelList::GetFlux()
+{
+	vector<pair<CModelPtr, CModelPtr> > eclipses;
+	FindEclipses(eclipses);
+
+	return GetFlux(eclipses);
+}
+
+/// \brief Computes the total flux of all models at each of the epochs (JD)
+/// without rendering them.
+///
+/// The flux at an epoch for which the eclipses cannot be computed analytically
+/// (see `FindEclipses`) is set to NaN, such epochs must be rendered. Returns
+/// false if any epoch, or all epochs if `HasAnalyticFlux()` fails for a
+/// model, could not be computed. The time is left at the last epoch.
+bool CModelList::GetFlux(const vector<double> & jds, vector<double> & flux)
+{
+	flux.assign(jds.size(), numeric_limits<double>::quiet_NaN());
+	if(!HasAnalyticModelFlux())
+		return false;
+
+	bool all_analytic = true;
+	vector<pair<CModelPtr, CModelPtr> > eclipses;
+	for(unsigned int i = 0; i < jds.size(); i++)
+	{
+		SetTime(jds[i]);
+		if(FindEclipses(eclipses))
+			flux[i] = GetFlux(eclipses);
+		else
+			all_analytic = false;
+	}
+
+	return all_analytic;
+}
+
+/// \brief Computes the total flux of all models at the current time without
+/// rendering them, if possible.
+///
+/// Returns false if the flux cannot be computed analytically at this time, in
+/// which case the models must be rendered. This replaces calling
+/// `HasAnalyticFlux()` followed by `GetFlux()`, which finds the eclipses twice.
+bool CModelList::GetAnalyticFlux(double & flux)
+{
+	vector<pair<CModelPtr, CModelPtr> > eclipses;
+	if(!HasAnalyticModelFlux() || !FindEclipses(eclipses))
+		return false;
+
+	flux = GetFlux(eclipses);
+	return true;
+}
+
+/// Sums the analytic fluxes of the models, less the flux hidden by the
+/// (front, back) pairs found by `FindEclipses`, see `GetFlux()`.
+double CModelList::GetFlux(const vector<pair<CModelPtr, CModelPtr> > & eclipses)
+{
+	double total_flux = 0;
+	for(auto model: mModels)
+		total_flux += model->GetAnalyticFlux();
+
+	for(auto & eclipse: eclipses)
+	{
+		double front_x, front_y, back_x, back_y, z;
+		eclipse.first->GetPosition()->GetXYZ(front_x, front_y, z);
+		eclipse.second->GetPosition()->GetXYZ(back_x, back_y, z);
+
+		total_flux -= eclipse.second->GetOccultedFlux(front_x - back_x, front_y - back_y,
+				eclipse.first->GetBoundingRadius());
+	}
+
+	for(auto model: mModels)
+		model->clearFlags();
+
+	if(mImageScale > 0)
+		total_flux /= mImageScale * mImageScale;
+
+	return total_flux;
+}
+
+/// \brief Computes the normalized complex visibilities of all models at the
+/// specified (u,v) points (in units of wavelengths).
+///
+/// Only valid if `HasAnalyticVisibility()` is true. Each model contributes
+/// its visibilities weighted by its flux and shifted to its position.
+void CModelList::GetVisibilities(const vector<pair<double,double> > & uv,
+		vector<complex<double> > & vis)
+{
+	vis.assign(uv.size(), complex<double>(0, 0));
+
+	double total_flux = 0;
+	for(auto model: mModels)
+	{
+		total_flux += model->AddVisibilities(uv, vis);
+		model->clearFlags();
+	}
+
+	if(total_flux > 0)
+	{
+		for(auto & value: vis)
+			value /= total_flux;
+	}
+}
+
 /// Returns a pair of model names, and their enumerated types
 vector<string> CModelList::GetTypes(void)
 {
 	return CModelFactory::getInstance().getIDs();
 }
 
+/// \brief Finds the pairs of models which overlap on the sky at the current time.
+///
+/// Each pair is stored as (front, back), the z-ordering follows `SortByZ`.
+/// Returns false if the overlaps cannot be computed analytically, that is if
+/// an overlapping model is unbounded or does not have a disk-shaped
+/// silhouette, or if a model is eclipsed by more than one other model.
+bool CModelList::FindEclipses(vector<pair<CModelPtr, CModelPtr> > & eclipses)
+{
+	eclipses.clear();
+
+	// Front to back, as in Render
+	vector<CModelPtr> models = mModels;
+	sort(models.begin(), models.end(), SortByZ);
+
+	vector<double> x(models.size(), 0);
+	vector<double> y(models.size(), 0);
+	vector<double> radii(models.size(), 0);
+	for(unsigned int i = 0; i < models.size(); i++)
+	{
+		double z = 0;
+		models[i]->GetPosition()->GetXYZ(x[i], y[i], z);
+		radii[i] = models[i]->GetBoundingRadius();
+	}
+
+	for(unsigned int j = 1; j < models.size(); j++)
+	{
+		unsigned int n_eclipses = 0;
+		for(unsigned int i = 0; i < j; i++)
+		{
+			if(radii[i] < 0 || radii[j] < 0)
+				return false;
+
+			const double dx = x[i] - x[j];
+			const double dy = y[i] - y[j];
+			if(sqrt(dx * dx + dy * dy) >= radii[i] + radii[j])
+				continue;
+
+			if(!models[i]->HasAnalyticOccultation() || !models[j]->HasAnalyticOccultation())
+				return false;
+
+			// The regions hidden by two occulters may overlap.
+			if(++n_eclipses > 1)
+				return false;
+
+			eclipses.push_back(make_pair(models[i], models[j]));
+		}
+	}
+
+	return true;
+}
+
+/// \brief Returns true if the flux of every model in the list can be computed
+/// without rendering.
+///
+/// Models may eclipse one another only if their silhouettes are disks, see
+/// `FindEclipses`.
+bool CModelList::HasAnalyticFlux()
+{
+	vector<pair<CModelPtr, CModelPtr> > eclipses;
+	return HasAnalyticModelFlux() && FindEclipses(eclipses);
+}
+
+/// Returns true if the flux of every model, taken by itself, can be computed
+/// without rendering. Unlike `HasAnalyticFlux` this does not depend on time.
+bool CModelList::HasAnalyticModelFlux()
+{
+	if(mModels.size() == 0)
+		return false;
+
+	for(auto model: mModels)
+	{
+		if(!model->HasAnalyticFlux())
+			return false;
+	}
+
+	return true;
+}
+
+/// \brief Returns true if every model in the list has closed-form
+/// visibilities, in which case no image needs to be rendered.
+bool CModelList::HasAnalyticVisibility()
+{
+	if(mModels.size() == 0)
+		return false;
+
+	for(auto model: mModels)
+	{
+		if(!model->HasAnalyticVisibility())
+			return false;
+	}
+
+	return true;
+}
+
 // Render the image to the specified OpenGL framebuffer object.
 // Returns the maximum flux found in this frame.
+//
+// Models whose bounding box (see CModel::GetScreenBounds) lies entirely
+// outside of the viewport are skipped. Draws are restricted to the union of
+// the bounding boxes of the visible models. This occupied region is available
+// from GetOccupiedRegion.
 double CModelList::Render(const mat4 & view)
 {
 	// We render the models in order by depth (i.e. z-direction).
@@ -151,24 +431,82 @@ double CModelList::Render(const mat4 & view)
 	vector<CModelPtr> models = mModels;
 	sort(models.begin(), models.end(), SortByZ);
 
-	// First clear the buffer.
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const vec4 field(viewport[0], viewport[1],
+			viewport[0] + viewport[2], viewport[1] + viewport[3]);
+
+	// Cull models outside of the field and find the occupied region.
+	vector<CModelPtr> visible;
+	bool bounded = true;
+	vec4 occupied(field.z, field.w, field.x, field.y);	// empty
+	vec4 bounds;
+	for(auto model : models)
+	{
+		if(!model->GetScreenBounds(view, viewport, bounds))
+		{
+			bounded = false;
+			visible.push_back(model);
+			continue;
+		}
+
+		bool inside = bounds.x >= field.x && bounds.y >= field.y
+				&& bounds.z <= field.z && bounds.w <= field.w;
+		bool outside = bounds.z < field.x || bounds.w < field.y
+				|| bounds.x > field.z || bounds.y > field.w;
+
+		// Warn (once) when a model starts to fall outside of the field.
+		if(inside)
+			mModelsOutsideField.erase(model.get());
+		else if(mModelsOutsideField.insert(model.get()).second)
+			cerr << "Warning: The model '" << model->name() << "' "
+				 << (outside ? "is outside of" : "extends beyond")
+				 << " the field of view. Flux will be lost." << endl;
+
+		if(outside)
+			continue;
+
+		occupied = vec4(min(occupied.x, bounds.x), min(occupied.y, bounds.y),
+				max(occupied.z, bounds.z), max(occupied.w, bounds.w));
+		visible.push_back(model);
+	}
+
+	if(!bounded)
+		occupied = field;
+
+	// Clamp the occupied region to the field and convert to pixels.
+	GLint region[4];
+	region[0] = max(floor(occupied.x), field.x);
+	region[1] = max(floor(occupied.y), field.y);
+	region[2] = max(GLint(min(ceil(occupied.z), field.z)) - region[0], 0);
+	region[3] = max(GLint(min(ceil(occupied.w), field.w)) - region[1], 0);
+
+	// First clear the buffer. The whole buffer is cleared as the same list is
+	// rendered into several framebuffers, whose previous contents are unknown
+	// here. Full clears are cheap, the draws are restricted below.
 //    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
     glClearColor (0.0f, 0.0f, 0.0f, 0.0f); // Set the clear color
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the depth and color buffers
 
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(region[0], region[1], region[2], region[3]);
+
     double max_flux = 0.0;
-    for(auto model : models)
+    for(auto model : visible)
     {
     	model->preRender(max_flux);
     }
 
     // Now call render on all of the models:
-    for(auto model : models)
+    for(auto model : visible)
     {
     	model->Render(view, max_flux);
     	model->clearFlags();
     }
 
+    glDisable(GL_SCISSOR_TEST);
+    copy(region, region + 4, mOccupiedRegion);
+
     // Bind back to the default framebuffer and let OpenGL finish:
 //    glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glFlush();
@@ -181,7 +519,10 @@ double CModelList::Render(const mat4 & view)
 void CModelList::ReplaceModel(unsigned int model_index, CModelPtr model)
 {
 	if(model_index < mModels.size())
+	{
+		model->SetImageScale(mImageScale);
 		mModels[model_index] = model;
+	}
 }
 
 /// Removes the model at the specified index
@@ -261,6 +602,26 @@ void CModelList::SetFreeParameters(const double * params, unsigned int n_params,
     }
 }
 
+/// Returns the period (days) on which the scene repeats, zero if the scene does
+/// not depend on time, or -1 if the scene is not periodic.
+double CModelList::GetPeriod()
+{
+	double period = 0;
+	for(auto model: mModels)
+		period = CModel::CombinePeriods(period, model->GetPeriod());
+
+	return period;
+}
+
+/// Sets the times at which the models will be rendered (e.g. the epochs of the data)
+void CModelList::SetEpochs(const vector<double> & epochs)
+{
+    for(vector<CModelPtr>::iterator it = mModels.begin(); it != mModels.end(); ++it)
+    {
+    	(*it)->SetEpochs(epochs);
+    }
+}
+
 /// Sets the time for all of the models
 /// Note, some modes don't care about time
 void CModelList::SetTime(double t)
@@ -272,6 +633,16 @@ void CModelList::SetTime(double t)
     }
 }
 
+/// Sets the size of an image pixel (mas) for all of the models
+void CModelList::SetImageScale(double scale)
+{
+	mImageScale = scale;
+    for(vector<CModelPtr>::iterator it = mModels.begin(); it != mModels.end(); ++it)
+    {
+    	(*it)->SetImageScale(scale);
+    }
+}
+
 /// Sets the wavelength for all of the models
 void CModelList::SetWavelength(double wavelength)
 {
@@ -28,7 +28,9 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
+#include <complex>
 #include <memory>
+#include <set>
 #include <vector>
 
 using namespace std;
@@ -47,11 +49,21 @@ protected:
 protected:
 	double mTime;	///< The current time for the models in this list (JD)
 	double mWavelength; ///< The current wavelength of observation (meters)
+	double mImageScale; ///< The size of an image pixel (mas), zero if unknown
+
+	GLint mOccupiedRegion[4]; ///< Region (x, y, width, height) drawn during the last Render
+	set<const CModel *> mModelsOutsideField; ///< Models which have been reported outside of the field
 
 public:
 	CModelList();
 	virtual ~CModelList();
 
+protected:
+	bool FindEclipses(vector<pair<CModelPtr, CModelPtr> > & eclipses);
+	double GetFlux(const vector<pair<CModelPtr, CModelPtr> > & eclipses);
+	bool HasAnalyticModelFlux();
+public:
+
 	void AddModel(CModelPtr model);
 
 	void clear();
@@ -63,11 +75,22 @@ public:
 	void GetFreeParametersScaled(double * params, int n_params);
 	void GetFreeParameterSteps(double * steps, unsigned int size);
 	vector<string> GetFreeParamNames();
+	double GetExtent();
+	double GetExtent(const vector<double> & epochs);
+	bool GetAnalyticFlux(double & flux);
+	double GetFlux();
+	bool GetFlux(const vector<double> & jds, vector<double> & flux);
 	CModelPtr GetModel(int i) { return mModels.at(i); };
+	void GetOccupiedRegion(GLint region[4]);
+	double GetPeriod();
 	double GetTime() { return mTime; };
+	void GetVisibilities(const vector<pair<double,double> > & uv, vector<complex<double> > & vis);
 
 	static vector<string> GetTypes(void);
 
+	bool HasAnalyticFlux();
+	bool HasAnalyticVisibility();
+
 	double Render(const glm::mat4 & view);
 	void ReplaceModel(unsigned int model_index, CModelPtr model);
 	void RemoveModel(unsigned int model_index);
@@ -75,6 +98,8 @@ public:
 
 	Json::Value Serialize();
 	void SetFreeParameters(const double * params, unsigned int n_params, bool scale_params);
+	void SetEpochs(const vector<double> & epochs);
+	void SetImageScale(double scale);
 	void SetTime(double t);
 	void SetTimestep(double dt);
 	void SetWavelength(double wavelength);
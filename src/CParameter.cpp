@@ -24,6 +24,8 @@
 #include <limits>
 using namespace std;
 
+atomic<unsigned int> CParameter::free_set_version(0);
+
 CParameter::CParameter()
 {
 	// Put in some (reasonable) default values.
@@ -149,6 +151,10 @@ void CParameter::setDirty(bool is_dirty)
 /// Sets whether or not this parameter is free for minimization.
 void CParameter::setFree(bool is_free)
 {
+	// Let CParameterMap know its list of free parameters is out of date.
+	if(is_free != free)
+		free_set_version++;
+
 	free = is_free;
 }
 
@@ -20,6 +20,7 @@
 #ifndef CPARAMETER_H_
 #define CPARAMETER_H_
 
+#include <atomic>
 #include <string>
 using namespace std;
 
@@ -40,6 +41,8 @@ private:
 
 	bool check_bounds;		/// Whether or not this object should check that values are within bounds.
 
+	static atomic<unsigned int> free_set_version;	/// Incremented whenever any parameter is freed or fixed.
+
 public:
 	CParameter();
 	virtual ~CParameter();
@@ -70,6 +73,8 @@ public:
 	void	setHelpText(string new_help_text);
 
 	void 	toggleBoundsChecks(bool enable_checks);
+
+	static unsigned int freeSetVersion() { return free_set_version; };
 };
 
 #endif /* CPARAMETER_H_ */
@@ -24,6 +24,9 @@ CParameterMap::CParameterMap()
 {
 	mID = "NOT_IMPLEMENTED_BY_DEVELOPER";
 	mName = "NOT_IMPLEMENTED_BY_DEVELOPER";
+
+	mFreeParamsOwner = NULL;
+	mFreeParamsVersion = 0;
 }
 
 CParameterMap::~CParameterMap()
@@ -61,6 +64,7 @@ unsigned int CParameterMap::addParameter(string internal_name, double value, dou
 
 	// append it to the vector
 	mParams[internal_name] = temp;
+	mFreeParamsOwner = NULL;
 
 	// return the parameter number
 	return mParams.size() - 1;
@@ -96,18 +100,11 @@ unsigned int CParameterMap::getAllParameters(double * params, unsigned int n_par
 /// @param normalize_value Whether or not the parameters should be normalized.
 unsigned int CParameterMap::getFreeParameters(double * params, unsigned int n_params, bool normalize_value)
 {
-	unsigned int n = 0;
-	for(auto it: mParams)
-	{
-		if(n > n_params)
-			break;
+	updateFreeParameters();
 
-		if(it.second.isFree())
-		{
-			params[n] = it.second.getValue(normalize_value);
-			n++;
-		}
-	}
+	unsigned int n = 0;
+	for(; n < mFreeParams.size() && n < n_params; n++)
+		params[n] = mFreeParams[n]->getValue(normalize_value);
 
 	return n;
 }
@@ -116,18 +113,11 @@ unsigned int CParameterMap::getFreeParameters(double * params, unsigned int n_pa
 /// the free parameters.
 vector<pair<double,double> > CParameterMap::getFreeParameterMinMaxes()
 {
-	vector< pair<double, double> > min_maxes;
+	updateFreeParameters();
 
-	for(auto it: mParams)
-	{
-		if(it.second.isFree())
-		{
-			pair<double, double> tmp;
-			tmp.first = it.second.getMin();
-			tmp.second = it.second.getMax();
-			min_maxes.push_back(tmp);
-		}
-	}
+	vector< pair<double, double> > min_maxes;
+	for(auto param: mFreeParams)
+		min_maxes.push_back(pair<double, double>(param->getMin(), param->getMax()));
 
 	return min_maxes;
 }
@@ -135,19 +125,11 @@ vector<pair<double,double> > CParameterMap::getFreeParameterMinMaxes()
 /// Returns the step sizes of the free parameters.
 unsigned int CParameterMap::getFreeParameterStepSizes(double * steps, unsigned int size)
 {
-	int n = 0;
-
-	for(auto it: mParams)
-	{
-		if(n > size)
-			break;
+	updateFreeParameters();
 
-		if(it.second.isFree())
-		{
-			steps[n] = it.second.getStepSize();
-			n++;
-		}
-	}
+	unsigned int n = 0;
+	for(; n < mFreeParams.size() && n < size; n++)
+		steps[n] = mFreeParams[n]->getStepSize();
 
 	return n;
 }
@@ -155,23 +137,19 @@ unsigned int CParameterMap::getFreeParameterStepSizes(double * steps, unsigned i
 /// Counts the number of free parameters in the map.
 unsigned int CParameterMap::getFreeParameterCount()
 {
-	unsigned int n = 0;
-	for(auto it: mParams)
-		if(it.second.isFree()) n++;
-
-	return n;
+	updateFreeParameters();
+	return mFreeParams.size();
 }
 
 /// \brief Returns a vector of strings containing the names of the free parameters
 /// prefixed with the name of the parent object.
 vector<string> CParameterMap::getFreeParameterNames()
 {
+	updateFreeParameters();
+
 	vector<string> tmp;
-	for(auto it: mParams)
-	{
-		if(it.second.isFree())
-			tmp.push_back(mName + '.' + it.second.getHumanName());
-	}
+	for(auto param: mFreeParams)
+		tmp.push_back(mName + '.' + param->getHumanName());
 
 	return tmp;
 }
@@ -195,6 +173,13 @@ bool CParameterMap::isDirty()
 	return is_dirty;
 }
 
+/// Removes the specified parameter, if it exists.
+void CParameterMap::removeParameter(const string & internal_name)
+{
+	mParams.erase(internal_name);
+	mFreeParamsOwner = NULL;
+}
+
 /// \brief Restores parameters values from the JSON value
 ///
 /// Restores parameter values, names, and min/max values from a JSON save file.
@@ -263,6 +248,29 @@ Json::Value CParameterMap::serialize()
 	return output;
 }
 
+/// Rebuilds the list of free parameters if parameters were added, removed,
+/// freed, or fixed since it was last built (or if this object is a copy).
+///
+/// The free parameters are read and written on every iteration of a
+/// minimizer, so they are gathered into a contiguous array of pointers once
+/// rather than found by walking the map on every call.
+void CParameterMap::updateFreeParameters()
+{
+	const unsigned int version = CParameter::freeSetVersion();
+	if(mFreeParamsOwner == this && mFreeParamsVersion == version)
+		return;
+
+	mFreeParams.clear();
+	for(auto & it: mParams)
+	{
+		if(it.second.isFree())
+			mFreeParams.push_back(&it.second);
+	}
+
+	mFreeParamsOwner = this;
+	mFreeParamsVersion = version;
+}
+
 /// Sets the free parameter values from an input array of doubles. Returns the
 /// number of values set during the call.
 ///
@@ -271,18 +279,11 @@ Json::Value CParameterMap::serialize()
 /// @param normalized_values Whether or not the values are normalized
 unsigned int CParameterMap::setFreeParameterValues(double * values, unsigned int n_values, bool normalized_values)
 {
-	int n = 0;
-	for(auto & it: mParams)
-	{
-		if(n > n_values)
-			break;
+	updateFreeParameters();
 
-		if(it.second.isFree())
-		{
-			it.second.setValue(values[n], normalized_values);
-			n++;
-		}
-	}
+	unsigned int n = 0;
+	for(; n < mFreeParams.size() && n < n_values; n++)
+		mFreeParams[n]->setValue(values[n], normalized_values);
 
 	return n;
 }
@@ -22,6 +22,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 using namespace std;
 
 #include "json/json.h"
@@ -35,6 +36,12 @@ protected:
 	string mName;					///< A human-readable name for the object. Try to limit to < 60 characters
 	string mID;						///< An internal ID for this object
 
+private:
+	// The free parameters in map order, see updateFreeParameters.
+	vector<CParameter*> mFreeParams;
+	const CParameterMap * mFreeParamsOwner;	///< The object mFreeParams was built for
+	unsigned int mFreeParamsVersion;		///< CParameter::freeSetVersion() when mFreeParams was built
+
 public:
 	CParameterMap();
 	virtual ~CParameterMap();
@@ -46,14 +53,14 @@ public:
 			double min, double max, bool free, double step_size,
 			string human_name, string help, unsigned int decimal_places=1);
 
-	void clearFlags();
+	virtual void clearFlags();
 
 	unsigned int getAllParameters(double * params, unsigned int n_params, bool normalize_value = false);
-	unsigned int getFreeParameters(double * params, unsigned int n_params, bool normalize_value = false);
-	unsigned int getFreeParameterCount();
-	vector<string> getFreeParameterNames();
-	vector<pair<double,double> > getFreeParameterMinMaxes();
-	unsigned int getFreeParameterStepSizes(double * steps, unsigned int size);
+	virtual unsigned int getFreeParameters(double * params, unsigned int n_params, bool normalize_value = false);
+	virtual unsigned int getFreeParameterCount();
+	virtual vector<string> getFreeParameterNames();
+	virtual vector<pair<double,double> > getFreeParameterMinMaxes();
+	virtual unsigned int getFreeParameterStepSizes(double * steps, unsigned int size);
 
 	const map<string, CParameter> & getParameterMap() { return mParams; };
 	virtual string ID() const { return mID; };
@@ -62,9 +69,14 @@ public:
 
 	virtual bool isDirty();
 
-	void restore(Json::Value input);
+protected:
+	void removeParameter(const string & internal_name);
+	void updateFreeParameters();
+public:
+
+	virtual void restore(Json::Value input);
 
-	Json::Value serialize();
+	virtual Json::Value serialize();
 
 	virtual unsigned int setFreeParameterValues(double * values, unsigned int n_values, bool normalized_values = false);
 	void setParameter(const string & name, double value, bool is_normalized = false);
@@ -43,6 +43,13 @@ void CPosition::GetXYZ(double & x, double & y, double & z)
 	z = 0;
 }
 
+/// Returns the period (days) on which the position repeats. Returns zero if the
+/// position does not depend on time and -1 if it is time dependent, but not periodic.
+double CPosition::GetPeriod()
+{
+	return 0;
+}
+
 void CPosition::GetAngles(double & Omega_t, double & inc_t, double & omega_t)
 {
 	Omega_t = 0;
@@ -50,6 +57,13 @@ void CPosition::GetAngles(double & Omega_t, double & inc_t, double & omega_t)
 	omega_t = 0;
 }
 
+/// Informs the position of the times at which it will be evaluated so that
+/// time-dependent positions may precompute their values. Ignored by default.
+void CPosition::SetEpochs(const vector<double> & epochs)
+{
+
+}
+
 void CPosition::SetTime(double time)
 {
 	mTime = time;
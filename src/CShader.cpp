@@ -35,6 +35,7 @@ CShader::CShader(const CShader & other)
 	mShader_dir = other.mShader_dir;
 	mVertShaderFileName = other.mVertShaderFileName;
 	mFragShaderFilename = other.mFragShaderFilename;
+	mFragLibraryFilenames = other.mFragLibraryFilenames;
 	mParams = other.mParams;
 	mParam_locations.resize(mParams.size());
 	mShaderLoaded = false;
@@ -71,6 +72,14 @@ CShader::CShader(string json_config_file)
 	mVertShaderFileName = input["vertex_shader"].asString();
 	mFragShaderFilename = input["fragment_shader"].asString();
 
+	// Optional fragment shader objects which are linked alongside the main
+	// fragment shader (e.g. functions shared by several shaders).
+	if(input.isMember("fragment_libraries"))
+	{
+		for(unsigned int i = 0; i < input["fragment_libraries"].size(); i++)
+			mFragLibraryFilenames.push_back(input["fragment_libraries"][i].asString());
+	}
+
 	// Now read in the parameters from the file
 	stringstream tmp;
 	string param_label;
@@ -115,6 +124,8 @@ CShader::~CShader()
 	if(mProgram) glDeleteProgram(mProgram);
 	if(mShader_vertex) glDeleteShader(mShader_vertex);
 	if(mShader_fragment) glDeleteShader(mShader_fragment);
+	for(auto library: mShader_libraries)
+		glDeleteShader(library);
 }
 
 /// Compiles an OpenGL shader, checking for errors.
@@ -142,6 +153,18 @@ GLuint CShader::GetProgram()
 	return mProgram;
 }
 
+/// Returns true if the fragment shader is linked with the specified library.
+bool CShader::HasFragmentLibrary(const string & filename)
+{
+	for(auto library: mFragLibraryFilenames)
+	{
+		if(library == filename)
+			return true;
+	}
+
+	return false;
+}
+
 // Loads the shader from the source file and creates a binary for the current selected context.
 void CShader::Init()
 {
@@ -182,6 +205,22 @@ void CShader::Init()
     CompileShader(mShader_vertex);
     CompileShader(mShader_fragment);
 
+    // Compile and attach any fragment shader libraries
+    for(auto filename: mFragLibraryFilenames)
+    {
+    	string source_l = ReadFile(mShader_dir + '/' + filename,
+    			"Could not read " + mShader_dir + '/' + filename + " file!");
+    	const GLchar * tmp_source_l = (const GLchar *) source_l.c_str();
+
+    	GLuint library = glCreateShader(GL_FRAGMENT_SHADER);
+    	CHECK_OPENGL_STATUS_ERROR(!glIsShader(library), "Failed to create OpenGL fragment shader");
+
+    	glAttachShader(mProgram, library);
+    	glShaderSource(library, 1, &tmp_source_l, NULL);
+    	CompileShader(library);
+    	mShader_libraries.push_back(library);
+    }
+
     LinkProgram(mProgram);
 
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to link shader");
@@ -199,6 +238,20 @@ void CShader::Init()
     mShaderLoaded = true;
 }
 
+/// Links `replacement` in place of the fragment library `filename`. This
+/// must be called before the shader is loaded.
+void CShader::ReplaceFragmentLibrary(const string & filename, const string & replacement)
+{
+	if(mShaderLoaded)
+		throw runtime_error("Cannot replace a fragment library of a loaded shader.");
+
+	for(auto & library: mFragLibraryFilenames)
+	{
+		if(library == filename)
+			library = replacement;
+	}
+}
+
 /// Links an OpenGL program.
 void CShader::LinkProgram(GLuint program)
 {
@@ -38,9 +38,11 @@ protected:
 	GLuint mProgram;
 	GLuint mShader_vertex;
 	GLuint mShader_fragment;
+	vector<GLuint> mShader_libraries;
 	vector<GLuint> mParam_locations;
 	string mVertShaderFileName;
 	string mFragShaderFilename;
+	vector<string> mFragLibraryFilenames;
 	string mShader_dir;
 
 	bool mShaderLoaded;
@@ -54,10 +56,14 @@ public:
 
 	GLuint GetProgram();
 
+	bool HasFragmentLibrary(const string & filename);
+
 	void Init();
 
 	void LinkProgram(GLuint program);
 
+	void ReplaceFragmentLibrary(const string & filename, const string & replacement);
+
 	void UseShader();
 };
 
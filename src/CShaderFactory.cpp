@@ -43,7 +43,13 @@ CShaderFactory::CShaderFactory()
 	Register(EXE_FOLDER + "/shaders/disk_andrews2009.json");
 	Register(EXE_FOLDER + "/shaders/disk_power_law.json");
 	Register(EXE_FOLDER + "/shaders/disk_alpha1973.json");
+	// Instanced variants of the disk shaders, only used by the concentric ring models.
+	Register(EXE_FOLDER + "/shaders/disk_pascucci2004_rings.json");
+	Register(EXE_FOLDER + "/shaders/disk_andrews2009_rings.json");
+	Register(EXE_FOLDER + "/shaders/disk_power_law_rings.json");
+	Register(EXE_FOLDER + "/shaders/disk_alpha1973_rings.json");
 	Register(EXE_FOLDER + "/shaders/texture_2d.json");
+	Register(EXE_FOLDER + "/shaders/voronoi.json");
 }
 
 CShaderFactory::~CShaderFactory() \
@@ -0,0 +1,220 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#include "CSnapshot.h"
+
+#include <cstdlib>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+const uint32_t CSnapshot::Version;
+
+static const char SNAPSHOT_MAGIC[8] = {'S', 'I', 'M', 'T', 'O', 'I', 'S', 'S'};
+static const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+/// Returns the number of padding bytes needed to align offset to 8 bytes.
+static size_t Padding(size_t offset)
+{
+	return (8 - offset % 8) % 8;
+}
+
+CSnapshot::CSnapshot()
+{
+	mMapping = NULL;
+	mMappingSize = 0;
+}
+
+CSnapshot::~CSnapshot()
+{
+	Close();
+}
+
+/// Adds a data file to the snapshot. The payload is copied.
+void CSnapshot::AddRecord(const string & filename, const string & payload)
+{
+	mPayloads.push_back(payload);
+
+	CSnapshotRecord record;
+	record.filename = filename;
+	mRecords.push_back(record);
+
+	// The payloads may have moved when mPayloads grew, update the pointers.
+	for(unsigned int i = 0; i < mRecords.size(); i++)
+	{
+		mRecords[i].data = mPayloads[i].data();
+		mRecords[i].size = mPayloads[i].size();
+	}
+}
+
+void CSnapshot::Close()
+{
+	if(mMapping == NULL)
+		return;
+
+#ifndef _WIN32
+	munmap(mMapping, mMappingSize);
+#else
+	free(mMapping);
+#endif // _WIN32
+
+	mMapping = NULL;
+	mMappingSize = 0;
+}
+
+/// Opens a snapshot. The file is memory-mapped and the records refer directly
+/// to the mapping.
+void CSnapshot::Open(const string & filename)
+{
+	Close();
+	mRecords.clear();
+	mPayloads.clear();
+
+	size_t file_size = 0;
+
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw runtime_error("Could not open snapshot '" + filename + "'");
+
+	struct stat info;
+	if(fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		throw runtime_error("Could not determine the size of snapshot '" + filename + "'");
+	}
+	file_size = info.st_size;
+
+	void * mapping = (file_size > 0) ? mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if(mapping == MAP_FAILED)
+		throw runtime_error("Could not memory-map snapshot '" + filename + "'");
+#else
+	ifstream infile(filename.c_str(), ios::in | ios::binary | ios::ate);
+	if(!infile.good())
+		throw runtime_error("Could not open snapshot '" + filename + "'");
+
+	file_size = infile.tellg();
+	infile.seekg(0, ios::beg);
+	void * mapping = malloc(file_size);
+	infile.read((char *) mapping, file_size);
+#endif // _WIN32
+
+	mMapping = mapping;
+	mMappingSize = file_size;
+
+	// The whole file is treated as one record while parsing the header.
+	CSnapshotRecord file;
+	file.filename = filename;
+	file.data = (const char *) mMapping;
+	file.size = mMappingSize;
+	size_t offset = 0;
+
+	try
+	{
+		const char * magic = Read<char>(file, offset, 8);
+		if(memcmp(magic, SNAPSHOT_MAGIC, 8) != 0)
+			throw runtime_error("'" + filename + "' is not a SIMTOI snapshot.");
+
+		uint32_t version = *Read<uint32_t>(file, offset, 1);
+		uint32_t byte_order = *Read<uint32_t>(file, offset, 1);
+		if(version != Version || byte_order != SNAPSHOT_BYTE_ORDER)
+			throw runtime_error("The snapshot '" + filename + "' was written by an incompatible version of SIMTOI or on a different architecture.");
+
+		uint64_t settings_size = *Read<uint64_t>(file, offset, 1);
+		const char * settings = Read<char>(file, offset, settings_size);
+		offset += Padding(offset);
+
+		Json::Reader reader;
+		if(!reader.parse(settings, settings + settings_size, mSettings))
+			throw runtime_error("Could not parse the settings stored in snapshot '" + filename + "'");
+
+		uint64_t n_records = *Read<uint64_t>(file, offset, 1);
+		for(uint64_t i = 0; i < n_records; i++)
+		{
+			CSnapshotRecord record;
+
+			uint64_t name_size = *Read<uint64_t>(file, offset, 1);
+			record.filename = string(Read<char>(file, offset, name_size), name_size);
+			offset += Padding(offset);
+
+			record.size = *Read<uint64_t>(file, offset, 1);
+			record.data = Read<char>(file, offset, record.size);
+			offset += Padding(offset);
+
+			mRecords.push_back(record);
+		}
+	}
+	catch(...)
+	{
+		Close();
+		mRecords.clear();
+		throw;
+	}
+}
+
+/// Writes the settings and records to a snapshot file.
+void CSnapshot::Write(const string & filename)
+{
+	ofstream outfile(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if(!outfile.good())
+		throw runtime_error("Could not write snapshot '" + filename + "'");
+
+	string output;
+	const char zeros[8] = {0};
+
+	output.append(SNAPSHOT_MAGIC, 8);
+	Append(output, &Version, 1);
+	Append(output, &SNAPSHOT_BYTE_ORDER, 1);
+
+	Json::FastWriter writer;
+	string settings = writer.write(mSettings);
+	uint64_t size = settings.size();
+	Append(output, &size, 1);
+	output.append(settings);
+	output.append(zeros, Padding(output.size()));
+
+	uint64_t n_records = mRecords.size();
+	Append(output, &n_records, 1);
+	outfile.write(output.data(), output.size());
+
+	for(auto record: mRecords)
+	{
+		output.clear();
+
+		size = record.filename.size();
+		Append(output, &size, 1);
+		output.append(record.filename);
+		output.append(zeros, Padding(output.size()));
+
+		size = record.size;
+		Append(output, &size, 1);
+		outfile.write(output.data(), output.size());
+		outfile.write(record.data, record.size);
+		outfile.write(zeros, Padding(record.size));
+	}
+
+	if(!outfile.good())
+		throw runtime_error("Could not write snapshot '" + filename + "'");
+}
@@ -0,0 +1,113 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#ifndef CSNAPSHOT_H_
+#define CSNAPSHOT_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "json/json.h"
+
+using namespace std;
+
+class CSnapshot;
+typedef shared_ptr<CSnapshot> CSnapshotPtr;
+
+/// One data file stored in a snapshot. When read from disk `data` points into
+/// the memory-mapped snapshot, so it is only valid while the snapshot is open.
+struct CSnapshotRecord
+{
+	string filename;
+	const char * data;
+	size_t size;
+
+	CSnapshotRecord() { data = NULL; size = 0; };
+};
+
+/// \brief A binary snapshot of a SIMTOI session.
+///
+/// A snapshot stores the model/run settings (as JSON) followed by one record per
+/// data file. Each task decides what goes into its records: tasks which can
+/// store their parsed data do so, others store only the filename and the file
+/// is re-read on restore. Record payloads are 8-byte aligned so that columns
+/// of doubles can be used directly from the memory-mapped file.
+///
+/// File layout (native byte order):
+///	  char[8]  magic "SIMTOISS"
+///	  uint32   version
+///	  uint32   byte order marker
+///	  uint64   settings size, settings (JSON text)
+///	  uint64   number of records
+///	  records: uint64 filename size, filename, uint64 payload size, payload
+class CSnapshot
+{
+public:
+	static const uint32_t Version = 1;
+
+protected:
+	Json::Value mSettings;
+	vector<CSnapshotRecord> mRecords;
+	vector<string> mPayloads;	// record storage when writing
+
+	void * mMapping;
+	size_t mMappingSize;
+
+public:
+	CSnapshot();
+	virtual ~CSnapshot();
+
+	void AddRecord(const string & filename, const string & payload);
+	const vector<CSnapshotRecord> & GetRecords() { return mRecords; };
+
+	Json::Value & Settings() { return mSettings; };
+
+	void Open(const string & filename);
+	void Write(const string & filename);
+
+protected:
+	void Close();
+
+public:
+	/// Appends n values to a record payload.
+	template <typename T>
+	static void Append(string & payload, const T * values, size_t n)
+	{
+		payload.append(reinterpret_cast<const char *>(values), n * sizeof(T));
+	}
+
+	/// Reads n values from a record payload, advancing the offset.
+	/// Returns a pointer into the payload.
+	template <typename T>
+	static const T * Read(const CSnapshotRecord & record, size_t & offset, size_t n)
+	{
+		// Compare counts rather than byte sizes so a corrupt n cannot overflow.
+		if(offset > record.size || n > (record.size - offset) / sizeof(T))
+			throw runtime_error("The snapshot record for '" + record.filename + "' is truncated.");
+
+		const T * values = reinterpret_cast<const T *>(record.data + offset);
+		offset += n * sizeof(T);
+		return values;
+	}
+};
+
+#endif /* CSNAPSHOT_H_ */
@@ -18,6 +18,7 @@
  */
 
 #include "CTask.h"
+#include "CSnapshot.h"
 
 CTask::CTask(CWorkerThread * WorkerThread)
 {
@@ -46,6 +47,70 @@ vector<string> CTask::GetExtensions()
 	return mExtensions;
 }
 
+/// \brief Hands data read by ParseData to the task.
+///
+/// Must be called from the worker thread. The default implementation opens
+/// the file directly.
+CDataInfo CTask::OpenData(CTaskDataPtr data)
+{
+	return OpenData(data->filename);
+}
+
+/// \brief Reads a data file without modifying the task.
+///
+/// This function may be called from any thread, so implementations must not
+/// touch the task's data or the OpenGL/OpenCL contexts. The default
+/// implementation defers all work to OpenData.
+CTaskDataPtr CTask::ParseData(string filename)
+{
+	CTaskDataPtr data = CTaskDataPtr(new CTaskData());
+	data->filename = filename;
+	return data;
+}
+
+/// \brief Finds the epochs (JD) of the observations in data read with ParseData.
+///
+/// Like ParseData, this may be called from any thread. Returns false if the
+/// data has no epochs, which is the default.
+bool CTask::GetEpochs(CTaskDataPtr data, vector<double> & epochs)
+{
+	return false;
+}
+
+/// \brief Finds the shortest and longest spatial frequencies (wavelengths)
+/// sampled by data read with ParseData.
+///
+/// Like ParseData, this may be called from any thread. Returns false if the
+/// data does not sample spatial frequencies, which is the default.
+bool CTask::GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max)
+{
+	return false;
+}
+
+/// \brief Restores a data file from a snapshot record written by WriteSnapshot.
+///
+/// Like ParseData, this may be called from any thread. Returns an empty pointer
+/// if the task did not store its data in the snapshot, in which case the file
+/// named in the record must be re-read. This is the default behavior.
+CTaskDataPtr CTask::ReadSnapshot(const CSnapshotRecord & record)
+{
+	return CTaskDataPtr();
+}
+
+/// \brief Restores the task's settings from a SIMTOI save file. Tasks without
+/// settings ignore this.
+void CTask::Restore(Json::Value input)
+{
+
+}
+
+/// \brief Serializes the task's settings. Returns a null value if the task
+/// has no settings.
+Json::Value CTask::Serialize()
+{
+	return Json::Value();
+}
+
 /// \brief Strips the absolute path from the filename
 string CTask::StripPath(string filename)
 {
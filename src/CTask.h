@@ -24,16 +24,34 @@
 #include <vector>
 #include <valarray>
 
+#include "json/json.h"
 #include "CWorkerThread.h"
 #include "CDataInfo.h"
 
 class CTask;
 typedef shared_ptr<CTask> CTaskPtr;
+class CSnapshot;
+struct CSnapshotRecord;
 class CWorkerThread;
 typedef shared_ptr<CWorkerThread> CWorkerPtr;
 
 using namespace std;
 
+/// \brief Data which has been read from disk but not yet handed to a task.
+///
+/// Produced by CTask::ParseData, which may be called from any thread, and
+/// consumed by CTask::OpenData on the worker thread. Tasks derive from this
+/// class to carry their parsed data.
+class CTaskData
+{
+public:
+	string filename;
+	string error;	///< Set if the file could not be read.
+
+	virtual ~CTaskData() {};
+};
+typedef shared_ptr<CTaskData> CTaskDataPtr;
+
 class CTask
 {
 protected:
@@ -69,15 +87,24 @@ public:
 	virtual vector<string> GetExtensions();
 	virtual unsigned int GetNData() = 0;
 	virtual int GetNDataFiles() = 0;
+	virtual bool GetEpochs(CTaskDataPtr data, vector<double> & epochs);
+	virtual bool GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max);
 	virtual void GetUncertainties(double * residuals, unsigned int size) = 0;
 
 	virtual void InitGL() {};
 	virtual void InitCL() {};
 
 	virtual CDataInfo OpenData(string filename) = 0;
+	virtual CDataInfo OpenData(CTaskDataPtr data);
+	virtual CTaskDataPtr ParseData(string filename);
+	virtual CTaskDataPtr ReadSnapshot(const CSnapshotRecord & record);
+	virtual void WriteSnapshot(CSnapshot & snapshot) = 0;
 
 	virtual void RemoveData(unsigned int data_index) = 0;
 
+	virtual void Restore(Json::Value input);
+	virtual Json::Value Serialize();
+
 	static string StripPath(string filename);
 	static string StripExtension(string filename, vector<string> & valid_extensions);
 
@@ -24,6 +24,7 @@
 #include <fstream>
 
 #include "CTask.h"
+#include "CSnapshot.h"
 #include "CTaskFactory.h"
 #include "CWorkerThread.h"
 #include "version.h"
@@ -34,8 +35,11 @@ CTaskList::CTaskList(CWorkerThread * WorkerThread)
 {
 	CTaskFactory factory = CTaskFactory::Instance();
 
-	mTasks.push_back(factory.CreateWorker("oi", WorkerThread));
-	mTasks.push_back(factory.CreateWorker("photometry", WorkerThread));
+	mTaskIDs.push_back("oi");
+	mTaskIDs.push_back("photometry");
+
+	for(auto id: mTaskIDs)
+		mTasks.push_back(factory.CreateWorker(id, WorkerThread));
 }
 
 CTaskList::~CTaskList()
@@ -72,6 +76,30 @@ void CTaskList::Export(string export_folder)
 		task->Export(export_folder);
 }
 
+/// Returns the task which handles the specified file. The task is identified
+/// from the file's extension.
+CTaskPtr CTaskList::FindTask(string filename)
+{
+	// TODO: Right now we identify the task object from the file extension.
+	// There is probably a better way of doing this.
+
+	// First get the extension in lower case:
+	string extension = filename.substr(filename.find_last_of(".") + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	// Now find which task handles the data type.
+	for(auto task: mTasks)
+	{
+		for(auto datatype: task->GetExtensions())
+		{
+			if(extension == datatype)
+				return task;
+		}
+	}
+
+	throw runtime_error("The data type " + extension + " is not supported.");
+}
+
 void CTaskList::GetChi(double * chis, unsigned int size)
 {
 	unsigned int n_data;
@@ -161,28 +189,51 @@ void CTaskList::GetUncertainties(double * uncertainties, unsigned int size)
 	}
 }
 
+/// Opens the specified data file on the current thread.
 CDataInfo CTaskList::OpenData(string filename)
 {
-	// TODO: Right now we identify the task object from the file extension.
-	// There is probably a better way of doing this.
+	return FindTask(filename)->OpenData(filename);
+}
 
-	// First get the extension in lower case:
-	string extension = filename.substr(filename.find_last_of(".") + 1);
-	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+/// Hands data previously read by ParseData to the task that handles it.
+CDataInfo CTaskList::OpenData(CTaskDataPtr data)
+{
+	return FindTask(data->filename)->OpenData(data);
+}
 
-	// Now find which task handles the data type.
-	for(auto task: mTasks)
-	{
-		for(auto datatype: task->GetExtensions())
-		{
-			if(extension == datatype)
-			{
-				return task->OpenData(filename);
-			}
-		}
-	}
+/// Reads the specified data file without modifying any task. Safe to call
+/// from any thread.
+CTaskDataPtr CTaskList::ParseData(string filename)
+{
+	return FindTask(filename)->ParseData(filename);
+}
 
-	throw runtime_error("The data type " + extension + " is not supported.");
+/// Finds the epochs of the data read with ParseData, see CTask::GetEpochs.
+/// Safe to call from any thread.
+bool CTaskList::GetEpochs(CTaskDataPtr data, vector<double> & epochs)
+{
+	return FindTask(data->filename)->GetEpochs(data, epochs);
+}
+
+/// Finds the spatial frequencies sampled by data read with ParseData, see
+/// CTask::GetSpatialFrequencies. Safe to call from any thread.
+bool CTaskList::GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max)
+{
+	return FindTask(data->filename)->GetSpatialFrequencies(data, min, max);
+}
+
+/// Restores a data file from a snapshot. Returns an empty pointer if the file
+/// needs to be re-read.
+CTaskDataPtr CTaskList::ReadSnapshot(const CSnapshotRecord & record)
+{
+	return FindTask(record.filename)->ReadSnapshot(record);
+}
+
+/// Adds all open data files to the snapshot.
+void CTaskList::WriteSnapshot(CSnapshot & snapshot)
+{
+	for(auto task: mTasks)
+		task->WriteSnapshot(snapshot);
 }
 
 void CTaskList::RemoveData(unsigned int data_index)
@@ -200,6 +251,30 @@ void CTaskList::RemoveData(unsigned int data_index)
 	}
 }
 
+/// Restores the tasks' settings. The settings of each task are stored under its ID.
+void CTaskList::Restore(Json::Value input)
+{
+	for(unsigned int i = 0; i < mTasks.size(); i++)
+	{
+		if(input.isMember(mTaskIDs[i]))
+			mTasks[i]->Restore(input[mTaskIDs[i]]);
+	}
+}
+
+/// Serializes the settings of all tasks which have settings.
+Json::Value CTaskList::Serialize()
+{
+	Json::Value output;
+	for(unsigned int i = 0; i < mTasks.size(); i++)
+	{
+		Json::Value settings = mTasks[i]->Serialize();
+		if(!settings.isNull())
+			output[mTaskIDs[i]] = settings;
+	}
+
+	return output;
+}
+
 void CTaskList::InitCL()
 {
 	for(auto task: mTasks)
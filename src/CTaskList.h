@@ -24,6 +24,8 @@
 #include <memory>
 #include <valarray>
 #include <map>
+#include <string>
+#include "json/json.h"
 
 using namespace std;
 
@@ -31,6 +33,10 @@ class CDataInfo;
 
 class CTask;
 typedef shared_ptr<CTask> CTaskPtr;
+class CTaskData;
+typedef shared_ptr<CTaskData> CTaskDataPtr;
+class CSnapshot;
+struct CSnapshotRecord;
 
 class CWorkerThread;
 typedef shared_ptr<CWorkerThread> CWorkerPtr;
@@ -39,6 +45,7 @@ class CTaskList
 {
 protected:
 	vector<CTaskPtr> mTasks;
+	vector<string> mTaskIDs;
 
 public:
 	CTaskList(CWorkerThread * WorkerThread);
@@ -50,6 +57,10 @@ public:
 
 	void Export(string export_folder);
 
+protected:
+	CTaskPtr FindTask(string filename);
+
+public:
 	void GetChi(double * chis, unsigned int size);
 	unsigned int GetDataSize();
 	vector<string> GetFileFilters();
@@ -58,11 +69,19 @@ public:
 	void GetUncertainties(double * uncertainties, unsigned int size);
 
 	CDataInfo OpenData(string filename);
+	CDataInfo OpenData(CTaskDataPtr data);
+	CTaskDataPtr ParseData(string filename);
+	bool GetEpochs(CTaskDataPtr data, vector<double> & epochs);
+	bool GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max);
+	CTaskDataPtr ReadSnapshot(const CSnapshotRecord & record);
+	void WriteSnapshot(CSnapshot & snapshot);
 
 	void InitCL();
 	void InitGL();
 
 	void RemoveData(unsigned int data_index);
+	void Restore(Json::Value input);
+	Json::Value Serialize();
 
 	unsigned int size() { return mTasks.size(); };
 };
@@ -20,6 +20,8 @@
 #include "CGLWidget.h"
 
 #include <QMdiSubWindow>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
 #include <stdexcept>
 #include "textio.hpp"
 #include "json/json.h"
@@ -36,6 +38,7 @@ using namespace std;
 #include "CParameterItem.h"
 #include "CFeature.h"
 #include "CDataInfo.h"
+#include "CSnapshot.h"
 
 // Temporary includes while migrating code to wModels
 #include "wParameterEditor.h"
@@ -43,6 +46,47 @@ using namespace std;
 
 extern string EXE_FOLDER;
 
+/// Functor which parses data files on QtConcurrent's thread pool.
+struct CDataParser
+{
+	typedef CTaskDataPtr result_type;
+
+	CWorkerPtr mWorker;
+
+	CDataParser(CWorkerPtr worker) : mWorker(worker) {};
+
+	CTaskDataPtr operator()(const string & filename)
+	{
+		return mWorker->ParseData(filename);
+	}
+};
+
+/// Functor which hands parsed data to the worker on QtConcurrent's thread
+/// pool, so the caller is not blocked while the worker loads it. Errors are
+/// stored in the data's error field.
+struct CDataUploader
+{
+	typedef CDataInfo result_type;
+
+	CWorkerPtr mWorker;
+
+	CDataUploader(CWorkerPtr worker) : mWorker(worker) {};
+
+	CDataInfo operator()(CTaskDataPtr data)
+	{
+		try
+		{
+			return mWorker->addData(data);
+		}
+		catch(exception & e)
+		{
+			data->error = "Could not open " + data->filename + ": " + e.what();
+		}
+
+		return CDataInfo();
+	}
+};
+
 CGLWidget::CGLWidget(QWidget * widget_parent)
     : QGLWidget(widget_parent)
 { 
@@ -50,19 +94,168 @@ CGLWidget::CGLWidget(QWidget * widget_parent)
 	mWorker = make_shared<CWorkerThread>(this, QString::fromStdString(EXE_FOLDER));
 
 	mSaveDirectory = "";
+	mNextData = 0;
 
 	connect(mWorker.get(), SIGNAL(glContextWarning(string)), this, SLOT(receiveWarning(string)));
+	connect(&mDataWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(dataParsed(int)));
+	connect(&mDataWatcher, SIGNAL(finished()), this, SLOT(dataParsingFinished()));
+	connect(&mUploadWatcher, SIGNAL(finished()), this, SLOT(dataUploaded()));
 }
 
 CGLWidget::~CGLWidget()
 {
+	mQueuedData.clear();
+	mDataWatcher.waitForFinished();
+	mUploadQueue.clear();
+	mUploadWatcher.waitForFinished();
 	stopRendering();
 }
 
 void CGLWidget::addData(string filename)
 {
-	CDataInfo temp = mWorker->addData(filename);
-	emit dataAdded(temp);
+	addData(vector<string>(1, filename));
+}
+
+/// Opens several data files without blocking the caller.
+///
+/// The files are parsed concurrently on a thread pool (OIFITS files are read
+/// one at a time unless CFITSIO is reentrant, see COI::ParseData). As each
+/// file becomes available (in the order given) it is queued for upload by the
+/// worker thread, see openParsedData. dataLoaded is emitted once every file
+/// is loaded.
+void CGLWidget::addData(const vector<string> & filenames)
+{
+	if(filenames.size() == 0)
+	{
+		if(!isLoadingData())
+			emit dataLoaded();
+
+		return;
+	}
+
+	// Only one batch is parsed at a time, queue these files for later.
+	if(isLoadingData())
+	{
+		mQueuedData.insert(mQueuedData.end(), filenames.begin(), filenames.end());
+		return;
+	}
+
+	mParsedData.assign(filenames.size(), CTaskDataPtr());
+	mNextData = 0;
+	mDataWatcher.setFuture(QtConcurrent::mapped(filenames, CDataParser(mWorker)));
+}
+
+/// Opens data which was already read by parseData without blocking the
+/// caller, see openParsedData.
+void CGLWidget::addData(const vector<CTaskDataPtr> & data)
+{
+	for(auto item: data)
+		openParsedData(item);
+}
+
+/// Reads several data files concurrently without loading them, blocking the
+/// caller. Files which could not be read have their error set.
+vector<CTaskDataPtr> CGLWidget::parseData(const vector<string> & filenames)
+{
+	return QtConcurrent::blockingMapped<vector<CTaskDataPtr> >(filenames, CDataParser(mWorker));
+}
+
+/// Queues one parsed data file for the worker. The files are uploaded one
+/// at a time, in order, on a thread pool so the GUI thread never waits on the
+/// worker. dataUploaded emits dataAdded on success and a warning otherwise.
+void CGLWidget::openParsedData(CTaskDataPtr data)
+{
+	if(data->error.size() > 0)
+	{
+		emit warning(data->error);
+		return;
+	}
+
+	mUploadQueue.push_back(data);
+	uploadNextData();
+}
+
+/// Starts uploading the next queued data file, unless an upload is running.
+void CGLWidget::uploadNextData()
+{
+	if(mUploadWatcher.isRunning() || mUploadQueue.size() == 0)
+		return;
+
+	mUploadData = mUploadQueue.front();
+	mUploadQueue.pop_front();
+	mUploadWatcher.setFuture(QtConcurrent::run(CDataUploader(mWorker), mUploadData));
+}
+
+/// Opens the data stored in a snapshot.
+///
+/// Data which the tasks stored in the snapshot is handed directly to the worker.
+/// Returns the files which were only referenced by name, these should be
+/// re-read using addData.
+vector<string> CGLWidget::restoreData(CSnapshotPtr snapshot)
+{
+	vector<string> filenames;
+
+	for(auto record: snapshot->GetRecords())
+	{
+		CTaskDataPtr data = mWorker->ReadSnapshot(record);
+		if(!data)
+		{
+			filenames.push_back(record.filename);
+			continue;
+		}
+
+		openParsedData(data);
+	}
+
+	return filenames;
+}
+
+/// Hands all parsed files which are next in line to the worker.
+void CGLWidget::dataParsed(int index)
+{
+	mParsedData[index] = mDataWatcher.resultAt(index);
+
+	while(mNextData < mParsedData.size() && mParsedData[mNextData])
+	{
+		CTaskDataPtr data = mParsedData[mNextData];
+		mParsedData[mNextData].reset();
+		mNextData++;
+
+		openParsedData(data);
+	}
+}
+
+void CGLWidget::dataParsingFinished()
+{
+	mParsedData.clear();
+
+	if(mQueuedData.size() > 0)
+	{
+		vector<string> filenames;
+		filenames.swap(mQueuedData);
+		addData(filenames);
+		return;
+	}
+
+	if(!isLoadingData())
+		emit dataLoaded();
+}
+
+/// Reports the data file uploaded by uploadNextData and starts the next one.
+void CGLWidget::dataUploaded()
+{
+	CTaskDataPtr data = mUploadData;
+	mUploadData.reset();
+
+	if(data->error.size() > 0)
+		emit warning(data->error);
+	else
+		emit dataAdded(mUploadWatcher.result());
+
+	uploadNextData();
+
+	if(!isLoadingData())
+		emit dataLoaded();
 }
 
 void CGLWidget::addModel(CModelPtr model)
@@ -157,6 +350,44 @@ double CGLWidget::GetTime()
 	return mWorker->GetTime();
 }
 
+/// Chooses the model area from the spatial frequencies sampled by the parsed
+/// data and the extent of the models at the dates of the data, see CFraming.
+/// Must be called before rendering starts, as the worker sizes its buffers
+/// when it starts.
+///
+/// The extent uses the initial parameters. If a fit moves a model outside of
+/// the area, CModelList::Render warns about it.
+CFraming CGLWidget::AutoFrame(const vector<CTaskDataPtr> & data, double margin)
+{
+	double u_min = 0;
+	double u_max = 0;
+	vector<double> epochs;
+	for(auto item: data)
+	{
+		if(item->error.size() > 0)
+			continue;
+
+		vector<double> item_epochs;
+		if(mWorker->GetEpochs(item, item_epochs))
+			epochs.insert(epochs.end(), item_epochs.begin(), item_epochs.end());
+
+		double min = 0;
+		double max = 0;
+		if(!mWorker->GetSpatialFrequencies(item, min, max))
+			continue;
+
+		u_min = (u_min > 0) ? std::min(u_min, min) : min;
+		u_max = std::max(u_max, max);
+	}
+
+	double extent = mWorker->GetModelList()->GetExtent(epochs);
+	CFraming framing = CFraming::Create(u_min, u_max, extent, margin);
+	SetSize(framing.width, framing.height);
+	SetScale(framing.scale);
+
+	return framing;
+}
+
 void CGLWidget::Open(string filename)
 {
 	Json::Reader reader;
@@ -173,6 +404,12 @@ void CGLWidget::Open(string filename)
 				+ error_message);
 	}
 
+	Open(input);
+}
+
+/// Restores the model area from a (parsed) SIMTOI save file.
+void CGLWidget::Open(Json::Value input)
+{
 	int width = input["area_width"].asInt();
 	int height = input["area_height"].asInt();
 	double scale = input["area_scale"].asDouble();
@@ -244,6 +481,26 @@ void CGLWidget::resizeEvent(QResizeEvent *evt)
 void CGLWidget::Save(string filename)
 {
 	Json::StyledStreamWriter writer;
+	Json::Value output = Serialize();
+
+	std::ofstream outfile(filename.c_str());
+	writer.write(outfile, output);
+}
+
+/// Writes the models, open data, and the supplied run settings to a binary
+/// snapshot which may be restored with guiMain::OpenSnapshot.
+void CGLWidget::SaveSnapshot(string filename, Json::Value settings)
+{
+	CSnapshot snapshot;
+	snapshot.Settings()["model"] = Serialize();
+	snapshot.Settings()["run"] = settings;
+	mWorker->WriteSnapshot(snapshot);
+	snapshot.Write(filename);
+}
+
+/// Serializes the model area into the SIMTOI save file format.
+Json::Value CGLWidget::Serialize()
+{
 	Json::Value output;
 
 	// Serialize the mWorker object first
@@ -262,8 +519,7 @@ void CGLWidget::Save(string filename)
 	output["area_height"] = mWorker->GetImageHeight();
 	output["area_scale"] = mWorker->GetImageScale();
 
-	std::ofstream outfile(filename.c_str());
-	writer.write(outfile, output);
+	return output;
 }
 
 void CGLWidget::SetScale(double scale)
@@ -26,6 +26,8 @@
 #include <QResizeEvent>
 #include <QtDebug>
 #include <QStandardItemModel>
+#include <QFutureWatcher>
+#include <deque>
 #include <utility>
 #include <vector>
 
@@ -34,6 +36,7 @@
 //#include "CAnimator.h"
 #include "CWorkerThread.h"
 #include "CTreeModel.h"
+#include "CFraming.h"
 
 class CParameterMap;
 class CParameters;
@@ -44,6 +47,9 @@ typedef shared_ptr<CModelList> CModelListPtr;
 class CWorkerThread;
 typedef shared_ptr<CWorkerThread> CWorkerPtr;
 
+class CSnapshot;
+typedef shared_ptr<CSnapshot> CSnapshotPtr;
+
 class CGLWidget : public QGLWidget
 {
     Q_OBJECT
@@ -57,11 +63,33 @@ protected:
 
     static QGLFormat mFormat;
 
+    // Data files are parsed concurrently, then handed to the worker in the
+    // order they were requested.
+    QFutureWatcher<CTaskDataPtr> mDataWatcher;
+    vector<CTaskDataPtr> mParsedData;
+    unsigned int mNextData;
+    vector<string> mQueuedData;
+
+    // Parsed data is uploaded to the worker one file at a time, off the GUI
+    // thread (see openParsedData).
+    QFutureWatcher<CDataInfo> mUploadWatcher;
+    deque<CTaskDataPtr> mUploadQueue;
+    CTaskDataPtr mUploadData;
+
 public:
     CGLWidget(QWidget *widget_parent);
     virtual ~CGLWidget();
 
 	void addData(string filename);
+	void addData(const vector<string> & filenames);
+	void addData(const vector<CTaskDataPtr> & data);
+	vector<CTaskDataPtr> parseData(const vector<string> & filenames);
+	vector<string> restoreData(CSnapshotPtr snapshot);
+	bool isLoadingData()
+	{
+		return mDataWatcher.isRunning() || mQueuedData.size() > 0
+				|| mUploadWatcher.isRunning() || mUploadQueue.size() > 0;
+	};
     void addModel(shared_ptr<CModel> model);
 
 	static bool checkExtensionAvailability(std::string ext_name);
@@ -77,6 +105,8 @@ public:
 
 protected:
     void closeEvent(QCloseEvent *evt);
+    void openParsedData(CTaskDataPtr data);
+    void uploadNextData();
 
 //	void paintEvent(QPaintEvent * );
 	void glDraw();	// override the QGLWidget::glDraw function
@@ -102,12 +132,16 @@ public:
     string GetSaveFolder() { return mSaveDirectory; };
 
 public:
+    CFraming AutoFrame(const vector<CTaskDataPtr> & data, double margin);
     void Open(string filename);
+    void Open(Json::Value input);
 
 public:
     void Render();
 
     void Save(string filename);
+    void SaveSnapshot(string filename, Json::Value settings);
+    Json::Value Serialize();
     void SetScale(double scale);
     void SetFreeParameters(double * params, int n_params, bool scale_params);
     void SetSaveDirectory(string directory_path);
@@ -118,6 +152,9 @@ public:
     void stopRendering();
 
 private slots:
+	void dataParsed(int index);
+	void dataParsingFinished();
+	void dataUploaded();
 	void updateParameters();
 
 public slots:
@@ -127,6 +164,7 @@ signals:
 	void modelUpdated();
 //	void dataUpdated();
 	void dataAdded(CDataInfo info);
+	void dataLoaded();
 	void dataRemoved(int index);
 	void warning(string message);
 };
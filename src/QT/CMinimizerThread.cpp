@@ -154,6 +154,13 @@ void CMinimizerThread::OpenStatisticsFile(ofstream & file)
 	file.precision(8);
 }
 
+/// \brief Restores the minimizer's settings from the run configuration, see
+/// wMinimizer::startMinimizer. Minimizers without settings ignore this.
+void CMinimizerThread::Restore(Json::Value input)
+{
+
+}
+
 void CMinimizerThread::setSaveDirectory(string save_directory)
 {
 	if(save_directory.size() > 0)
@@ -31,6 +31,8 @@
 #include <memory>
 #include <valarray>
 
+#include "json/json.h"
+
 using namespace std;
 
 class CWorkerThread;
@@ -91,6 +93,7 @@ public:
 
 	string name();
 
+	virtual void Restore(Json::Value input);
 	void setSaveDirectory(string save_directory);
 	bool isRunning() { return mIsRunning; };
 
@@ -33,6 +33,7 @@ using namespace std;
 
 #include "CGLWidget.h"
 #include "CTaskList.h"
+#include "CSnapshot.h"
 #include "CModelList.h"
 #include "CDataInfo.h"
 #include "CTask.h"
@@ -64,6 +65,7 @@ CWorkerThread::CWorkerThread(CGLWidget *glWidget, QString exe_folder)
 
 	// Initialize the model and task lists:
     mModelList = CModelListPtr(new CModelList());
+    mModelList->SetImageScale(mImageScale);
 	mTaskList = CTaskListPtr(new CTaskList(this));
 }
 
@@ -90,19 +92,95 @@ void CWorkerThread::addModel(CModelPtr model)
 }
 
 CDataInfo CWorkerThread::addData(string filename)
+{
+	CTaskDataPtr data = ParseData(filename);
+	if(data->error.size() > 0)
+		throw runtime_error(data->error);
+
+	return addData(data);
+}
+
+/// Hands data read by ParseData to the tasks. Only this step runs on the
+/// worker thread.
+CDataInfo CWorkerThread::addData(CTaskDataPtr data)
 {
 	// Get exclusive access to the worker
 	QMutexLocker lock(&mWorkerMutex);
 
-	mTempString = filename;
+	mTempTaskData = data;
 	Enqueue(OPEN_DATA);
 
 	// Wait for the operation to complete.
 	mWorkerSemaphore.acquire(1);
 
+	mTempTaskData.reset();
 	return mTempDataInfo;
 }
 
+/// Reads a data file without touching the OpenGL/OpenCL contexts. This
+/// function does not lock the worker and may be called from any thread.
+/// Errors are returned in the data's error field rather than thrown, so
+/// that this function can be used from a thread pool.
+CTaskDataPtr CWorkerThread::ParseData(string filename)
+{
+	CTaskDataPtr data;
+	try
+	{
+		data = mTaskList->ParseData(filename);
+	}
+	catch(exception & e)
+	{
+		data = CTaskDataPtr(new CTaskData());
+		data->filename = filename;
+		data->error = "Could not open " + filename + ": " + e.what();
+	}
+
+	return data;
+}
+
+/// Finds the epochs (JD) of data read with ParseData. Like ParseData, this
+/// does not lock the worker.
+bool CWorkerThread::GetEpochs(CTaskDataPtr data, vector<double> & epochs)
+{
+	return mTaskList->GetEpochs(data, epochs);
+}
+
+/// Finds the spatial frequencies (wavelengths) sampled by data read with
+/// ParseData. Like ParseData, this does not lock the worker.
+bool CWorkerThread::GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max)
+{
+	return mTaskList->GetSpatialFrequencies(data, min, max);
+}
+
+/// Restores a data file from a snapshot record. Like ParseData, this does
+/// not lock the worker. Returns an empty pointer if the file must be re-read.
+CTaskDataPtr CWorkerThread::ReadSnapshot(const CSnapshotRecord & record)
+{
+	CTaskDataPtr data;
+	try
+	{
+		data = mTaskList->ReadSnapshot(record);
+	}
+	catch(exception & e)
+	{
+		data = CTaskDataPtr(new CTaskData());
+		data->filename = record.filename;
+		data->error = "Could not restore " + record.filename + " from the snapshot: " + e.what();
+	}
+
+	return data;
+}
+
+/// Adds the open data files to the snapshot.
+void CWorkerThread::WriteSnapshot(CSnapshot & snapshot)
+{
+	// Get exclusive access to the worker
+	QMutexLocker lock(&mWorkerMutex);
+
+	// Note, this is a cross-thread call.
+	mTaskList->WriteSnapshot(snapshot);
+}
+
 /// Returns a shared pointer to the requested model.
 CModelPtr CWorkerThread::getModel(unsigned int model_index)
 {
@@ -431,6 +509,17 @@ int CWorkerThread::GetNDataFiles()
 	return mTaskList->GetNDataFiles();
 }
 
+/// Returns the OpenCL context, creating it on first use. Tasks which do not
+/// need OpenCL (e.g. COI with the CPU engine) thus never initialize it.
+/// Must be called on the worker thread.
+COpenCLPtr CWorkerThread::GetOpenCL()
+{
+	if(!mOpenCL)
+		mOpenCL = make_shared<COpenCL>(CL_DEVICE_TYPE_GPU);
+
+	return mOpenCL;
+}
+
 /// Get the next operation from the queue.  This is a blocking function.
 WorkerOperations CWorkerThread::GetNextOperation(void)
 {
@@ -483,6 +572,9 @@ void CWorkerThread::Restore(Json::Value input)
 
 	// Note, this is a cross-thread call.
 	mModelList->Restore(input);
+
+	if(input.isMember("tasks"))
+		mTaskList->Restore(input["tasks"]);
 }
 
 // The main function of this thread
@@ -491,10 +583,9 @@ void CWorkerThread::run()
 	// ########
 	// CL/GL context initialization
 	// ########
-	// Immediately claim the OpenCL context
+	// Immediately claim the OpenGL context. The OpenCL context is created
+	// from it when a task first needs it, see GetOpenCL.
     mGLWidget->makeCurrent();
-    // Create an OpenCL context
-    mOpenCL = make_shared<COpenCL>(CL_DEVICE_TYPE_GPU);
 
 	// ########
 	// OpenGL display initialization
@@ -564,7 +655,7 @@ void CWorkerThread::run()
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to initialze task list OpenGL functions");
 
 	// ########
-	// Remaining OpenCL initialization (context done above)
+	// OpenCL initialization (tasks may defer this until it is needed)
 	// ########
 	mTaskList->InitCL();
 
@@ -603,7 +694,7 @@ void CWorkerThread::run()
 
 		case OPEN_DATA:
 			// Instruct the task list to open the file.
-			mTempDataInfo = mTaskList->OpenData(mTempString);
+			mTempDataInfo = mTaskList->OpenData(mTempTaskData);
 			mWorkerSemaphore.release(1);
 			break;
 
@@ -648,6 +739,7 @@ void CWorkerThread::SetScale(double scale)
 		throw runtime_error("Image scale cannot be negative.");
 
 	mImageScale = scale;
+	mModelList->SetImageScale(scale);
 }
 
 void CWorkerThread::SetSize(unsigned int width, unsigned int height)
@@ -689,6 +781,10 @@ Json::Value CWorkerThread::Serialize()
 
 	Json::Value temp = mModelList->Serialize();
 
+	Json::Value tasks = mTaskList->Serialize();
+	if(!tasks.isNull())
+		temp["tasks"] = tasks;
+
 	return temp;
 }
 
@@ -46,6 +46,10 @@ using namespace std;
 class CGLWidget;
 class CTaskList;
 typedef shared_ptr<CTaskList> CTaskListPtr;
+class CTaskData;
+typedef shared_ptr<CTaskData> CTaskDataPtr;
+class CSnapshot;
+struct CSnapshotRecord;
 class CModel;
 typedef shared_ptr<CModel> CModelPtr;
 class CModelList;
@@ -127,6 +131,7 @@ protected:
 	double mTempDouble;
 	unsigned int mTempUint;
 	CDataInfo mTempDataInfo;
+	CTaskDataPtr mTempTaskData;
 
 public:
     CWorkerThread(CGLWidget * glWidget, QString exe_folder);
@@ -139,6 +144,12 @@ public:
 	void removeModel(unsigned int model_index);
 
 	CDataInfo addData(string filename);
+	CDataInfo addData(CTaskDataPtr data);
+	CTaskDataPtr ParseData(string filename);
+	bool GetEpochs(CTaskDataPtr data, vector<double> & epochs);
+	bool GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max);
+	CTaskDataPtr ReadSnapshot(const CSnapshotRecord & record);
+	void WriteSnapshot(CSnapshot & snapshot);
 	void removeData(unsigned int data_id);
 
     void AllocateBuffer();
@@ -182,7 +193,7 @@ public:
     unsigned int GetImageWidth() { return mImageWidth; };
     double GetImageScale() { return mImageScale; };
     int GetNDataFiles();
-    COpenCLPtr GetOpenCL() { return mOpenCL; };
+    COpenCLPtr GetOpenCL();
     glm::mat4 GetView() { return mView; };
 
 	GLint glRenderBufferFormat() { return mGLRenderBufferFormat; }
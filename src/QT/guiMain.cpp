@@ -29,9 +29,11 @@
 #include <QTreeView>
 #include <QStringList>
 #include <QFileDialog>
+#include <QTimer>
 #include <vector>
 #include <utility>
 #include <fstream>
+#include <iostream>
 #include <cmath>
 #include <stdexcept>
 
@@ -48,6 +50,7 @@
 #include "CPosition.h"
 
 #include "CMinimizerFactory.h"
+#include "CSnapshot.h"
 
 
 guiMain::guiMain(QWidget *parent_widget)
@@ -55,6 +58,8 @@ guiMain::guiMain(QWidget *parent_widget)
 {
 	Init();
 
+	mCommandLineClose = false;
+
     // Create a new animation widget, init the tab region
     wAnimationWidget = new wAnimation();
 	this->tabBottom->addTab(wAnimationWidget, QString("Animation"));
@@ -124,17 +129,177 @@ void guiMain::Open(QString & filename)
 	toggleWidgets();
 }
 
+/// Opens one saved model file, choosing the model area from the data files
+/// and the models (see CFraming) instead of the area stored in the file.
+///
+/// The framing must be known before rendering starts, so the data files are
+/// read first. Returns the data, which should be loaded using
+/// CGLWidget::addData, or nothing if the model could not be opened.
+vector<CTaskDataPtr> guiMain::OpenFramed(QString & filename, const vector<string> & data_files, double margin)
+{
+	vector<CTaskDataPtr> data;
+
+	try
+	{
+		wGLWidget->resetWidget();
+		wGLWidget->Open(filename.toStdString());
+
+		data = wGLWidget->parseData(data_files);
+		CFraming framing = wGLWidget->AutoFrame(data, margin);
+		cout << framing.Describe() << endl;
+
+		wGLWidget->startRendering();
+		wGLWidget->Render();
+	}
+	catch(runtime_error e)
+	{
+		QMessageBox msgBox;
+		msgBox.setWindowTitle("SIMTOI Error");
+		msgBox.setText(e.what());
+		msgBox.exec();
+
+		return vector<CTaskDataPtr>();
+	}
+
+	toggleWidgets();
+	return data;
+}
+
+/// Restores the models from a binary snapshot written with --snapshot.
+///
+/// Returns the snapshot, whose data should be restored using
+/// CGLWidget::restoreData, or an empty pointer if the snapshot could not be opened.
+CSnapshotPtr guiMain::OpenSnapshot(QString & filename)
+{
+	CSnapshotPtr snapshot = CSnapshotPtr(new CSnapshot());
+
+	try
+	{
+		snapshot->Open(filename.toStdString());
+
+		wGLWidget->resetWidget();
+		wGLWidget->Open(snapshot->Settings()["model"]);
+		wGLWidget->startRendering();
+		wGLWidget->Render();
+	}
+	catch(runtime_error e)
+	{
+		// An error was thrown. Display a message to the user
+		QMessageBox msgBox;
+		msgBox.setWindowTitle("SIMTOI Error");
+		msgBox.setText(e.what());
+		msgBox.exec();
+		return CSnapshotPtr();
+	}
+
+	toggleWidgets();
+
+	return snapshot;
+}
+
 /// Create a new SIMTOI model area and runs the specified minimization engine on the data.  If close_simtoi is true
 /// SIMTOI will automatically exit when all minimization engines have completed execution.
+///
+/// If snapshot_in is specified the session is restored from that snapshot instead of model_file.
+/// If snapshot_out is specified a snapshot is written once all of the data has been loaded.
+/// If auto_frame is positive the model area is chosen from the data and models with
+/// that Nyquist margin, see CFraming. Snapshots keep their stored model area.
+/// minimizer_settings are passed to the minimizer, see CMinimizerThread::Restore.
 void guiMain::run_command_line(QStringList & data_files, QString & model_file,
-		string minimizer_id, string save_directory, bool close_simtoi)
+		string minimizer_id, string save_directory, bool close_simtoi,
+		QString snapshot_in, QString snapshot_out, double auto_frame,
+		Json::Value minimizer_settings)
 {
-	Open(model_file);
+	mCommandLineClose = close_simtoi;
+	mCommandLineSnapshot = snapshot_out.toStdString();
+
+	vector<string> command_line_files;
+	for(auto filename: data_files)
+		command_line_files.push_back(filename.toUtf8().constData());
+
+	CSnapshotPtr snapshot;
+	vector<CTaskDataPtr> framed_data;
+	if(snapshot_in.size() > 0)
+		snapshot = OpenSnapshot(snapshot_in);
+	else if(auto_frame > 0)
+	{
+		framed_data = OpenFramed(model_file, command_line_files, auto_frame);
+		command_line_files.clear();
+	}
+	else
+		Open(model_file);
+
 	wModelParameterEditor->updateModels();
-	wOpenDataEditor->openData(data_files);
-	wMinimizerWidget->startMinimizer(minimizer_id, save_directory);
 
-	if(close_simtoi)
+	vector<string> files;
+	if(snapshot)
+	{
+		// Settings given on the command line override those in the snapshot.
+		Json::Value run = snapshot->Settings()["run"];
+		if(minimizer_id.size() == 0)
+			minimizer_id = run["minimizer"].asString();
+		if(save_directory.size() == 0)
+			save_directory = run["save_directory"].asString();
+		if(minimizer_settings.isNull())
+			minimizer_settings = run["minimizer_settings"];
+
+		files = wGLWidget->restoreData(snapshot);
+	}
+
+	if(save_directory.size() == 0)
+		save_directory = "/tmp/model";
+
+	mCommandLineMinimizer = minimizer_id;
+	mCommandLineSaveDirectory = save_directory;
+	mCommandLineMinimizerSettings = minimizer_settings;
+
+	files.insert(files.end(), command_line_files.begin(), command_line_files.end());
+
+	// Data read for the framing is queued for upload first.
+	wGLWidget->addData(framed_data);
+
+	// Data is uploaded asynchronously, start the minimizer once it is available.
+	// Note, addData signals dataLoaded even if there are no files to open.
+	connect(wGLWidget, SIGNAL(dataLoaded()), this, SLOT(startCommandLineMinimizer()));
+	wGLWidget->addData(files);
+}
+
+/// Writes the command line snapshot (if requested) and starts the minimizer
+/// requested on the command line.
+void guiMain::startCommandLineMinimizer()
+{
+	disconnect(wGLWidget, SIGNAL(dataLoaded()), this, SLOT(startCommandLineMinimizer()));
+
+	if(mCommandLineSnapshot.size() > 0)
+	{
+		Json::Value run;
+		run["minimizer"] = mCommandLineMinimizer;
+		run["save_directory"] = mCommandLineSaveDirectory;
+		run["minimizer_settings"] = mCommandLineMinimizerSettings;
+
+		try
+		{
+			wGLWidget->SaveSnapshot(mCommandLineSnapshot, run);
+		}
+		catch(runtime_error e)
+		{
+			displayWarning(e.what());
+		}
+
+		// Writing a snapshot does not require a minimizer.
+		if(mCommandLineMinimizer.size() == 0)
+		{
+			if(mCommandLineClose)
+				QTimer::singleShot(0, this, SLOT(close()));
+
+			return;
+		}
+	}
+
+	wMinimizerWidget->startMinimizer(mCommandLineMinimizer, mCommandLineSaveDirectory,
+			mCommandLineMinimizerSettings);
+
+	if(mCommandLineClose)
 		connect(wMinimizerWidget, SIGNAL(finished()), this, SLOT(close()));
 }
 
@@ -26,6 +26,7 @@
 #include <QStandardItem>
 #include <QStandardItemModel>
 #include <string>
+#include <vector>
 #include <memory>
 
 using namespace std;
@@ -33,6 +34,10 @@ using namespace std;
 class CParameters;
 class CParameterItem;
 class CGLWidget;
+class CSnapshot;
+typedef shared_ptr<CSnapshot> CSnapshotPtr;
+class CTaskData;
+typedef shared_ptr<CTaskData> CTaskDataPtr;
 class wAnimation;
 class wMinimizer;
 
@@ -51,6 +56,13 @@ protected:
 
     string mOpenSaveFileDir; 	// Stores the previously opened directory for models
 
+    // Command line minimizer, started once all data has been loaded.
+    string mCommandLineMinimizer;
+    string mCommandLineSaveDirectory;
+    Json::Value mCommandLineMinimizerSettings;
+    bool mCommandLineClose;
+    string mCommandLineSnapshot;	// Snapshot to write once all data has been loaded.
+
 public:
     guiMain(QWidget *parent = 0);
     virtual ~guiMain();
@@ -62,11 +74,16 @@ protected:
     void Init();
 public:
     void Open(QString & filename);
-    void run_command_line(QStringList & data_files, QString & model_file, string minimizer_id, string save_directory, bool close_simtoi);
+    vector<CTaskDataPtr> OpenFramed(QString & filename, const vector<string> & data_files, double margin);
+    CSnapshotPtr OpenSnapshot(QString & filename);
+    void run_command_line(QStringList & data_files, QString & model_file, string minimizer_id, string save_directory, bool close_simtoi,
+    		QString snapshot_in = "", QString snapshot_out = "", double auto_frame = 0,
+    		Json::Value minimizer_settings = Json::Value());
 
 private slots:
 
 	void displayWarning(string);
+	void startCommandLineMinimizer();
 
 	void on_actionNew_triggered(void);
     void on_actionExport_triggered();
@@ -108,8 +108,11 @@ void wDataEditor::dataRemoved(int index)
 /// Opens several data files
 void wDataEditor::openData(QStringList & filenames)
 {
+	vector<string> files;
 	for(auto filename: filenames)
-		mGLWidget->addData(filename.toUtf8().constData());
+		files.push_back(filename.toUtf8().constData());
+
+	mGLWidget->addData(files);
 }
 
 /// Opens an add data dialog when btnAddData is clicked.
@@ -145,7 +145,9 @@ void wMinimizer::setSaveDirectory(const string & save_directory)
 ///
 /// \param minimizer_id The desired minimizer. See CMinimizerFactory for string names
 /// \param save_directory The directory in which temporary output data should be saved.
-void wMinimizer::startMinimizer(const string & minimizer_id, const string & save_directory)
+/// \param settings Minimizer specific settings, see CMinimizerThread::Restore.
+void wMinimizer::startMinimizer(const string & minimizer_id, const string & save_directory,
+		Json::Value settings)
 {
 	// stop any presently running minimization engine.
 	if(mMinimizer && mMinimizer->isRunning())
@@ -190,6 +192,7 @@ void wMinimizer::startMinimizer(const string & minimizer_id, const string & save
 
 		mMinimizer = CMinimizerFactory::getInstance().create(minimizer_id);
 		mMinimizer->setSaveDirectory(mSaveDirectory);
+		mMinimizer->Restore(settings);
 		mMinimizer->Init(worker);
 		mMinimizer->start();
 
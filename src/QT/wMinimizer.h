@@ -45,7 +45,8 @@ public:
 	wMinimizer(QWidget * parent = 0);
 	virtual ~wMinimizer();
 
-	void startMinimizer(const string & minimizer_id, const string & save_directory);
+	void startMinimizer(const string & minimizer_id, const string & save_directory,
+			Json::Value settings = Json::Value());
 
 	void setGLWidget(CGLWidget * gl_widget);
 protected:
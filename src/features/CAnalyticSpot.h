@@ -0,0 +1,46 @@
+/*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#ifndef CANALYTICSPOT_H_
+#define CANALYTICSPOT_H_
+
+#include "CUniformSpot.h"
+
+/// \brief A uniform spot which is evaluated per-fragment in the shader.
+///
+/// Healpix-based models pass the spot center, radius, and temperature
+/// difference to the fragment shader as uniforms, so changing the spot only
+/// requires a uniform update and the spot edge is not quantized to the pixel
+/// grid. Other models apply the spot like a `CUniformSpot`.
+class CAnalyticSpot: public CUniformSpot
+{
+
+public:
+	CAnalyticSpot();
+	virtual ~CAnalyticSpot();
+
+	static shared_ptr<CFeature> Create()
+	{
+		return shared_ptr<CFeature>(new CAnalyticSpot());
+	}
+
+	bool isAnalytic();
+};
+
+#endif /* CANALYTICSPOT_H_ */
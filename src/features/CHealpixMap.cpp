@@ -0,0 +1,481 @@
+/*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#include "CHealpixMap.h"
+#include "CModel.h"
+#include "chealpix.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+CHealpixMap::CHealpixMap():
+	CFeature()
+{
+	mID = "healpix_map";
+	mName = "Healpix Map";
+
+	mSource = NULL;
+	mSourcePixels = 0;
+	mSourceNSide = 0;
+	mMapping = NULL;
+	mMappingSize = 0;
+	mFITSBuffer = NULL;
+
+	mCellsFree = false;
+	mCellsDirty = false;
+	mCellMin = -2000;
+	mCellMax = 2000;
+	mCellStep = 100;
+
+	mResampledNSide = 0;
+
+	addParameter("scale", 1.0, -10, 10, false, 0.1, "Scale", "Multiplier applied to the map values before they are added to the surface temperature.");
+}
+
+CHealpixMap::~CHealpixMap()
+{
+	close();
+}
+
+/// Adds the (resampled) map to the pixel temperatures of the specified model.
+///
+/// The model must expose a `n_side_power` parameter (i.e. be derived from
+/// CHealpixSpheroid) with a uniform tesselation, otherwise the map is not
+/// applied.
+void CHealpixMap::apply(CModel * model)
+{
+	if(mSource == NULL && mCells.size() == 0)
+		return;
+
+	long n_side = 0;
+	try
+	{
+		n_side = long(pow(2, model->getParameter("n_side_power").getValue()));
+	}
+	catch(out_of_range & e)
+	{
+		cerr << "Warning: The '" << mName << "' feature requires a Healpix-based model. Skipping." << endl;
+		return;
+	}
+
+	if(n_side != mResampledNSide || mCellsDirty)
+		resample(n_side);
+
+	vector<double> & temperatures = model->GetPixelTemperatures();
+	if(temperatures.size() != size_t(nside2npix(n_side)))
+	{
+		cerr << "Warning: The '" << mName << "' feature does not support adaptive tesselations. Skipping." << endl;
+		return;
+	}
+
+	const float scale = mParams["scale"].getValue();
+	const size_t n_pixels = min(temperatures.size(), mResampled.size());
+	const float * map = mResampled.data();
+	double * T = temperatures.data();
+
+	for(size_t i = 0; i < n_pixels; i++)
+		T[i] += scale * map[i];
+}
+
+void CHealpixMap::clearFlags()
+{
+	CParameterMap::clearFlags();
+	mCellsDirty = false;
+}
+
+bool CHealpixMap::isDirty()
+{
+	return CParameterMap::isDirty() || mCellsDirty;
+}
+
+/// Releases the source map.
+void CHealpixMap::close()
+{
+#ifndef _WIN32
+	if(mMapping != NULL)
+		munmap(mMapping, mMappingSize);
+#else
+	if(mMapping != NULL)
+		free(mMapping);
+#endif // _WIN32
+
+	if(mFITSBuffer != NULL)
+		free(mFITSBuffer);
+
+	mSource = NULL;
+	mSourcePixels = 0;
+	mSourceNSide = 0;
+	mMapping = NULL;
+	mMappingSize = 0;
+	mFITSBuffer = NULL;
+	mResampledNSide = 0;
+}
+
+unsigned int CHealpixMap::getFreeParameters(double * params, unsigned int n_params, bool normalize_value)
+{
+	unsigned int n = CParameterMap::getFreeParameters(params, n_params, normalize_value);
+
+	if(!mCellsFree)
+		return n;
+
+	for(unsigned int i = 0; i < mCells.size() && n < n_params; i++, n++)
+	{
+		if(normalize_value)
+			params[n] = (mCells[i] - mCellMin) / (mCellMax - mCellMin);
+		else
+			params[n] = mCells[i];
+	}
+
+	return n;
+}
+
+unsigned int CHealpixMap::getFreeParameterCount()
+{
+	unsigned int n = CParameterMap::getFreeParameterCount();
+
+	if(mCellsFree)
+		n += mCells.size();
+
+	return n;
+}
+
+vector<string> CHealpixMap::getFreeParameterNames()
+{
+	vector<string> names = CParameterMap::getFreeParameterNames();
+
+	if(!mCellsFree)
+		return names;
+
+	stringstream temp;
+	for(unsigned int i = 0; i < mCells.size(); i++)
+	{
+		temp.clear();
+		temp.str(std::string());
+		temp << mName << ".cell_" << i;
+		names.push_back(temp.str());
+	}
+
+	return names;
+}
+
+vector<pair<double,double> > CHealpixMap::getFreeParameterMinMaxes()
+{
+	vector<pair<double,double> > min_maxes = CParameterMap::getFreeParameterMinMaxes();
+
+	if(mCellsFree)
+		min_maxes.insert(min_maxes.end(), mCells.size(), pair<double,double>(mCellMin, mCellMax));
+
+	return min_maxes;
+}
+
+unsigned int CHealpixMap::getFreeParameterStepSizes(double * steps, unsigned int size)
+{
+	unsigned int n = CParameterMap::getFreeParameterStepSizes(steps, size);
+
+	if(!mCellsFree)
+		return n;
+
+	for(unsigned int i = 0; i < mCells.size() && n < size; i++, n++)
+		steps[n] = mCellStep;
+
+	return n;
+}
+
+/// Opens the specified map. Files ending in `.fits`, `.fit`, or `.fits.gz` are
+/// read through chealpix, all other files are treated as raw NESTED float32
+/// sidecar files and are memory-mapped.
+void CHealpixMap::open(const string & filename)
+{
+	close();
+
+	mFilename = filename;
+	if(filename.size() == 0)
+		return;
+
+	auto ends_with = [&filename](const string & suffix)
+	{
+		return filename.size() >= suffix.size() &&
+				filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+
+	if(ends_with(".fits") || ends_with(".fit") || ends_with(".fits.gz"))
+		openFITS(filename);
+	else
+		openRaw(filename);
+
+	// When the cells are free we work from a private copy of the map.
+	if(mCellsFree && mCells.size() != size_t(mSourcePixels))
+		mCells.assign(mSource, mSource + mSourcePixels);
+
+	mCellsDirty = true;
+}
+
+/// Reads a Healpix FITS file, converting RING ordered maps into NESTED order.
+void CHealpixMap::openFITS(const string & filename)
+{
+	char coordsys[80];
+	char ordering[80];
+	long n_side = 0;
+
+	memset(coordsys, 0, sizeof(coordsys));
+	memset(ordering, 0, sizeof(ordering));
+
+	// read_healpix_map returns the NSIDE keyword, not the number of pixels.
+	float * buffer = read_healpix_map(filename.c_str(), &n_side, coordsys, ordering);
+	if(buffer == NULL)
+		throw runtime_error("Could not read Healpix map from '" + filename + "'");
+
+	// NESTED resampling requires n_side to be a power of two.
+	if(n_side <= 0 || (n_side & (n_side - 1)) != 0)
+	{
+		free(buffer);
+		throw runtime_error("The Healpix map '" + filename + "' does not have a valid NSIDE");
+	}
+
+	const long n_pixels = nside2npix(n_side);
+
+	if(strncmp(ordering, "RING", 4) == 0)
+	{
+		float * nested = (float *) malloc(n_pixels * sizeof(float));
+		long ipnest = 0;
+		for(long i = 0; i < n_pixels; i++)
+		{
+			ring2nest(n_side, i, &ipnest);
+			nested[ipnest] = buffer[i];
+		}
+
+		free(buffer);
+		buffer = nested;
+	}
+
+	mFITSBuffer = buffer;
+	mSource = buffer;
+	mSourcePixels = n_pixels;
+	mSourceNSide = n_side;
+}
+
+/// Memory-maps a raw sidecar file containing NESTED float32 values.
+void CHealpixMap::openRaw(const string & filename)
+{
+	size_t file_size = 0;
+
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw runtime_error("Could not open Healpix map '" + filename + "'");
+
+	struct stat info;
+	if(fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		throw runtime_error("Could not determine the size of Healpix map '" + filename + "'");
+	}
+	file_size = info.st_size;
+#else
+	ifstream infile(filename.c_str(), ios::in | ios::binary | ios::ate);
+	if(!infile.good())
+		throw runtime_error("Could not open Healpix map '" + filename + "'");
+
+	file_size = infile.tellg();
+	infile.seekg(0, ios::beg);
+#endif // _WIN32
+
+	const long n_pixels = file_size / sizeof(float);
+	const long n_side = (n_pixels > 0) ? npix2nside(n_pixels) : 0;
+	// NESTED resampling requires n_side to be a power of two.
+	if(file_size % sizeof(float) != 0 || n_side <= 0 || (n_side & (n_side - 1)) != 0
+			|| nside2npix(n_side) != n_pixels)
+	{
+#ifndef _WIN32
+		::close(fd);
+#endif // _WIN32
+		throw runtime_error("The Healpix map '" + filename + "' does not contain a valid number of pixels");
+	}
+
+#ifndef _WIN32
+	void * mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapping == MAP_FAILED)
+		throw runtime_error("Could not memory-map Healpix map '" + filename + "'");
+
+	// The map is read sequentially during resampling.
+	madvise(mapping, file_size, MADV_SEQUENTIAL);
+#else
+	void * mapping = malloc(file_size);
+	infile.read((char *) mapping, file_size);
+#endif // _WIN32
+
+	mMapping = mapping;
+	mMappingSize = file_size;
+	mSource = (const float *) mapping;
+	mSourcePixels = n_pixels;
+	mSourceNSide = n_side;
+}
+
+/// Resamples the source map (or the free cells) to the specified n_side.
+void CHealpixMap::resample(long n_side)
+{
+	const long source_nside = npix2nside(mCellsFree ? mCells.size() : mSourcePixels);
+
+	if(mCellsFree)
+		ResampleNested(mCells.data(), source_nside, mResampled, n_side);
+	else
+		ResampleNested(mSource, source_nside, mResampled, n_side);
+
+	mResampledNSide = n_side;
+}
+
+/// Resamples a NESTED Healpix map to a different n_side.
+///
+/// In the NESTED scheme the children of pixel `i` at the next resolution are
+/// pixels [4i, 4i + 3], so downsampling averages contiguous blocks and
+/// upsampling replicates the parent value. Undefined (HEALPIX_NULLVAL) pixels
+/// are treated as zero.
+template <typename T>
+void CHealpixMap::ResampleNested(const T * input, long input_nside, vector<float> & output, long output_nside)
+{
+	const long n_output = nside2npix(output_nside);
+	output.resize(n_output);
+
+	auto value = [input](long i)
+	{
+		return (input[i] < -1E30) ? 0.0f : float(input[i]);
+	};
+
+	if(input_nside >= output_nside)
+	{
+		const long ratio = input_nside / output_nside;
+		const long n_children = ratio * ratio;
+		const float norm = 1.0f / n_children;
+
+		for(long i = 0; i < n_output; i++)
+		{
+			float sum = 0;
+			const long offset = i * n_children;
+			for(long j = 0; j < n_children; j++)
+				sum += value(offset + j);
+
+			output[i] = sum * norm;
+		}
+	}
+	else
+	{
+		const long ratio = output_nside / input_nside;
+		const long n_children = ratio * ratio;
+
+		for(long i = 0; i < n_output; i++)
+			output[i] = value(i / n_children);
+	}
+}
+
+/// Restores the map parameters and reopens the map file.
+///
+/// In addition to the standard parameters, the following fields are read:
+/// 	`filename` : path to a FITS or raw NESTED float32 map
+/// 	`cells_free` : whether or not the map cells are free parameters
+/// 	`cell_min`, `cell_max`, `cell_step` : limits for the free cells
+/// 	`cells` : the current cell values (only when `cells_free` is true)
+void CHealpixMap::restore(Json::Value input)
+{
+	CParameterMap::restore(input);
+
+	if(input.isMember("cells_free"))
+		mCellsFree = input["cells_free"].asBool();
+	if(input.isMember("cell_min"))
+		mCellMin = input["cell_min"].asDouble();
+	if(input.isMember("cell_max"))
+		mCellMax = input["cell_max"].asDouble();
+	if(input.isMember("cell_step"))
+		mCellStep = input["cell_step"].asDouble();
+
+	mCells.clear();
+	if(mCellsFree && input.isMember("cells"))
+	{
+		const Json::Value & cells = input["cells"];
+		for(unsigned int i = 0; i < cells.size(); i++)
+			mCells.push_back(cells[i].asDouble());
+
+		// Discard cell lists which do not describe a complete Healpix map
+		// whose n_side is a power of two, see resample.
+		const long n_side = (mCells.size() > 0) ? npix2nside(mCells.size()) : 0;
+		if(mCells.size() > 0 && (n_side <= 0 || (n_side & (n_side - 1)) != 0
+				|| nside2npix(n_side) != long(mCells.size())))
+			mCells.clear();
+	}
+
+	if(input.isMember("filename"))
+		open(input["filename"].asString());
+}
+
+Json::Value CHealpixMap::serialize()
+{
+	Json::Value output = CParameterMap::serialize();
+
+	output["filename"] = mFilename;
+	output["cells_free"] = mCellsFree;
+	output["cell_min"] = mCellMin;
+	output["cell_max"] = mCellMax;
+	output["cell_step"] = mCellStep;
+
+	if(mCellsFree)
+	{
+		Json::Value cells(Json::arrayValue);
+		for(auto cell: mCells)
+			cells.append(Json::Value(cell));
+
+		output["cells"] = cells;
+	}
+
+	return output;
+}
+
+unsigned int CHealpixMap::setFreeParameterValues(double * values, unsigned int n_values, bool normalized_values)
+{
+	unsigned int n = CParameterMap::setFreeParameterValues(values, n_values, normalized_values);
+
+	if(!mCellsFree)
+		return n;
+
+	for(unsigned int i = 0; i < mCells.size() && n < n_values; i++, n++)
+	{
+		double value = values[n];
+		if(normalized_values)
+			value = mCellMin + value * (mCellMax - mCellMin);
+
+		if(value != mCells[i])
+		{
+			mCells[i] = value;
+			mCellsDirty = true;
+		}
+	}
+
+	return n;
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#ifndef CHEALPIXMAP_H_
+#define CHEALPIXMAP_H_
+
+#include <vector>
+#include <string>
+#include "CFeature.h"
+
+/// \brief A temperature map defined on a NESTED Healpix grid.
+///
+/// The map is read either from a Healpix FITS file or from a raw sidecar file
+/// containing NESTED float32 values. Raw sidecar files are memory-mapped so
+/// that large maps are paged in on demand rather than copied. The map is
+/// resampled to the n_side of the model it is applied to and added to the
+/// model's pixel temperatures (multiplied by `scale`).
+///
+/// Optionally the individual map cells may be exposed as free parameters
+/// (`cells_free`) so that surface maps can be fit directly.
+class CHealpixMap: public CFeature
+{
+protected:
+	string mFilename;
+
+	// Source map. Points either at a memory-mapped file or at a buffer
+	// allocated by read_healpix_map.
+	const float * mSource;
+	long mSourcePixels;
+	long mSourceNSide;
+	void * mMapping;
+	size_t mMappingSize;
+	float * mFITSBuffer;
+
+	// Free cell values (only used when mCellsFree is true)
+	bool mCellsFree;
+	bool mCellsDirty;
+	double mCellMin;
+	double mCellMax;
+	double mCellStep;
+	vector<double> mCells;
+
+	// The map resampled to the n_side of the last model we were applied to.
+	vector<float> mResampled;
+	long mResampledNSide;
+
+public:
+	CHealpixMap();
+	virtual ~CHealpixMap();
+
+	static shared_ptr<CFeature> Create()
+	{
+		return shared_ptr<CFeature>(new CHealpixMap());
+	}
+
+	void apply(CModel * model);
+
+	void clearFlags();
+	bool isDirty();
+
+	unsigned int getFreeParameters(double * params, unsigned int n_params, bool normalize_value = false);
+	unsigned int getFreeParameterCount();
+	vector<string> getFreeParameterNames();
+	vector<pair<double,double> > getFreeParameterMinMaxes();
+	unsigned int getFreeParameterStepSizes(double * steps, unsigned int size);
+	unsigned int setFreeParameterValues(double * values, unsigned int n_values, bool normalized_values = false);
+
+	void open(const string & filename);
+	void restore(Json::Value input);
+	Json::Value serialize();
+
+protected:
+	void close();
+	void openFITS(const string & filename);
+	void openRaw(const string & filename);
+	void resample(long n_side);
+
+	template <typename T>
+	static void ResampleNested(const T * input, long input_nside, vector<float> & output, long output_nside);
+};
+
+#endif /* CHEALPIXMAP_H_ */
@@ -67,3 +67,20 @@ void CUniformSpot::apply(CModel * model)
 		temperatures[pixel_id] += spot_delta_temperature;
 	}
 }
+
+/// Describes the uniform spot as a circular region centered at (theta, phi)
+/// for single-pass application by the model.
+bool CUniformSpot::getDescriptor(CFeatureDescriptor & descriptor)
+{
+	const double spot_radius = mParams["radius"].getValue() * PI / 180;
+
+	descriptor.s0 = 0;
+	descriptor.s1 = mParams["theta"].getValue() * PI / 180;
+	descriptor.s2 = mParams["phi"].getValue() * PI / 180;
+	descriptor.ds0 = 0;
+	descriptor.ds1 = spot_radius;
+	descriptor.ds2 = spot_radius;
+	descriptor.delta_T = mParams["delta_T"].getValue();
+
+	return true;
+}
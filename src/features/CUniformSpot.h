@@ -35,6 +35,7 @@ public:
 	}
 
 	void apply(CModel * model);
+	bool getDescriptor(CFeatureDescriptor & descriptor);
 };
 
 #endif /* CUNIFORMSPOT_H_ */
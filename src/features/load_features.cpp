@@ -20,6 +20,8 @@
 #include "CFeatureFactory.h"
 
 #include "CUniformSpot.h"
+#include "CAnalyticSpot.h"
+#include "CHealpixMap.h"
 
 namespace features {
 
@@ -27,6 +29,8 @@ void load()
 {
 	// TODO: For now we CMinimizerFactory::getInstance().addItem minimizers explicitly. In the future, we should use plugins instead.
 	CFeatureFactory::getInstance().addItem(&CUniformSpot::Create);
+	CFeatureFactory::getInstance().addItem(&CAnalyticSpot::Create);
+	CFeatureFactory::getInstance().addItem(&CHealpixMap::Create);
 }
 
 } // namespace models
@@ -89,13 +89,18 @@ int main(int argc, char *argv[])
     QStringList data_files;
     QString model_file;
     string minimizer_id = "";
-    string save_directory = "/tmp/model";
+    string save_directory = "";	// defaults to /tmp/model, see guiMain::run_command_line
     bool close_simtoi = false;
+    QString snapshot_in;
+    QString snapshot_out;
+    double auto_frame = 0;
+    Json::Value minimizer_settings;
 
     // If there were command-line options, parse them
     bool run_simtoi = false;
     if(args.size() > 0)
-    	run_simtoi = ParseArgs(args, data_files, model_file, minimizer_id, save_directory, close_simtoi);
+    	run_simtoi = ParseArgs(args, data_files, model_file, minimizer_id, save_directory, close_simtoi,
+    			snapshot_in, snapshot_out, auto_frame, minimizer_settings);
 
     if(run_simtoi)
     {
@@ -103,8 +108,9 @@ int main(int argc, char *argv[])
 		guiMain main_window;
 		main_window.show();
 
-		if(data_files.size() > 0 || model_file.size() > 0)
-			main_window.run_command_line(data_files, model_file, minimizer_id, save_directory, close_simtoi);
+		if(data_files.size() > 0 || model_file.size() > 0 || snapshot_in.size() > 0)
+			main_window.run_command_line(data_files, model_file, minimizer_id, save_directory, close_simtoi,
+					snapshot_in, snapshot_out, auto_frame, minimizer_settings);
 
 		return app.exec();
     }
@@ -113,7 +119,8 @@ int main(int argc, char *argv[])
 }
 
 /// Parse the command line arguments splitting them into data files, model files, minimizer names, model area size and model area scale
-bool ParseArgs(QStringList args, QStringList & filenames, QString & model_file, string &  minimizer, string & output_dir, bool & close_simtoi)
+bool ParseArgs(QStringList args, QStringList & filenames, QString & model_file, string &  minimizer, string & output_dir, bool & close_simtoi,
+		QString & snapshot_in, QString & snapshot_out, double & auto_frame, Json::Value & minimizer_settings)
 {
 	unsigned int n_items = args.size();
 
@@ -146,6 +153,43 @@ bool ParseArgs(QStringList args, QStringList & filenames, QString & model_file,
 		if(value == "-o")
 			output_dir = tmp.absoluteFilePath(args.at(i + 1)).toStdString();
 
+		// binary session snapshots
+		if(value == "--snapshot")
+			snapshot_out = tmp.absoluteFilePath(args.at(i + 1));
+
+		if(value == "--from-snapshot")
+			snapshot_in = tmp.absoluteFilePath(args.at(i + 1));
+
+		// evaluate part of a grid search, "i/n"
+		if(value == "--evaluator")
+		{
+			QStringList part = args.at(i + 1).split("/");
+			bool evaluator_ok = false;
+			bool evaluators_ok = false;
+			unsigned int evaluator = 0;
+			unsigned int evaluators = 0;
+			if(part.size() == 2)
+			{
+				evaluator = part[0].toUInt(&evaluator_ok);
+				evaluators = part[1].toUInt(&evaluators_ok);
+			}
+
+			if(!evaluator_ok || !evaluators_ok || evaluators < 1 || evaluator >= evaluators)
+			{
+				cerr << "Error: Invalid value '" << args.at(i + 1).toStdString() << "' for --evaluator, "
+					 << "expected i/n with 0 <= i < n." << endl;
+				exit(1);
+			}
+
+			// Passed to the grid search, see CGridSearch::Restore
+			minimizer_settings["evaluator"] = evaluator;
+			minimizer_settings["evaluators"] = evaluators;
+		}
+
+		// choose the model area from the data and models
+		if(value == "--auto-frame")
+			auto_frame = args.at(i + 1).toDouble();
+
 		if(value == "--list-engines")
 		{
 			run_simtoi = false;
@@ -216,6 +260,14 @@ void PrintHelp()
 	cout << "  " << "-e               : " << "Minimization engine ID (see Wiki)" << endl;
 	cout << "  " << "-m               : " << "Model input file" << endl;
 	cout << "  " << "-o               : " << "Output directory" << endl;
+	cout << "  " << "--snapshot       : " << "Write the models, data, and run settings to a binary " << endl;
+	cout << "  " << "                   " << "snapshot once all data is loaded" << endl;
+	cout << "  " << "--from-snapshot  : " << "Restore a session from a binary snapshot" << endl;
+	cout << "  " << "--auto-frame m   : " << "Choose the model area size and scale from the data " << endl;
+	cout << "  " << "                   " << "and models, sampling the longest baseline m times " << endl;
+	cout << "  " << "                   " << "finer than the Nyquist limit (e.g. 4)" << endl;
+	cout << "  " << "--evaluator i/n  : " << "Evaluate part i (0 ... n-1) of a grid search, for " << endl;
+	cout << "  " << "                   " << "running one grid on n processes [default: 0/1]" << endl;
 	cout << "  " << "--list-engines   : " << "Lists all registered minimization engines" << endl;
 	cout << "  " << "--list-models    : " << "Lists all registered models" << endl;
 	cout << "  " << "--list-features  : " << "Lists all registered features" << endl;
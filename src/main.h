@@ -23,12 +23,15 @@
 #include <string>
 #include <vector>
 
+#include "json/json.h"
+
 using namespace std;
 
 string EXE_FOLDER;
 
 int main(int argc, char** argv);
-bool ParseArgs(QStringList args, QStringList & filenames, QString & model_file, string &  minimizer, string & output_dir, bool & close_simtoi);
+bool ParseArgs(QStringList args, QStringList & filenames, QString & model_file, string &  minimizer, string & output_dir, bool & close_simtoi,
+		QString & snapshot_in, QString & snapshot_out, double & auto_frame, Json::Value & minimizer_settings);
 void PrintHelp();
 
 void printFactoryDescription(const vector<string> & ids, const vector<string> & names, const string & title);
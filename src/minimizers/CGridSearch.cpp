@@ -21,19 +21,36 @@
 #include "CGridSearch.h"
 
 #include <tuple>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif // _WIN32
+
 #include "CWorkerThread.h"
 #include "CModelList.h"
 
 using namespace std;
 
+const uint64_t CGridSearch::ChunkSize;
+const string CGridSearch::CheckpointVersion = "gridsearch_checkpoint 2";
+
 CGridSearch::CGridSearch()
 {
 	mID = "gridsearch";
 	mName = "Grid Search - global";
+
+	mEvaluator = 0;
+	mNEvaluators = 1;
 }
 
 CGridSearch::~CGridSearch() {
@@ -52,79 +69,351 @@ CMinimizerPtr CGridSearch::Create()
 /// mParams buffer.
 void CGridSearch::ExportResults()
 {
-	// Copy the best-fit parameters into the mParams buffer
-	for(unsigned int i = 0; i < mNParams; i++)
-		mParams[i] = mBestFit[i];
+	// Copy the best-fit parameters into the mParams buffer, if any point
+	// was evaluated.
+	if(mBestFit[mNParams] < std::numeric_limits<double>::infinity())
+	{
+		for(unsigned int i = 0; i < mNParams; i++)
+			mParams[i] = mBestFit[i];
+	}
 
 	// Call the base-class function:
 	CMinimizerThread::ExportResults();
 }
 
-/// \brief A recursive gridsearch function
+/// \brief Evaluates the grid points [start, end), writing each to mOutputFile.
 ///
-/// Recursively calls gridsearch until the final level is found. At this level
-/// the data are simulated and written to mOutputFile. Data are flushed to disk
-/// after a level %2 == 0 iteration completes.
-void CGridSearch::GridSearch(unsigned int level)
-{
-	// If we just set the last parameter, get the chi2r
-	if(level == mNParams)
-	{
-	  // Get the chi2r for the data set
-	  CModelListPtr model_list = mWorkerThread->GetModelList();
-	  model_list->SetFreeParameters(mParams, mNParams, false);
-	  mWorkerThread->GetChi(&mChis[0], mChis.size());
-	  double chi2r = ComputeChi2r(mChis, mNParams);
-
-	  // Save to the file
-	  //	  WriteRow(mParams, mNParams, chi2r, mOutputFile);
-
-	  // If this set of parameters fits better, replace the best-fit params.
-	  if(chi2r < mBestFit[mNParams])
-	    {
-	      for(int i = 0; i < mNParams; i++)
+/// Returns false if the minimizer was stopped before the chunk completed.
+bool CGridSearch::EvaluateChunk(uint64_t start, uint64_t end)
+{
+	CModelListPtr model_list = mWorkerThread->GetModelList();
+
+	for(uint64_t index = start; index < end; index++)
+	{
+		if(!mRun)
+			return false;
+
+		// Get the chi2r for the data set
+		GetGridPoint(index, mParams);
+		model_list->SetFreeParameters(mParams, mNParams, false);
+		mWorkerThread->GetChi(&mChis[0], mChis.size());
+		double chi2r = ComputeChi2r(mChis, mNParams);
+
+		// Save to the file
+		mOutputFile << index << ", ";
+		WriteRow(mParams, mNParams, chi2r, mOutputFile);
+
+		// If this set of parameters fits better, replace the best-fit params.
+		if(chi2r < mBestFit[mNParams])
+		{
+			for(int i = 0; i < mNParams; i++)
 				mBestFit[i] = mParams[i];
 
-	        mBestFit[mNParams] = chi2r;
+			mBestFit[mNParams] = chi2r;
 
-					printf("\tNew best CHI2r: %lf Params ", chi2r);
-					for(int i=0; i < mNParams; i++)
-					{
-					printf("#%d: %f \t", i, mBestFit[i]);
-					}
-					printf("\n");
-	    }
+			printf("\tNew best CHI2r: %lf Params ", chi2r);
+			for(int i=0; i < mNParams; i++)
+			{
+				printf("#%d: %f \t", i, mBestFit[i]);
+			}
+			printf("\n");
+		}
 	}
-	else	// Otherwise set the current parameter value and then recursively call the next level.
-	{
-	  double step = mSteps[level];
-	  double min = mMinMax[level].first;
-	  double max = mMinMax[level].second;
-	  for(double value = min; value < max; value += step)
-	    {
-	      if(!mRun)
-				break;
 
-	      if(level ==0)
-				{
-					printf("Top level steps: %d/%d -- Top level param %lf\n", (int)rint(fabs((value-min)/step)), (int)rint(fabs((max-min)/step))-1, value);
-				}
-	      mParams[level] = value;
-	      GridSearch(level + 1);
-	    }
+	return true;
+}
 
-	  // If we are on an even level, flush the results to a file.
-	  if(level % 2 == 0)
-	    mOutputFile.flush();
+/// \brief Computes the parameters of the grid point with the given
+/// (flattened) index. The last parameter varies fastest.
+void CGridSearch::GetGridPoint(uint64_t index, double * params)
+{
+	for(int i = mNParams - 1; i >= 0; i--)
+	{
+		params[i] = mMinMax[i].first + double(index % mNSteps[i]) * mSteps[i];
+		index /= mNSteps[i];
 	}
 }
 
+/// \brief Returns the number of points in the grid.
+uint64_t CGridSearch::GetNGridPoints()
+{
+	if(mNParams == 0)
+		return 0;
+
+	uint64_t n_points = 1;
+	for(auto n_steps: mNSteps)
+		n_points *= n_steps;
+
+	return n_points;
+}
+
 /// \brief Initialize the gridsearch minimizer.
 void CGridSearch::Init(shared_ptr<CWorkerThread> worker_thread)
 {
 	CMinimizerThread::Init(worker_thread);
 
 	mSteps.resize(mNParams);
+	mNSteps.resize(mNParams);
+}
+
+/// \brief Returns the path, less the extension, of the output and checkpoint
+/// files of an evaluator.
+string CGridSearch::GetBasename(unsigned int evaluator)
+{
+	stringstream basename;
+	basename << mSaveDirectory << "/gridsearch";
+	if(mNEvaluators > 1)
+		basename << "_" << evaluator << "_of_" << mNEvaluators;
+
+	return basename.str();
+}
+
+/// \brief Combines the results of all evaluators once the whole grid has
+/// been evaluated.
+///
+/// Returns false if an evaluator has not finished yet or another evaluator
+/// merges the outputs. Otherwise the best fit of the whole grid is stored in
+/// mBestFit and the rows of all evaluators are written to gridsearch.txt in
+/// index order.
+bool CGridSearch::MergeEvaluators(const vector<string> & names, uint64_t n_chunks)
+{
+	valarray<double> best_fit = mBestFit;
+	for(unsigned int evaluator = 0; evaluator < mNEvaluators; evaluator++)
+	{
+		uint64_t next_chunk = 0;
+		uint64_t output_size = 0;
+		valarray<double> evaluator_fit(std::numeric_limits<double>::infinity(), mNParams + 1);
+		if(!ReadCheckpoint(GetBasename(evaluator) + ".checkpoint", names, next_chunk, output_size, evaluator_fit))
+			return false;
+
+		if(next_chunk < n_chunks)
+			return false;
+
+		if(evaluator_fit[mNParams] < best_fit[mNParams])
+			best_fit = evaluator_fit;
+	}
+
+	// Evaluators finishing at the same time may all get here. Only the one
+	// which creates the lock file merges, the lock is removed when a new
+	// search starts.
+	FILE * lock = fopen(GetLockFilename().c_str(), "wx");
+	if(lock == NULL)
+		return false;
+
+	fclose(lock);
+	mBestFit = best_fit;
+
+	// Open the outputs of all evaluators and skip their headers.
+	vector<shared_ptr<ifstream> > inputs;
+	for(unsigned int evaluator = 0; evaluator < mNEvaluators; evaluator++)
+	{
+		const string filename = GetBasename(evaluator) + ".txt";
+		shared_ptr<ifstream> input = make_shared<ifstream>(filename.c_str());
+		if(!input->good())
+			throw runtime_error("Could not read the grid search output '" + filename + "'");
+
+		string line;
+		while(getline(*input, line) && line.compare(0, 7, "# Index") != 0)
+			continue;
+
+		inputs.push_back(input);
+	}
+
+	const string filename = mSaveDirectory + "/gridsearch.txt";
+	const string temp_filename = GetBasename(mEvaluator) + ".merge.tmp";
+	ofstream outfile(temp_filename.c_str(), ios::out | ios::trunc);
+	vector<string> header_names = names;
+	WriteHeader(header_names, outfile);
+	outfile << "# Index, Param0, Param1, ..., ParamN, chi2r" << endl;
+
+	// Chunk c was evaluated by evaluator c % n, whose output holds one row
+	// per point of its chunks in index order (see run).
+	const uint64_t n_points = GetNGridPoints();
+	for(uint64_t chunk = 0; chunk < n_chunks; chunk++)
+	{
+		ifstream & input = *inputs[chunk % mNEvaluators];
+		const uint64_t end = std::min((chunk + 1) * ChunkSize, n_points);
+
+		string line;
+		for(uint64_t index = chunk * ChunkSize; index < end; index++)
+		{
+			if(!getline(input, line))
+				throw runtime_error("The output of grid search evaluator " + to_string(chunk % mNEvaluators) + " is incomplete.");
+
+			outfile << line << '\n';
+		}
+	}
+
+	outfile.close();
+	if(outfile.fail())
+		throw runtime_error("Could not write the grid search output '" + temp_filename + "'");
+
+	ReplaceFile(temp_filename, filename);
+	return true;
+}
+
+/// \brief Returns the path of the file created by the evaluator which merges
+/// the outputs, see MergeEvaluators.
+string CGridSearch::GetLockFilename()
+{
+	return mSaveDirectory + "/gridsearch.merge.lock";
+}
+
+/// \brief Restores the next chunk, the size of the output and the best fit
+/// from a checkpoint.
+///
+/// The best fit (parameters followed by chi2r) is only changed if the
+/// checkpoint has one. Returns false if there is no checkpoint. Throws if the
+/// checkpoint was written for a different grid or by an older version.
+bool CGridSearch::ReadCheckpoint(const string & filename, const vector<string> & names,
+		uint64_t & next_chunk, uint64_t & output_size, valarray<double> & best_fit)
+{
+	ifstream infile(filename.c_str());
+	if(!infile.good())
+		return false;
+
+	const string mismatch = "The grid search checkpoint '" + filename
+			+ "' does not match the current grid. Remove it to restart the search.";
+
+	// Format, see WriteCheckpoint:
+	//   gridsearch_checkpoint version
+	//   n_params next_chunk output_size n_best [chi2r params...]
+	//   min step n_steps name		(one line per parameter)
+	string line;
+	getline(infile, line);
+	if(line != CheckpointVersion)
+		throw runtime_error(mismatch);
+
+	getline(infile, line);
+	stringstream header(line);
+
+	unsigned int n_params = 0;
+	unsigned int n_best = 0;
+	header >> n_params >> next_chunk >> output_size >> n_best;
+	if(header.fail() || n_params != mNParams)
+		throw runtime_error(mismatch);
+
+	if(n_best > 0)
+	{
+		header >> best_fit[mNParams];
+		for(unsigned int i = 0; i < mNParams; i++)
+			header >> best_fit[i];
+	}
+
+	if(header.fail())
+		throw runtime_error("Could not read the grid search checkpoint '" + filename + "'");
+
+	for(unsigned int i = 0; i < mNParams; i++)
+	{
+		getline(infile, line);
+		stringstream parameter(line);
+
+		double min = 0;
+		double step = 0;
+		uint64_t n_steps = 0;
+		string name;
+		parameter >> min >> step >> n_steps;
+		parameter.get();
+		getline(parameter, name);
+
+		if(infile.fail() || parameter.fail() || min != mMinMax[i].first || step != mSteps[i]
+				|| n_steps != mNSteps[i] || name != names[i])
+			throw runtime_error(mismatch);
+	}
+
+	return true;
+}
+
+/// \brief Replaces filename with temp_filename.
+void CGridSearch::ReplaceFile(const string & temp_filename, const string & filename)
+{
+	// rename does not replace existing files on all platforms.
+	if(rename(temp_filename.c_str(), filename.c_str()) != 0)
+	{
+		remove(filename.c_str());
+		if(rename(temp_filename.c_str(), filename.c_str()) != 0)
+			throw runtime_error("Could not write '" + filename + "'");
+	}
+}
+
+/// \brief Truncates filename to size bytes.
+///
+/// Throws if the file is shorter, that is, if rows which the checkpoint
+/// counts as written are missing.
+void CGridSearch::TruncateFile(const string & filename, uint64_t size)
+{
+	ifstream infile(filename.c_str(), ios::in | ios::binary | ios::ate);
+	if(!infile.good() || uint64_t(infile.tellg()) < size)
+		throw runtime_error("The grid search output '" + filename
+				+ "' is shorter than its checkpoint. Remove the checkpoint to restart the search.");
+
+	infile.close();
+
+#ifndef _WIN32
+	int error = truncate(filename.c_str(), off_t(size));
+#else
+	int error = -1;
+	int fd = _open(filename.c_str(), _O_RDWR | _O_BINARY);
+	if(fd >= 0)
+	{
+		error = _chsize_s(fd, size);
+		_close(fd);
+	}
+#endif // _WIN32
+
+	if(error != 0)
+		throw runtime_error("Could not truncate the grid search output '" + filename + "'");
+}
+
+/// \brief Saves the grid, the next chunk, the size of the output and the
+/// best fit to a checkpoint.
+///
+/// The checkpoint is written to a temporary file which then replaces the
+/// previous checkpoint, so a failure never leaves a partial checkpoint.
+void CGridSearch::WriteCheckpoint(const string & filename, const vector<string> & names,
+		uint64_t next_chunk, uint64_t output_size)
+{
+	const string temp_filename = filename + ".tmp";
+
+	ofstream outfile(temp_filename.c_str(), ios::out | ios::trunc);
+	outfile.precision(17);
+	outfile << CheckpointVersion << endl;
+	outfile << mNParams << " " << next_chunk << " " << output_size;
+
+	if(mBestFit[mNParams] < std::numeric_limits<double>::infinity())
+	{
+		outfile << " 1 " << mBestFit[mNParams];
+		for(unsigned int i = 0; i < mNParams; i++)
+			outfile << " " << mBestFit[i];
+	}
+	else
+		outfile << " 0";
+
+	outfile << endl;
+
+	// The grid, so a checkpoint is only used for the grid it was written for.
+	for(unsigned int i = 0; i < mNParams; i++)
+		outfile << mMinMax[i].first << " " << mSteps[i] << " " << mNSteps[i] << " " << names[i] << endl;
+
+	outfile.close();
+	if(outfile.fail())
+		throw runtime_error("Could not write the grid search checkpoint '" + temp_filename + "'");
+
+	ReplaceFile(temp_filename, filename);
+}
+
+/// \brief Restores the part of the grid evaluated by this process:
+///		{"evaluator": e, "evaluators": n}
+/// see the class description and the --evaluator command line option.
+void CGridSearch::Restore(Json::Value input)
+{
+	unsigned int evaluator = input.get("evaluator", 0).asUInt();
+	unsigned int evaluators = input.get("evaluators", 1).asUInt();
+	if(evaluators < 1 || evaluator >= evaluators)
+		throw runtime_error("Invalid grid search evaluator, see --evaluator.");
+
+	mEvaluator = evaluator;
+	mNEvaluators = evaluators;
 }
 
 /// \brief Run the gridsearch minimzer
@@ -144,30 +433,113 @@ void CGridSearch::run()
 			throw runtime_error("Step size for one parameter is zero. Please fix and try again!");
 	}
 
+	// Count the values of each parameter, min + i * step < max.
+	for(unsigned int i = 0; i < mNParams; i++)
+	{
+		const double min = mMinMax[i].first;
+		const double max = mMinMax[i].second;
+		uint64_t n_steps = (max > min) ? uint64_t(ceil((max - min) / mSteps[i])) : 0;
+		while(n_steps > 0 && min + double(n_steps - 1) * mSteps[i] >= max)
+			n_steps--;
+
+		mNSteps[i] = n_steps;
+	}
+
+	const uint64_t n_points = GetNGridPoints();
+	const uint64_t n_chunks = (n_points + ChunkSize - 1) / ChunkSize;
+
 	// Resize the best-fit parameter array to hold the best-fit parameters
 	// and their chi2r (as the last element)
 	mBestFit.resize(mNParams + 1);
 	mBestFit[mNParams] = std::numeric_limits<double>::infinity();	// Init the best-fit chi2r to some bogus value.
 
-	// Open the statistics file for writing:
-	stringstream filename;
-	filename.str("");
-	filename << mSaveDirectory << "/gridsearch.txt";
-	mOutputFile.open(filename.str().c_str());
-	mOutputFile.width(15);
-	mOutputFile.precision(8);
-	// write a somewhat descriptive header
-	mOutputFile << "# Param0, Param1, ..., ParamN, chi2r" << endl;
+	// Each evaluator has its own output and checkpoint files.
+	const string basename = GetBasename(mEvaluator);
+	const string checkpoint = basename + ".checkpoint";
+	uint64_t next_chunk = mEvaluator;
+	uint64_t output_size = 0;
+	bool resume = ReadCheckpoint(checkpoint, names, next_chunk, output_size, mBestFit);
+
+	// Open the statistics file for writing, or appending if we resume. Rows
+	// written after the checkpoint belong to an unfinished chunk and are
+	// discarded, so every point appears exactly once.
+	string filename = basename + ".txt";
+	if(resume)
+	{
+		TruncateFile(filename, output_size);
+		mOutputFile.open(filename.c_str(), ios::out | ios::app);
+	}
+	else
+	{
+		// A new search, so the outputs may be merged again.
+		remove(GetLockFilename().c_str());
+
+		mOutputFile.open(filename.c_str(), ios::out | ios::trunc);
+
+		// write a somewhat descriptive header
+		WriteHeader(names, mOutputFile);
+		mOutputFile << "# Index, Param0, Param1, ..., ParamN, chi2r" << endl;
+		output_size = uint64_t(mOutputFile.tellp());
+	}
+
+	if(!mOutputFile.good())
+		throw runtime_error("Could not write the grid search output '" + filename + "'");
 
 	// run the minimizer
 	mIsRunning = true;
 	cout << "\nGrid search minimization started\n";
-	GridSearch(0);
+	if(resume)
+		cout << "Resuming from chunk " << next_chunk + 1 << " of " << n_chunks << endl;
+
+	bool completed = true;
+	for(uint64_t chunk = next_chunk; chunk < n_chunks; chunk += mNEvaluators)
+	{
+		const uint64_t start = chunk * ChunkSize;
+		const uint64_t end = std::min(start + ChunkSize, n_points);
+		printf("Grid chunk %llu/%llu -- points %llu to %llu of %llu\n",
+				(unsigned long long) chunk + 1, (unsigned long long) n_chunks,
+				(unsigned long long) start, (unsigned long long) end - 1,
+				(unsigned long long) n_points);
+
+		if(!EvaluateChunk(start, end))
+		{
+			completed = false;
+			break;
+		}
+
+		mOutputFile.flush();
+		if(!mOutputFile.good())
+			throw runtime_error("Could not write the grid search output '" + filename + "'");
+
+		output_size = uint64_t(mOutputFile.tellp());
+		WriteCheckpoint(checkpoint, names, chunk + mNEvaluators, output_size);
+	}
+
 	mIsRunning = false;
        	mOutputFile.close();
 
+	// Mark this part of the grid as done, even if it had no chunks, so that
+	// the last evaluator to finish can merge the results.
+	bool partial = !completed;
+	if(completed)
+	{
+		WriteCheckpoint(checkpoint, names, n_chunks, output_size);
+		if(mNEvaluators > 1)
+			partial = !MergeEvaluators(names, n_chunks);
+	}
+
 	// Print the actual parameters
-	cout << "\nGrid search results\n";
+	if(partial)
+	{
+		cout << "\nPartial grid search results";
+		if(mNEvaluators > 1)
+			cout << " (evaluator " << mEvaluator << " of " << mNEvaluators
+				 << ", the evaluator which merges the outputs reports the results for the whole grid)";
+		cout << "\n";
+	}
+	else
+		cout << "\nGrid search results\n";
+
 	printf("Lowest chi2 achieved: %f\n", mBestFit[mNParams]);
 	printf("Best-fit parameters:\n");
 	for(int i=0; i < mNParams; i++)
@@ -175,6 +547,16 @@ void CGridSearch::run()
 		printf("  P[%d] = %f (%s)\n", i, mBestFit[i], names[i].c_str());
 	}
 
-	// Export the results.
-	ExportResults();
+	// Export the results. Evaluators share the save directory, so only the
+	// results for the whole grid are exported.
+	if(partial && mNEvaluators > 1)
+	{
+		if(mBestFit[mNParams] < std::numeric_limits<double>::infinity())
+		{
+			for(unsigned int i = 0; i < mNParams; i++)
+				mParams[i] = mBestFit[i];
+		}
+	}
+	else
+		ExportResults();
 }
@@ -21,17 +21,48 @@
 #ifndef CGRIDSEARCH_H_
 #define CGRIDSEARCH_H_
 
+#include <cstdint>
+
 #include "CMinimizerThread.h"
 
+/// \brief Evaluates chi2r on a regular grid of the free parameters.
+///
+/// Grid points are addressed by a flattened index (the last parameter varies
+/// fastest) and the parameter values are computed from the index, so they
+/// do not accumulate rounding errors. The grid is split into chunks of
+/// ChunkSize points. Several SIMTOI processes may share one grid, see the
+/// --evaluator command line option and Restore: evaluator e of n evaluates
+/// the chunks c with c % n == e.
+///
+/// Every point is written to gridsearch.txt (gridsearch_e_of_n.txt) as
+/// "index, params..., chi2r". After each chunk the file is flushed and the
+/// next chunk and the best fit so far are saved to a checkpoint file, along
+/// with the grid (min, step, number of steps and name of each parameter). If
+/// a checkpoint for the same grid exists the search resumes from it. The
+/// checkpoint also holds the size of the output, which is truncated to it
+/// on resume, so rows of an unfinished chunk are not repeated.
+///
+/// With several evaluators, the first to find that all of them have finished
+/// creates gridsearch.merge.lock, merges the outputs into gridsearch.txt and
+/// reports and exports the best fit of the whole grid. The others only
+/// report the best fit of their part of the grid. The lock is removed when
+/// a new search starts.
 class CGridSearch: public CMinimizerThread
 {
     protected:
         vector< pair<double, double> > mMinMax;
         vector<double> mSteps;
+        vector<uint64_t> mNSteps;	///< Number of values of each parameter
+        unsigned int mEvaluator;	///< Part of the grid evaluated by this process, see Restore
+        unsigned int mNEvaluators;
         ofstream mOutputFile;
 
         valarray<double> mBestFit;
 
+    public:
+        static const uint64_t ChunkSize = 1024;
+        static const string CheckpointVersion;	///< First line of checkpoint files
+
     public:
         CGridSearch();
         virtual ~CGridSearch();
@@ -40,10 +71,28 @@ class CGridSearch: public CMinimizerThread
 
         void ExportResults();
 
-        void GridSearch(unsigned int level);
+    protected:
+        bool EvaluateChunk(uint64_t start, uint64_t end);
+
+    public:
+        void GetGridPoint(uint64_t index, double * params);
+        uint64_t GetNGridPoints();
 
         virtual void Init(shared_ptr<CWorkerThread> worker_thread);
 
+    protected:
+        string GetBasename(unsigned int evaluator);
+        string GetLockFilename();
+        bool MergeEvaluators(const vector<string> & names, uint64_t n_chunks);
+        bool ReadCheckpoint(const string & filename, const vector<string> & names,
+                uint64_t & next_chunk, uint64_t & output_size, valarray<double> & best_fit);
+        static void ReplaceFile(const string & temp_filename, const string & filename);
+        static void TruncateFile(const string & filename, uint64_t size);
+        void WriteCheckpoint(const string & filename, const vector<string> & names,
+                uint64_t next_chunk, uint64_t output_size);
+
+    public:
+        virtual void Restore(Json::Value input);
         void run();
 };
 
@@ -180,6 +180,14 @@ void CCylinder::GenerateRim(vector<vec3> & vertices, vector<unsigned int> & elem
 	}
 }
 
+/// Returns the distance from the center to the rim of either face.
+double CCylinder::GetBoundingRadius()
+{
+	const double radius = mParams["diameter"].getValue() / 2;
+	const double half_height = mParams["height"].getValue() / 2;
+	return sqrt(radius * radius + half_height * half_height);
+}
+
 void CCylinder::Init()
 {
 	// Generate the verticies and elements
@@ -277,7 +285,7 @@ void CCylinder::Render(const glm::mat4 & view, const GLfloat & max_flux)
 
 	// bind to this object's texture, upload the image.
 	glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, mFluxTexture.size(), 1, 0, GL_RGBA,
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, mFluxTexture.size(), 1, 0, GL_RGBA,
 			GL_FLOAT, &mFluxTexture[0]);
 
 	// Render
@@ -56,6 +56,8 @@ public:
 	static void GenerateRim(vector<vec3> & vertices, vector<unsigned int> & elements,
 			unsigned int z_divisions, unsigned int phi_divisions);
 
+	double GetBoundingRadius();
+
 	void Init();
 
 	void preRender(double & max_flux);
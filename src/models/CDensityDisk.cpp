@@ -24,11 +24,16 @@
  *  midplane by a triangle fan. This rendering method is suitable for disks
  *  seen edge-on, but probably not for other inclinations.
  *
- *  This base class has four parameters:
+ *  Alternatively, the disk may be rendered volumetrically. In this mode a
+ *  single bounding box is rasterized and the fragment shader integrates the
+ *  density along each line of sight (see disk_raymarch_frag.glsl).
+ *
+ *  This base class has five parameters:
  *  	r_in : the disk model's inner radius
  *  	r_cutoff : the radius at which rendering will stop
  *  	h_cutoff : the height (z) at which rendering will stop
  *  	n_rings : the number of rings in the model
+ *  	volumetric : render by ray marching (1) instead of concentric rings (0)
  *  The radial and height cutoffs should be defined to be sufficiently large
  *  as to not cut off meaningful density distribution. This requires some
  *  manual tweaking by the user.
@@ -50,6 +55,7 @@ CDensityDisk::CDensityDisk()
 	addParameter("r_cutoff", 20, 0.1, 20, false, 1.0, "Radial cutoff", "Cutoff radius beyond which the model will not exist", 2);
 	addParameter("h_cutoff", 5, 0.1, 10, false, 1.0, "Height cutoff", "Cutoff height beyond which the model will not exist", 2);
 	addParameter("n_rings", 50, 1, 100, false, 1, "N Rings", "An integer number of rings used in the model", 0);
+	addParameter("volumetric", 0, 0, 1, false, 1, "Volumetric", "Ray march through the density distribution (1) instead of rendering concentric rings (0)", 0);
 
 	// We load the default shader, but this should be replaced by something more
 	// specific later.
@@ -66,7 +72,50 @@ CDensityDisk::~CDensityDisk()
 
 }
 
+/// Generates a box spanning (x, y = -1 ... 1, z = -0.5 ... 0.5) which serves
+/// as the proxy geometry for volumetric rendering. The box is scaled in the
+/// same way as the cylindrical walls.
+void CDensityDisk::GenerateBoundingBox(vector<vec3> & vertices, vector<unsigned int> & elements,
+		unsigned int vertex_offset)
+{
+	// The number of vec3s that define a (complete) vertex
+	const unsigned int n_vec3_per_vertex = 3;
 
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		double x = (i & 1) ? 1.0 : -1.0;
+		double y = (i & 2) ? 1.0 : -1.0;
+		double z = (i & 4) ? 0.5 : -0.5;
+		vertices.push_back(vec3(x, y, z)); // vertex position
+		vertices.push_back(vec3(x, y, z)); // normal vector
+		vertices.push_back(vec3(1, 0, 0)); // texture vector
+	}
+
+	// Two triangles per face
+	const unsigned int faces[12][3] = {
+			{0, 2, 1}, {1, 2, 3},	// z = -0.5
+			{4, 5, 6}, {5, 7, 6},	// z = +0.5
+			{0, 1, 4}, {1, 5, 4},	// y = -1
+			{2, 6, 3}, {3, 6, 7},	// y = +1
+			{0, 4, 2}, {2, 4, 6},	// x = -1
+			{1, 3, 5}, {3, 7, 5}};	// x = +1
+
+	for(unsigned int i = 0; i < 12; i++)
+	{
+		for(unsigned int j = 0; j < 3; j++)
+			elements.push_back(n_vec3_per_vertex * faces[i][j] + vertex_offset);
+	}
+}
+
+
+
+/// Returns a radius enclosing the radial and height cutoffs.
+double CDensityDisk::GetBoundingRadius()
+{
+	const double r_cutoff = mParams["r_cutoff"].getValue();
+	const double h_cutoff = mParams["h_cutoff"].getValue();
+	return sqrt(r_cutoff * r_cutoff + h_cutoff * h_cutoff);
+}
 
 void CDensityDisk::Init()
 {
@@ -86,6 +135,11 @@ void CDensityDisk::Init()
 	mMidplaneStart = mRimSize;
 	CCylinder::GenerateMidplane(vbo_data, elements, vertex_offset, r_divisions, phi_divisions);
 	mMidplaneSize = elements.size() - mRimSize;
+	// Append the bounding box used for volumetric rendering.
+	vertex_offset = vbo_data.size();
+	mBoxStart = elements.size();
+	GenerateBoundingBox(vbo_data, elements, vertex_offset);
+	mBoxSize = elements.size() - mBoxStart;
 
 	// Create a new Vertex Array Object, Vertex Buffer Object, and Element Buffer
 	// object to store the model's information.
@@ -138,6 +192,7 @@ void CDensityDisk::Render(const glm::mat4 & view, const GLfloat & max_flux)
 	const double r_cutoff  = mParams["r_cutoff"].getValue();
 	const double h_cutoff  = mParams["h_cutoff"].getValue();
 	int n_rings  = ceil(mParams["n_rings"].getValue());
+	const bool volumetric = mParams["volumetric"].getValue() > 0.5;
 
 	NormalizeFlux(max_flux);
 
@@ -165,45 +220,66 @@ void CDensityDisk::Render(const glm::mat4 & view, const GLfloat & max_flux)
 	GLint uniInnerRadius = glGetUniformLocation(shader_program, "r_in");
 	glUniform1f(uniInnerRadius, r_in - 0.01);
 
-	// Look up the scale variable location. We use it below.
-	GLint uniScale = glGetUniformLocation(shader_program, "scale");
+	// Look up the ring geometry variables. We use them below.
+	GLint uniRingStart = glGetUniformLocation(shader_program, "ring_r_start");
+	GLint uniRingDr = glGetUniformLocation(shader_program, "ring_dr");
+	GLint uniRingHeight = glGetUniformLocation(shader_program, "ring_height");
 
 	// bind to this object's texture
 	glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
 	// upload the image
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, mFluxTexture.size(), 1, 0, GL_RGBA,
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, mFluxTexture.size(), 1, 0, GL_RGBA,
 			GL_FLOAT, &mFluxTexture[0]);
 
 	// disable detph testing and backface culling, we need to render the whole thing.
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);
 
-	// Render each cylindrical wall:
+	GLint uniVolumetric = glGetUniformLocation(shader_program, "volumetric");
+	glUniform1i(uniVolumetric, volumetric);
+
+	if(volumetric)
+	{
+		// March along the line of sight, expressed in model coordinates. Both
+		// the front and back faces of the box are rasterized, but the ray from
+		// the far face exits immediately so each pixel is integrated once.
+		glm::mat3 model_view = glm::mat3(view * Translate() * Rotate());
+		glm::vec3 direction = glm::normalize(glm::inverse(model_view) * glm::vec3(0.0, 0.0, -1.0));
 
-    // Init scale variables
-	double radius = 0;
-	double height = h_cutoff;
+		GLint uniDirection = glGetUniformLocation(shader_program, "ray_direction");
+		glUniform3fv(uniDirection, 1, glm::value_ptr(direction));
 
-    glm::mat4 scale;
-    glm::mat4 r_scale;
-    glm::mat4 h_scale = glm::scale(mat4(1.0f), glm::vec3(1.0, 1.0, height));
+		GLint uniBoxMax = glGetUniformLocation(shader_program, "ray_box_max");
+		glUniform3f(uniBoxMax, r_cutoff, r_cutoff, 0.5 * h_cutoff);
 
-    // Render each of the concentric rings
-	double dr = (r_cutoff - r_in) / (n_rings - 1);
-	for(unsigned int i = 0; i < n_rings; i++)
-	{
-		// Scale the radius:
-		radius = r_in + i * dr;
-		r_scale = glm::scale(mat4(1.0f), glm::vec3(radius, radius, 1.0));
-		scale = h_scale * r_scale;
+		// The nominal step resolves the (thin) vertical structure of the disk.
+		GLint uniStep = glGetUniformLocation(shader_program, "ray_step");
+		glUniform1f(uniStep, h_cutoff / 64);
 
-		glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
-		glDrawElements(GL_TRIANGLE_STRIP, mRimSize, GL_UNSIGNED_INT, 0);
+		glUniform1f(uniRingStart, r_cutoff);
+		glUniform1f(uniRingDr, 0);
+		glUniform1f(uniRingHeight, h_cutoff);
+		glDrawElements(GL_TRIANGLES, mBoxSize, GL_UNSIGNED_INT, (void*) (mBoxStart * sizeof(float)));
+
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glBindTexture(GL_TEXTURE_RECTANGLE, 0);
+
+		CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed.");
+		return;
 	}
 
+	// Render all of the cylindrical walls in one instanced call. The vertex
+	// shader computes the radius of each ring from gl_InstanceID.
+	double dr = (n_rings > 1) ? (r_cutoff - r_in) / (n_rings - 1) : 0;
+	glUniform1f(uniRingStart, r_in);
+	glUniform1f(uniRingDr, dr);
+	glUniform1f(uniRingHeight, h_cutoff);
+	glDrawElementsInstanced(GL_TRIANGLE_STRIP, mRimSize, GL_UNSIGNED_INT, 0, n_rings);
+
 	// Render the midplane
-	r_scale = glm::scale(mat4(1.0f), glm::vec3(r_cutoff, r_cutoff, 1.0));
-	glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
+	glUniform1f(uniRingStart, r_cutoff);
+	glUniform1f(uniRingDr, 0);
 	glDrawElements(GL_TRIANGLE_STRIP, mMidplaneSize, GL_UNSIGNED_INT, (void*) (mMidplaneStart * sizeof(float)));
 
 	glEnable(GL_CULL_FACE);
@@ -215,6 +291,25 @@ void CDensityDisk::Render(const glm::mat4 & view, const GLfloat & max_flux)
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed.");
 }
 
+/// Restores the model. Save files written before the instanced ring shaders
+/// were introduced name the plain disk shader, which is replaced by its ring
+/// variant here.
+void CDensityDisk::Restore(Json::Value input)
+{
+	CModel::Restore(input);
+
+	const string suffix = "_rings";
+	string shader_id = mShader->ID();
+	if(shader_id.size() < suffix.size() ||
+		shader_id.compare(shader_id.size() - suffix.size(), suffix.size(), suffix) != 0)
+	{
+		auto shaders = CShaderFactory::Instance();
+		auto shader = shaders.CreateShader(shader_id + suffix);
+		shader->restore(mShader->serialize());
+		mShader = shader;
+	}
+}
+
 /// Overrides the default CModel::SetShader function.
 void CDensityDisk::SetShader(CShaderPtr shader)
 {
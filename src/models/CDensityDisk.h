@@ -30,6 +30,8 @@ class CDensityDisk: public CModel
 	unsigned int mRimSize;
 	unsigned int mMidplaneStart;
 	unsigned int mMidplaneSize;
+	unsigned int mBoxStart;
+	unsigned int mBoxSize;
 
 	GLuint mVAO;
 	GLuint mVBO;
@@ -39,10 +41,16 @@ public:
 	CDensityDisk();
 	virtual ~CDensityDisk();
 
+	static void GenerateBoundingBox(vector<vec3> & vertices, vector<unsigned int> & elements,
+			unsigned int vertex_offset);
+
+	double GetBoundingRadius();
+
 	void Init();
 
 	void preRender(double & max_flux);
 	void Render(const glm::mat4 & view, const GLfloat & max_flux);
+	virtual void Restore(Json::Value input); // Overrides CModel::Restore
 
 	virtual void SetShader(CShaderPtr shader); // Overrides CModel::SetShader
 
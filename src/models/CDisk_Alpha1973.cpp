@@ -32,7 +32,7 @@ CDisk_Alpha1973::CDisk_Alpha1973():CDensityDisk()
 
 	// This model ALWAYS uses the Andrews 2009 disk shader.
 	auto shaders = CShaderFactory::Instance();
-	mShader = shaders.CreateShader("disk_alpha1973");
+	mShader = shaders.CreateShader("disk_alpha1973_rings");
 }
 
 CDisk_Alpha1973::~CDisk_Alpha1973()
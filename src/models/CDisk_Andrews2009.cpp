@@ -31,7 +31,7 @@ CDisk_Andrews2009::CDisk_Andrews2009()
 
 	// This model ALWAYS uses the Andrews 2009 disk shader.
 	auto shaders = CShaderFactory::Instance();
-	mShader = shaders.CreateShader("disk_andrews2009");
+	mShader = shaders.CreateShader("disk_andrews2009_rings");
 }
 
 CDisk_Andrews2009::~CDisk_Andrews2009()
@@ -36,7 +36,7 @@ CDisk_ConcentricRings::CDisk_ConcentricRings()
 
 	// We load the power-law shader by default.
 	auto shaders = CShaderFactory::Instance();
-	mShader = shaders.CreateShader("disk_power_law");
+	mShader = shaders.CreateShader("disk_power_law_rings");
 
 	// Resize the texture, 1 element is sufficient.
 	mFluxTexture.resize(1);
@@ -53,6 +53,14 @@ shared_ptr<CModel> CDisk_ConcentricRings::Create()
 	return shared_ptr<CModel>(new CDisk_ConcentricRings());
 }
 
+/// Returns a radius enclosing the outer-most ring at its full height.
+double CDisk_ConcentricRings::GetBoundingRadius()
+{
+	const double radius = mParams["radius"].getValue();
+	const double height = mParams["height"].getValue();
+	return sqrt(radius * radius + height * height);
+}
+
 void CDisk_ConcentricRings::Init()
 
 {
@@ -158,45 +166,32 @@ void CDisk_ConcentricRings::Render(const glm::mat4 & view, const GLfloat & max_f
 	GLint uniRotation = glGetUniformLocation(shader_program, "rotation");
 	glUniformMatrix4fv(uniRotation, 1, GL_FALSE, glm::value_ptr(Rotate()));
 
-	// Look up the scale variable location. We use it below.
-	GLint uniScale = glGetUniformLocation(shader_program, "scale");
+	// Look up the ring geometry variables. We use them below.
+	GLint uniRingStart = glGetUniformLocation(shader_program, "ring_r_start");
+	GLint uniRingDr = glGetUniformLocation(shader_program, "ring_dr");
+	GLint uniRingHeight = glGetUniformLocation(shader_program, "ring_height");
 
 	// bind to this object's texture
 	glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
 	// upload the image
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, mFluxTexture.size(), 1, 0, GL_RGBA,
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, mFluxTexture.size(), 1, 0, GL_RGBA,
 			GL_FLOAT, &mFluxTexture[0]);
 
 	// Disable depth testing and face culling, we need both sides to render
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);
 
-	// Render each cylindrical wall:
-
-    // Init scale variables
-	double radius = 0;
-	double height = MaxHeight;
-
-    glm::mat4 scale;
-    glm::mat4 r_scale;
-    glm::mat4 h_scale = glm::scale(mat4(1.0f), glm::vec3(1.0, 1.0, height));
-
-    // Render each of the concentric rings
-	double dr = (MaxRadius - r_in) / (n_rings - 1);
-	for(unsigned int i = 0; i < n_rings; i++)
-	{
-		// Scale the radius:
-		radius = r_in + i * dr;
-		r_scale = glm::scale(mat4(1.0f), glm::vec3(radius, radius, 1.0));
-		scale = h_scale * r_scale;
-
-		glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
-		glDrawElements(GL_TRIANGLE_STRIP, mRimSize, GL_UNSIGNED_INT, 0);
-	}
+	// Render all of the cylindrical walls in one instanced call. The vertex
+	// shader computes the radius of each ring from gl_InstanceID.
+	double dr = (n_rings > 1) ? (MaxRadius - r_in) / (n_rings - 1) : 0;
+	glUniform1f(uniRingStart, r_in);
+	glUniform1f(uniRingDr, dr);
+	glUniform1f(uniRingHeight, MaxHeight);
+	glDrawElementsInstanced(GL_TRIANGLE_STRIP, mRimSize, GL_UNSIGNED_INT, 0, n_rings);
 
 	// Render the midplane
-	r_scale = glm::scale(mat4(1.0f), glm::vec3(MaxRadius, MaxRadius, 1.0));
-	glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
+	glUniform1f(uniRingStart, MaxRadius);
+	glUniform1f(uniRingDr, 0);
 	glDrawElements(GL_TRIANGLE_STRIP, mMidplaneSize, GL_UNSIGNED_INT, (void*) (mMidplaneStart * sizeof(float)));
 
 	// Disable depth testing and face culling
@@ -209,6 +204,25 @@ void CDisk_ConcentricRings::Render(const glm::mat4 & view, const GLfloat & max_f
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed.");
 }
 
+/// Restores the model. Save files written before the instanced ring shaders
+/// were introduced name the plain disk shader, which is replaced by its ring
+/// variant here.
+void CDisk_ConcentricRings::Restore(Json::Value input)
+{
+	CModel::Restore(input);
+
+	const string suffix = "_rings";
+	string shader_id = mShader->ID();
+	if(shader_id.size() < suffix.size() ||
+		shader_id.compare(shader_id.size() - suffix.size(), suffix.size(), suffix) != 0)
+	{
+		auto shaders = CShaderFactory::Instance();
+		auto shader = shaders.CreateShader(shader_id + suffix);
+		shader->restore(mShader->serialize());
+		mShader = shader;
+	}
+}
+
 /// Overrides the default CModel::SetShader function.
 void CDisk_ConcentricRings::SetShader(CShaderPtr shader)
 {
@@ -43,10 +43,13 @@ public:
 
 	virtual string GetID() { return "disk_concentric_rings"; };
 
+	double GetBoundingRadius();
+
 	void Init();
 
 	void preRender(double & max_flux);
 	void Render(const glm::mat4 & view, const GLfloat & max_flux);
+	virtual void Restore(Json::Value input); // Overrides CModel::Restore
 
 	virtual void SetShader(CShaderPtr shader); // Overrides CModel::SetShader
 
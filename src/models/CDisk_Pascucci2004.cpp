@@ -46,7 +46,7 @@ CDisk_Pascucci2004::CDisk_Pascucci2004()
 
 	// This model ALWAYS uses the default (pass-through) shader.
 	auto shaders = CShaderFactory::Instance();
-	mShader = shaders.CreateShader("disk_pascucci2004");
+	mShader = shaders.CreateShader("disk_pascucci2004_rings");
 }
 
 CDisk_Pascucci2004::~CDisk_Pascucci2004()
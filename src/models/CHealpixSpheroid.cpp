@@ -18,6 +18,11 @@
  */
 
 #include "CHealpixSpheroid.h"
+#include "CFeature.h"
+
+#include <algorithm>
+#include <iostream>
+#include <QtConcurrentMap>
 
 CHealpixSpheroid::CHealpixSpheroid() :
 	CModel()
@@ -27,9 +32,23 @@ CHealpixSpheroid::CHealpixSpheroid() :
 	mEBO = 0;
 
 	n_pixels = 0;
+	mSurfaceReady = false;
+	mBuffersDirty = false;
+	mElementsDirty = false;
+	mLODError = 0;
+	mFinestOrder = 0;
+	mRefinementLOS = vec3(0, 0, 1);
 
 	addParameter("n_side_power", 4, 1, 10, false, 1, "Healpix subdivisions",
 			"The square of this number becomes the number of pixels per healpix pixel. A value of 4-6 is often adequate.", 0);
+	addParameter("auto_lod", 0, 0, 1, false, 1, "Auto LOD",
+			"Choose the Healpix subdivisions from the model size and image scale (1) or use the value given (0)", 0);
+	addParameter("facets_per_pixel", 4, 0.25, 64, false, 1, "Facets per pixel",
+			"Target number of Healpix facets per image pixel used by Auto LOD", 2);
+	addParameter("refine_levels", 0, 0, 4, false, 1, "Refinement levels",
+			"Number of times facets near the limb or feature edges are subdivided (0 = uniform tesselation)", 0);
+	addParameter("refine_limb_mu", 0.2, 0, 1, false, 0.05, "Refinement limb mu",
+			"Facets whose |mu| is below this value are refined", 2);
 	addParameter("r_pole", 1, 1, 10, false, 1, "R_pole", "Radius at the pole (mas)", 4);
 }
 
@@ -40,6 +59,184 @@ CHealpixSpheroid::~CHealpixSpheroid()
 	if(mVAO) glDeleteVertexArrays(1, &mVAO);
 }
 
+/// Applies all features to the surface temperatures in a single pass.
+///
+/// Features which provide a `CFeatureDescriptor` are gathered into flat arrays
+/// and composed onto `mBaseTemperatures` with one sweep over the pixels. When
+/// the base temperatures are unchanged (`base_dirty == false`) only the pixel
+/// ranges covered by dirty features, before and after their change, are
+/// recomputed. Features without a descriptor fall back to `CFeature::apply`
+/// and force a full update.
+void CHealpixSpheroid::ApplyFeatures(bool base_dirty)
+{
+	const unsigned int n_features = mFeatures.size();
+	const double polar_radius = mParams["r_pole"].getValue();
+
+	bool full_update = base_dirty || (mFeatureRanges.size() != n_features);
+	mFeatureX.resize(n_features);
+	mFeatureY.resize(n_features);
+	mFeatureZ.resize(n_features);
+	mFeatureR2.resize(n_features);
+	mFeatureDeltaT.resize(n_features);
+
+	mSpotCenters.clear();
+	mSpotCosRadii.clear();
+	mSpotDeltaT.clear();
+
+	// Gather the feature descriptors. The geometry here matches FindPixels.
+	vector<unsigned int> dirty_features;
+	vector<CFeaturePtr> generic_features;
+	CFeatureDescriptor descriptor;
+	for(unsigned int j = 0; j < n_features; j++)
+	{
+		auto feature = mFeatures[j];
+
+		// Analytic spots are handed to the shader and never touch the
+		// temperatures. Any spots beyond what the shader supports are
+		// composed on the CPU like regular features.
+		if(feature->isAnalytic() && mSpotCenters.size() < MAX_ANALYTIC_SPOTS
+				&& feature->getDescriptor(descriptor))
+		{
+			const double theta = descriptor.s1;
+			const double phi = descriptor.s2;
+			const double surface_radius = pixel_radii[FindPixel(theta, phi)];
+			mSpotCenters.push_back(vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), cos(theta)));
+			mSpotCosRadii.push_back(cos(FeatureAngularRadius(descriptor, surface_radius)));
+			mSpotDeltaT.push_back(descriptor.delta_T);
+
+			mFeatureX[j] = mFeatureY[j] = mFeatureZ[j] = 0;
+			mFeatureR2[j] = -1;
+			mFeatureDeltaT[j] = 0;
+			continue;
+		}
+
+		if(!feature->getDescriptor(descriptor))
+		{
+			// A negative radius never matches, so this entry is skipped
+			// during composition.
+			mFeatureX[j] = mFeatureY[j] = mFeatureZ[j] = 0;
+			mFeatureR2[j] = -1;
+			mFeatureDeltaT[j] = 0;
+			generic_features.push_back(feature);
+			continue;
+		}
+
+		if(feature->isDirty())
+			dirty_features.push_back(j);
+
+		const double theta = descriptor.s1;
+		const double phi = descriptor.s2;
+		const long target_pixel = FindPixel(theta, phi);
+		const double target_radius = pixel_radii[target_pixel];
+		const double max_distance = polar_radius *
+				std::sqrt(descriptor.ds1 * descriptor.ds1 + descriptor.ds2 * descriptor.ds2);
+
+		mFeatureX[j] = target_radius * cos(phi) * sin(theta);
+		mFeatureY[j] = target_radius * sin(phi) * sin(theta);
+		mFeatureZ[j] = target_radius * cos(theta);
+		mFeatureR2[j] = max_distance * max_distance;
+		mFeatureDeltaT[j] = descriptor.delta_T;
+	}
+
+	if(generic_features.size() > 0)
+		full_update = true;
+
+	if(full_update)
+	{
+		mFeatureRanges.assign(n_features, pair<unsigned int, unsigned int>(0, 0));
+		ComposeFeatures(0, n_pixels, true);
+
+		for(auto feature: generic_features)
+			feature->apply(this);
+	}
+	else
+	{
+		// Recompute the pixels the dirty features used to cover and now cover.
+		for(auto j: dirty_features)
+		{
+			pair<unsigned int, unsigned int> old_range = mFeatureRanges[j];
+			pair<unsigned int, unsigned int> new_range = FindFeatureRange(j);
+
+			ComposeFeatures(old_range.first, old_range.second, false);
+			ComposeFeatures(new_range.first, new_range.second, false);
+			mFeatureRanges[j] = new_range;
+		}
+	}
+
+	for(auto feature: mFeatures)
+		feature->clearFlags();
+}
+
+/// Sets the temperature of pixels [start, end) to the base temperature plus
+/// the contribution of every feature covering the pixel. If `record_ranges`
+/// is set, the pixel range covered by each feature is stored in
+/// `mFeatureRanges`.
+void CHealpixSpheroid::ComposeFeatures(unsigned int start, unsigned int end, bool record_ranges)
+{
+	const unsigned int n_features = mFeatureR2.size();
+	const double * f_x = mFeatureX.data();
+	const double * f_y = mFeatureY.data();
+	const double * f_z = mFeatureZ.data();
+	const double * f_r2 = mFeatureR2.data();
+	const double * f_dT = mFeatureDeltaT.data();
+
+	for(unsigned int i = start; i < end; i++)
+	{
+		const double radius = pixel_radii[i];
+		const double x = pixel_xyz[i].x * radius;
+		const double y = pixel_xyz[i].y * radius;
+		const double z = pixel_xyz[i].z * radius;
+
+		double temperature = mBaseTemperatures[i];
+		for(unsigned int j = 0; j < n_features; j++)
+		{
+			const double dx = x - f_x[j];
+			const double dy = y - f_y[j];
+			const double dz = z - f_z[j];
+			const bool covered = (dx * dx + dy * dy + dz * dz) <= f_r2[j];
+
+			temperature += covered ? f_dT[j] : 0;
+
+			if(record_ranges && covered)
+			{
+				pair<unsigned int, unsigned int> & range = mFeatureRanges[j];
+				if(range.first == range.second)
+					range.first = i;
+				range.second = i + 1;
+			}
+		}
+
+		mPixelTemperatures[i] = temperature;
+	}
+}
+
+/// Returns the pixel range [first, last) covered by the specified feature.
+pair<unsigned int, unsigned int> CHealpixSpheroid::FindFeatureRange(unsigned int feature_index)
+{
+	const double f_x = mFeatureX[feature_index];
+	const double f_y = mFeatureY[feature_index];
+	const double f_z = mFeatureZ[feature_index];
+	const double f_r2 = mFeatureR2[feature_index];
+
+	pair<unsigned int, unsigned int> range(0, 0);
+	for(unsigned int i = 0; i < n_pixels; i++)
+	{
+		const double radius = pixel_radii[i];
+		const double dx = pixel_xyz[i].x * radius - f_x;
+		const double dy = pixel_xyz[i].y * radius - f_y;
+		const double dz = pixel_xyz[i].z * radius - f_z;
+
+		if(dx * dx + dy * dy + dz * dz <= f_r2)
+		{
+			if(range.first == range.second)
+				range.first = i;
+			range.second = i + 1;
+		}
+	}
+
+	return range;
+}
+
 /// Finds pixels on the surface of the sphere using sphere-sphere intersection
 /// testing.
 void CHealpixSpheroid::FindPixels(double radius, double theta, double phi,
@@ -47,9 +244,7 @@ void CHealpixSpheroid::FindPixels(double radius, double theta, double phi,
 			vector<unsigned int> &pixels_ids)
 {
 	// Look up the (x,y,z) position of the target (r, theta, phi) center.
-	long target_pixel = 0;
-	const unsigned int n_sides = pow(2, mParams["n_side_power"].getValue());
-	ang2pix_nest(n_sides, theta, phi, &target_pixel);
+	long target_pixel = FindPixel(theta, phi);
 	double pixel_radius = pixel_radii[target_pixel];
 
 	vec3 temp = pixel_xyz[target_pixel];
@@ -82,8 +277,488 @@ void CHealpixSpheroid::FindPixels(double radius, double theta, double phi,
 }
 
 
+/// Returns the index of the facet containing the direction (theta, phi).
+long CHealpixSpheroid::FindPixel(double theta, double phi)
+{
+	// Locate the cell at the finest order, then find the facet whose range
+	// of descendants contains it.
+	long fine_pixel = 0;
+	ang2pix_nest(1L << mFinestOrder, theta, phi, &fine_pixel);
+
+	auto it = upper_bound(mCellStart.begin(), mCellStart.end(),
+			(unsigned long long) fine_pixel);
+	if(it == mCellStart.begin())
+		return 0;
+
+	return (it - mCellStart.begin()) - 1;
+}
+
+/// Computes the flux of the visible surface on the CPU, see `CModel::GetAnalyticFlux`.
+///
+/// The surface is updated exactly as it would be for rendering (see
+/// `UpdateSurface`, no OpenGL calls are made) and each facet contributes
+///		B(T) * I(mu) * (projected area)
+/// where mu is taken from the facet normal, as in the shaders. Facets (or the
+/// triangles making them up) which face away from the observer are clipped at
+/// the horizon. Large tesselations are split across threads.
+double CHealpixSpheroid::GetAnalyticFlux()
+{
+	// Facets per thread below which threading is not worthwhile
+	const unsigned int chunk_size = 16384;
+
+	double max_flux = 0;
+	UpdateSurface(max_flux);
+	UpdateLimbDarkening();
+
+	const mat4 rotation = Rotate();
+	if(n_pixels < 2 * chunk_size)
+		return IntegrateFlux(rotation, 0, n_pixels);
+
+	// Each chunk stores its range and, after integration, its flux.
+	struct CFluxChunk
+	{
+		unsigned int start;
+		unsigned int end;
+		double flux;
+	};
+
+	vector<CFluxChunk> chunks;
+	for(unsigned int start = 0; start < n_pixels; start += chunk_size)
+		chunks.push_back({start, min(start + chunk_size, n_pixels), 0});
+
+	QtConcurrent::blockingMap(chunks, [this, &rotation](CFluxChunk & chunk)
+	{
+		chunk.flux = IntegrateFlux(rotation, chunk.start, chunk.end);
+	});
+
+	// Sum in a fixed order so the result does not depend on the scheduling.
+	double flux = 0;
+	for(auto & chunk: chunks)
+		flux += chunk.flux;
+
+	return flux;
+}
+
+/// Healpix models have an analytic flux when their shader's limb darkening law
+/// can be evaluated on the CPU.
+bool CHealpixSpheroid::HasAnalyticFlux()
+{
+	return HasAnalyticLimbDarkening();
+}
+
+/// Integrates the flux of facets [start, end), see `GetAnalyticFlux`.
+double CHealpixSpheroid::IntegrateFlux(const mat4 & rotation, unsigned int start, unsigned int end)
+{
+	// c2 / lambda, see UploadAnalyticSpots
+	const double c2_lambda = 0.0143877696 / mWavelength;
+	const unsigned int n_facets = end - start;
+
+	// The model's rotation as doubles. Only the first two rows are needed to
+	// project onto the sky, the third gives mu.
+	double r[3][3];
+	for(unsigned int i = 0; i < 3; i++)
+		for(unsigned int j = 0; j < 3; j++)
+			r[i][j] = rotation[j][i];
+
+	// First pass: projected areas and mu. This loop is branch-free so the
+	// compiler can vectorize it.
+	vector<double> areas(n_facets);
+	vector<double> mus(n_facets);
+	for(unsigned int k = 0; k < n_facets; k++)
+	{
+		const unsigned int i = start + k;
+
+		double x[4];
+		double y[4];
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			const vec3 & c = corner_xyz[4*i + j];
+			const double radius = corner_radii[4*i + j];
+			x[j] = radius * (r[0][0] * c.x + r[0][1] * c.y + r[0][2] * c.z);
+			y[j] = radius * (r[1][0] * c.x + r[1][1] * c.y + r[1][2] * c.z);
+		}
+
+		// The facet is drawn as the triangles (0,1,3) and (3,1,2), see
+		// GenerateHealpixVBOIndicies. Their corners are counter-clockwise
+		// when seen from outside, so a negative area faces away from us.
+		const double a0 = 0.5 * ((x[1] - x[0]) * (y[3] - y[0]) - (x[3] - x[0]) * (y[1] - y[0]));
+		const double a1 = 0.5 * ((x[1] - x[3]) * (y[2] - y[3]) - (x[2] - x[3]) * (y[1] - y[3]));
+		areas[k] = max(a0, 0.0) + max(a1, 0.0);
+
+		const double g = sqrt(g_x[i] * g_x[i] + g_y[i] * g_y[i] + g_z[i] * g_z[i]);
+		const double n_z = r[2][0] * g_x[i] + r[2][1] * g_y[i] + r[2][2] * g_z[i];
+		mus[k] = min(fabs(n_z) / g, 1.0);
+	}
+
+	// Second pass: limb darkening and analytic spots for the visible facets.
+	double flux = 0;
+	for(unsigned int k = 0; k < n_facets; k++)
+	{
+		if(areas[k] <= 0)
+			continue;
+
+		const unsigned int i = start + k;
+		double brightness = mFluxTexture[i].r;
+
+		// Analytic spots, evaluated at the facet center (see analytic_spots_frag.glsl)
+		const double T = mFluxTexture[i].g;
+		double delta_T = 0;
+		for(unsigned int j = 0; j < mSpotCenters.size(); j++)
+		{
+			if(glm::dot(pixel_xyz[i], mSpotCenters[j]) >= mSpotCosRadii[j])
+				delta_T += mSpotDeltaT[j];
+		}
+
+		if(delta_T != 0 && T > 0)
+		{
+			const double x = c2_lambda / T;
+			const double x_spot = c2_lambda / max(T + delta_T, 1.0);
+			brightness *= exp(x - x_spot) * (1.0 - exp(-x)) / (1.0 - exp(-x_spot));
+		}
+
+		flux += brightness * Intensity(mus[k]) * areas[k];
+	}
+
+	return flux;
+}
+
+/// Builds the list of facets which make up the surface.
+///
+/// The surface starts as a uniform NESTED Healpix sphere at `n_side_power`.
+/// When `refine_levels` is non-zero, cells are replaced by their four nested
+/// children (recursively, up to `refine_levels` times) if they lie close to
+/// the limb (|mu| < refine_limb_mu) or if the edge of a feature passes through
+/// them. The limb test uses the radial direction as a proxy for the surface
+/// normal, which is adequate for the mildly distorted stars modeled here.
+///
+/// Neighbouring facets are then kept within one order of each other (see
+/// BalanceCells) so that the T-junctions at level boundaries can be stitched
+/// by GenerateVBO.
+///
+/// The facets are stored in NESTED order, so every other per-pixel quantity
+/// (radii, gravity, temperatures) simply runs over the facet list.
+void CHealpixSpheroid::GenerateCells()
+{
+	const unsigned int base_order = mParams["n_side_power"].getValue();
+	const unsigned int levels = mParams["refine_levels"].getValue();
+
+	mFinestOrder = base_order + levels;
+	mRefinementLOS = LineOfSight();
+	FindFeatureEdges(mEdgeCenters, mEdgeRadii);
+
+	mCellOrder.clear();
+	mCellIndex.clear();
+	mCellStart.clear();
+
+	const long n_base = nside2npix(1L << base_order);
+	for(long i = 0; i < n_base; i++)
+		RefineCell(base_order, i);
+
+	if(levels > 1)
+		BalanceCells();
+
+	n_pixels = mCellOrder.size();
+}
+
+/// Splits facets until no facet shares an edge with a facet more than one
+/// order finer (a 2:1 balance). Every coarse edge then has at most one
+/// hanging vertex, see FindHangingVertices.
+void CHealpixSpheroid::BalanceCells()
+{
+	vec3 center;
+	vec3 corners[4];
+	vec3 midpoints[4];
+	vector<bool> split;
+
+	while(true)
+	{
+		const unsigned int n_cells = mCellOrder.size();
+		split.assign(n_cells, false);
+
+		bool changed = false;
+		for(unsigned int i = 0; i < n_cells; i++)
+		{
+			if(mCellOrder[i] + 1 >= mFinestOrder)
+				continue;
+
+			// A neighbour two orders finer covers at most a quarter of the
+			// edge, so probe each half of the edge at its middle.
+			CellEdges(mCellOrder[i], mCellIndex[i], center, corners, midpoints);
+			for(unsigned int j = 0; j < 4 && !split[i]; j++)
+			{
+				const vec3 quarter[2] = {glm::normalize(corners[j] + midpoints[j]),
+						glm::normalize(midpoints[j] + corners[(j + 1) % 4])};
+				for(unsigned int k = 0; k < 2 && !split[i]; k++)
+				{
+					const long neighbour = EdgeNeighbour(center, quarter[k]);
+					split[i] = (mCellOrder[neighbour] > mCellOrder[i] + 1);
+				}
+			}
+
+			changed |= split[i];
+		}
+
+		if(!changed)
+			break;
+
+		// Replace the split cells by their children. Children follow their
+		// parent in NESTED order, so the list remains sorted.
+		vector<unsigned int> orders;
+		vector<long> indices;
+		vector<unsigned long long> starts;
+		for(unsigned int i = 0; i < n_cells; i++)
+		{
+			if(!split[i])
+			{
+				orders.push_back(mCellOrder[i]);
+				indices.push_back(mCellIndex[i]);
+				starts.push_back(mCellStart[i]);
+				continue;
+			}
+
+			const unsigned int order = mCellOrder[i] + 1;
+			for(long k = 0; k < 4; k++)
+			{
+				const long index = 4 * mCellIndex[i] + k;
+				orders.push_back(order);
+				indices.push_back(index);
+				starts.push_back((unsigned long long) index << (2 * (mFinestOrder - order)));
+			}
+		}
+
+		mCellOrder.swap(orders);
+		mCellIndex.swap(indices);
+		mCellStart.swap(starts);
+	}
+}
+
+/// Computes the center, corners and edge midpoints of a NESTED cell.
+/// Edge j runs from corner j to corner j + 1 (in the N, W, S, E order of
+/// pix2vec_nest). The midpoints are the corners the cell's children share
+/// with the neighbouring cell, thus they coincide with the corners of finer
+/// neighbours.
+void CHealpixSpheroid::CellEdges(unsigned int order, long index, vec3 & center,
+		vec3 corners[4], vec3 midpoints[4])
+{
+	double t_center[3];
+	double t_corners[12];
+	pix2vec_nest(1L << order, index, t_center, t_corners);
+	center = vec3(t_center[0], t_center[1], t_center[2]);
+
+	for(unsigned int j = 0; j < 4; j++)
+		corners[j] = vec3(t_corners[3*j], t_corners[3*j + 1], t_corners[3*j + 2]);
+
+	// The corners of the four children.
+	vec3 children[16];
+	for(long k = 0; k < 4; k++)
+	{
+		pix2vec_nest(1L << (order + 1), 4 * index + k, t_center, t_corners);
+		for(unsigned int j = 0; j < 4; j++)
+			children[4*k + j] = vec3(t_corners[3*j], t_corners[3*j + 1], t_corners[3*j + 2]);
+	}
+
+	// Healpix edges are not great circles, so pick the child corner nearest
+	// to the chord midpoint rather than using the chord midpoint itself.
+	for(unsigned int j = 0; j < 4; j++)
+	{
+		const vec3 target = glm::normalize(corners[j] + corners[(j + 1) % 4]);
+		float best = -2;
+		for(unsigned int k = 0; k < 16; k++)
+		{
+			const float d = glm::dot(children[k], target);
+			if(d > best)
+			{
+				best = d;
+				midpoints[j] = children[k];
+			}
+		}
+	}
+}
+
+/// Returns the facet on the other side of the edge, at the specified point
+/// on the edge, of a cell with the specified center.
+long CHealpixSpheroid::EdgeNeighbour(const vec3 & center, const vec3 & edge_point)
+{
+	// Step a quarter of the finest cell outward from the edge.
+	const double step = 0.25 * sqrt(PI / 3) / (1L << mFinestOrder);
+	vec3 outward = edge_point - center * glm::dot(center, edge_point);
+	vec3 point = glm::normalize(edge_point + float(step) * glm::normalize(outward));
+
+	double t_point[3] = {point.x, point.y, point.z};
+	double theta = 0;
+	double phi = 0;
+	vec2ang(t_point, &theta, &phi);
+
+	return FindPixel(theta, phi);
+}
+
+/// Finds the hanging vertices of the tesselation, that is the corners of
+/// facets which lie on the edge of a coarser facet. For each edge j of facet
+/// i, `mEdgeVertex[4*i + j]` is the index of the finer neighbour's corner
+/// (into corner_xyz and corner_radii) at the edge midpoint, or -1 if the edge
+/// has no hanging vertex. GenerateVBO inserts these vertices into the coarse
+/// facet so that no cracks open between levels.
+void CHealpixSpheroid::FindHangingVertices()
+{
+	mEdgeVertex.assign(4 * n_pixels, -1);
+
+	if(mParams["refine_levels"].getValue() < 1)
+		return;
+
+	vec3 center;
+	vec3 corners[4];
+	vec3 midpoints[4];
+	for(unsigned int i = 0; i < n_pixels; i++)
+	{
+		if(mCellOrder[i] >= mFinestOrder)
+			continue;
+
+		CellEdges(mCellOrder[i], mCellIndex[i], center, corners, midpoints);
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			const long neighbour = EdgeNeighbour(center, midpoints[j]);
+			if(mCellOrder[neighbour] <= mCellOrder[i])
+				continue;
+
+			int best_corner = 4 * neighbour;
+			float best = -2;
+			for(unsigned int k = 0; k < 4; k++)
+			{
+				const float d = glm::dot(corner_xyz[4*neighbour + k], midpoints[j]);
+				if(d > best)
+				{
+					best = d;
+					best_corner = 4 * neighbour + k;
+				}
+			}
+
+			mEdgeVertex[4*i + j] = best_corner;
+		}
+	}
+}
+
+/// Finds the edges of features which are composed on the CPU. Analytic spots
+/// are evaluated per-fragment and do not require refinement.
+void CHealpixSpheroid::FindFeatureEdges(vector<vec3> & centers, vector<double> & radii)
+{
+	centers.clear();
+	radii.clear();
+
+	if(mParams["refine_levels"].getValue() < 1)
+		return;
+
+	CFeatureDescriptor descriptor;
+	for(auto feature: mFeatures)
+	{
+		if(feature->isAnalytic() || !feature->getDescriptor(descriptor))
+			continue;
+
+		const double theta = descriptor.s1;
+		const double phi = descriptor.s2;
+		centers.push_back(vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), cos(theta)));
+		radii.push_back(FeatureAngularRadius(descriptor, mParams["r_pole"].getValue()));
+	}
+}
+
+/// Returns the angular radius of the region covered by a feature on a surface
+/// of the specified radius.
+///
+/// ApplyFeatures covers every pixel within a chord of r_pole * sqrt(ds1^2 + ds2^2)
+/// of the feature center. Analytic spots and the refinement use the angle
+/// subtended by this chord so all paths agree on the size of a feature.
+double CHealpixSpheroid::FeatureAngularRadius(const CFeatureDescriptor & descriptor, double surface_radius)
+{
+	const double polar_radius = mParams["r_pole"].getValue();
+	const double chord = polar_radius *
+			sqrt(descriptor.ds1 * descriptor.ds1 + descriptor.ds2 * descriptor.ds2);
+
+	if(surface_radius <= 0)
+		surface_radius = polar_radius;
+
+	return 2 * asin(min(chord / (2 * surface_radius), 1.0));
+}
+
+/// Returns the direction towards the observer in model coordinates.
+vec3 CHealpixSpheroid::LineOfSight()
+{
+	// Rotate() takes model to view coordinates and the observer looks down
+	// the z-axis, thus the line of sight is the third row of the rotation.
+	mat4 rotation = Rotate();
+	return glm::normalize(vec3(rotation[0][2], rotation[1][2], rotation[2][2]));
+}
+
+/// Determines if the adaptive tesselation is out of date because the limb
+/// moved by more than half of a base cell or a feature edge moved.
+bool CHealpixSpheroid::RefinementChanged()
+{
+	if(mParams["refine_levels"].getValue() < 1)
+		return false;
+
+	const double base_size = sqrt(PI / 3) / pow(2, mParams["n_side_power"].getValue());
+	const double cos_angle = glm::dot(LineOfSight(), mRefinementLOS);
+	if(acos(min(cos_angle, 1.0)) > 0.5 * base_size)
+		return true;
+
+	vector<vec3> centers;
+	vector<double> radii;
+	FindFeatureEdges(centers, radii);
+	if(centers.size() != mEdgeCenters.size())
+		return true;
+
+	// Tolerate motion below a quarter of the finest cell.
+	const double tolerance = 0.25 * sqrt(PI / 3) / pow(2, mFinestOrder);
+	for(unsigned int i = 0; i < centers.size(); i++)
+	{
+		const double moved = acos(min(double(glm::dot(centers[i], mEdgeCenters[i])), 1.0));
+		if(moved > tolerance || fabs(radii[i] - mEdgeRadii[i]) > tolerance)
+			return true;
+	}
+
+	return false;
+}
+
+/// Appends the specified cell to the facet list, or its children if the cell
+/// needs to be refined (see GenerateCells).
+void CHealpixSpheroid::RefineCell(unsigned int order, long index)
+{
+	bool refine = false;
+
+	if(order < mFinestOrder)
+	{
+		// Angular size of the cell, sqrt(4 pi / (12 n_side^2)). This bounds
+		// the distance from the cell center to its corners.
+		const double cell_size = sqrt(PI / 3) / (1L << order);
+		const double limb_mu = mParams["refine_limb_mu"].getValue();
+
+		double t_center[3];
+		double t_corners[12];
+		pix2vec_nest(1L << order, index, t_center, t_corners);
+		const vec3 center(t_center[0], t_center[1], t_center[2]);
+
+		double mu = glm::dot(center, mRefinementLOS);
+		refine = fabs(mu) < limb_mu + cell_size;
+
+		for(unsigned int j = 0; j < mEdgeCenters.size() && !refine; j++)
+		{
+			const double distance = acos(min(max(double(glm::dot(center, mEdgeCenters[j])), -1.0), 1.0));
+			refine = fabs(distance - mEdgeRadii[j]) < cell_size;
+		}
+	}
+
+	if(refine)
+	{
+		for(long k = 0; k < 4; k++)
+			RefineCell(order + 1, 4 * index + k);
+		return;
+	}
+
+	mCellOrder.push_back(order);
+	mCellIndex.push_back(index);
+	mCellStart.push_back((unsigned long long) index << (2 * (mFinestOrder - order)));
+}
+
 /// Creates a Healpix sphere by computing the pixel and coordinate vector
-/// locations and (phi, theta) values.
+/// locations and (phi, theta) values for the facets listed by GenerateCells.
 void CHealpixSpheroid::GenerateHealpixSphere(unsigned int n_pixels, unsigned int n_sides)
 {
 	// Resize the input vectors to match the image.
@@ -99,10 +774,6 @@ void CHealpixSpheroid::GenerateHealpixSphere(unsigned int n_pixels, unsigned int
 	corner_phi.resize(4 * n_pixels);	// four corners per Healpix pixel
 	corner_radii.resize(4 * n_pixels);	// four corners per Healpix pixel
 
-	// Temporary double vectors to interface with Healpix's routines:
-	vector<double> t_pixel_xyz(3);
-	vector<double> t_corner_xyz(12);
-
 	// Iterate over each pixel in the Healpix image
 	for(unsigned int i = 0; i < n_pixels; i++)
 	{
@@ -110,23 +781,35 @@ void CHealpixSpheroid::GenerateHealpixSphere(unsigned int n_pixels, unsigned int
 		mFluxTexture[i].r = float(i) / n_pixels;
 		mFluxTexture[i].a = 1.0;
 
-		// Compute the vertex locations for the center and (four) corners
-		// of the pixels.
-		pix2vec_nest(n_sides, i, &t_pixel_xyz[0], &t_corner_xyz[0]);
+		GenerateFacet(i);
+	}
 
-		// Copy the pixel location from the temporary buffer into the storage buffer.
-		pixel_xyz[i] = vec3(t_pixel_xyz[0], t_pixel_xyz[1], t_pixel_xyz[2]);
+	FindHangingVertices();
+}
 
-		// Compute the (theta, phi) values for the center of each pixel
-		pix2ang_nest(n_sides, i, &pixel_theta[i], &pixel_phi[i]);
+/// Computes the center and corner locations, and their (theta, phi) values,
+/// of facet i. Each facet may be at a different order.
+void CHealpixSpheroid::GenerateFacet(unsigned int i)
+{
+	// Temporary double vectors to interface with Healpix's routines:
+	double t_pixel_xyz[3];
+	double t_corner_xyz[12];
 
-		// Compute the (theta, phi) values for each of the (four) corners
-		for(unsigned int j = 0; j < 4; j++)
-		{
-			vec2ang(&t_corner_xyz[3*j], &corner_theta[4*i + j], &corner_phi[4*i + j]);
-			// Copy the corner location into the storage buffer
-			corner_xyz[4*i + j] = vec3(t_corner_xyz[3*j + 0], t_corner_xyz[3*j + 1], t_corner_xyz[3*j + 2]);
-		}
+	const long cell_nside = 1L << mCellOrder[i];
+	pix2vec_nest(cell_nside, mCellIndex[i], t_pixel_xyz, t_corner_xyz);
+
+	// Copy the pixel location from the temporary buffer into the storage buffer.
+	pixel_xyz[i] = vec3(t_pixel_xyz[0], t_pixel_xyz[1], t_pixel_xyz[2]);
+
+	// Compute the (theta, phi) values for the center of each pixel
+	pix2ang_nest(cell_nside, mCellIndex[i], &pixel_theta[i], &pixel_phi[i]);
+
+	// Compute the (theta, phi) values for each of the (four) corners
+	for(unsigned int j = 0; j < 4; j++)
+	{
+		vec2ang(&t_corner_xyz[3*j], &corner_theta[4*i + j], &corner_phi[4*i + j]);
+		// Copy the corner location into the storage buffer
+		corner_xyz[4*i + j] = vec3(t_corner_xyz[3*j + 0], t_corner_xyz[3*j + 1], t_corner_xyz[3*j + 2]);
 	}
 }
 
@@ -146,17 +829,51 @@ void	CHealpixSpheroid::GenerateHealpixVBOIndicies(unsigned int n_pixels, vector<
 	// vertex indices (0,1,3) and (3,1,2). Each vertex is a vec3, thus these
 	// vertex indices are multiplied by 3 to yield (0,3,9) and (9,3,6).
 
+	//
+	// Facets with hanging vertices (see FindHangingVertices) are instead
+	// drawn as a fan around their center through the corners and hanging
+	// vertices, matching the layout written by GenerateVBO.
+	unsigned int start = 0;
 	for (unsigned int i = 0; i < n_pixels; i++)
 	{
-		elements.push_back(12 * i + 0);
-		elements.push_back(12 * i + 3);
-		elements.push_back(12 * i + 9);
-		elements.push_back(12 * i + 9);
-		elements.push_back(12 * i + 3);
-		elements.push_back(12 * i + 6);
+		const unsigned int n_hanging = HangingVertexCount(i);
+		if(n_hanging == 0)
+		{
+			elements.push_back(start + 0);
+			elements.push_back(start + 3);
+			elements.push_back(start + 9);
+			elements.push_back(start + 9);
+			elements.push_back(start + 3);
+			elements.push_back(start + 6);
+			start += 12;
+			continue;
+		}
+
+		// The center is followed by the ring of corners and hanging vertices.
+		const unsigned int n_ring = 4 + n_hanging;
+		for(unsigned int k = 0; k < n_ring; k++)
+		{
+			elements.push_back(start);
+			elements.push_back(start + 3 * (1 + k));
+			elements.push_back(start + 3 * (1 + (k + 1) % n_ring));
+		}
+		start += 3 * (1 + n_ring);
 	}
 }
 
+/// Returns the number of hanging vertices on the edges of facet i.
+unsigned int CHealpixSpheroid::HangingVertexCount(unsigned int i)
+{
+	if(mEdgeVertex.size() < 4 * (i + 1))
+		return 0;
+
+	unsigned int n = 0;
+	for(unsigned int j = 0; j < 4; j++)
+		n += (mEdgeVertex[4*i + j] >= 0);
+
+	return n;
+}
+
 /// Creates the VBO from the corners, radii, and gravity buffers.
 void CHealpixSpheroid::GenerateVBO(unsigned int n_pixels, unsigned int n_side, vector<vec3> & vbo_data)
 {
@@ -166,42 +883,324 @@ void CHealpixSpheroid::GenerateVBO(unsigned int n_pixels, unsigned int n_side, v
 	// Iterate over each Healpix pixel
 	for (unsigned int i = 0; i < n_pixels; i++)
 	{
+		// set the surface normals, remember to normalize!
+		const vec3 normal = glm::normalize( vec3(g_x[i], g_y[i], g_z[i]) );
+		// set the texture coordinates
+		const vec3 tex_coords = vec3(i % (12 * n_side), i / (12 * n_side), 0);
+
+		// Facets with hanging vertices start with their center, see
+		// GenerateHealpixVBOIndicies.
+		const bool stitched = HangingVertexCount(i) > 0;
+		if(stitched)
+		{
+			vbo_data.push_back(pixel_xyz[i] * float(pixel_radii[i]));
+			vbo_data.push_back(normal);
+			vbo_data.push_back(tex_coords);
+		}
+
 		// There are four corners per pixel to define
 		for (unsigned int j = 0; j < 4; j++)
 		{
 			// Convert the unit-radius vertices to Roche surface radii
 			// by scaling and append to the vector.
 			vbo_data.push_back(corner_xyz[4*i + j] * float(corner_radii[i * 4 + j]));
+			vbo_data.push_back(normal);
+			vbo_data.push_back(tex_coords);
+
+			// The hanging vertex is a corner of the finer neighbour, so the
+			// two facets share the exact same position.
+			const int hanging = stitched ? mEdgeVertex[4*i + j] : -1;
+			if(hanging >= 0)
+			{
+				vbo_data.push_back(corner_xyz[hanging] * float(corner_radii[hanging]));
+				vbo_data.push_back(normal);
+				vbo_data.push_back(tex_coords);
+			}
+		}
+	}
+}
+
+
+/// Chooses `n_side_power` from the projected size of the model, the image
+/// scale, and the requested number of facets per image pixel.
+///
+/// The visible hemisphere contains 6 * n_side^2 facets which project onto
+/// pi * R^2 / scale^2 image pixels, thus
+///		n_side = (R / scale) * sqrt(facets_per_pixel * pi / 6).
+/// The chosen level is rounded up to the next power of two. When the level
+/// changes it is reported along with the estimated facet size in pixels.
+void CHealpixSpheroid::UpdateLOD()
+{
+	if(mParams["auto_lod"].getValue() < 0.5 || mImageScale <= 0)
+		return;
+
+	// Use the largest radius from the last surface solution, if available.
+	double radius = mParams["r_pole"].getValue();
+	for(unsigned int i = 0; i < pixel_radii.size(); i++)
+	{
+		if(pixel_radii[i] > radius)
+			radius = pixel_radii[i];
+	}
+
+	const double facets_per_pixel = mParams["facets_per_pixel"].getValue();
+	const double n_side = radius / mImageScale * sqrt(facets_per_pixel * PI / 6);
+
+	CParameter & n_side_power = mParams["n_side_power"];
+	double power = ceil(log2(max(n_side, 1.0)));
+	power = min(max(power, n_side_power.getMin()), n_side_power.getMax());
+
+	// Angular size of a Healpix facet is sqrt(4 pi / (12 n_side^2)).
+	mLODError = radius * sqrt(PI / 3) / pow(2, power) / mImageScale;
+
+	if(power != n_side_power.getValue())
+	{
+		n_side_power.setValue(power);
+		cout << mName << ": Auto LOD selected n_side_power = " << power
+			 << " (facet size ~" << mLODError << " pixels)" << endl;
+	}
+}
+
+/// Uploads the analytic spots gathered by `ApplyFeatures` to the shader.
+///
+/// The shader compares the direction of each fragment with the spot centers
+/// (the radii are from `FeatureAngularRadius`) and rescales the flux by the ratio of Planck functions
+/// at the spotted and unspotted temperatures (the latter is stored in the
+/// green channel of the flux texture). The program must be active.
+void CHealpixSpheroid::UploadAnalyticSpots(GLuint shader_program)
+{
+	// c2 = h*c / k_b, see TemperatureToFlux
+	const GLfloat c2_lambda = 0.0143877696 / mWavelength;
+	const GLint n_spots = mSpotCenters.size();
 
-			// set the surface normals, remember to normalize!
-			vbo_data.push_back( glm::normalize( vec3(g_x[i], g_y[i], g_z[i]) ) );
+	GLint uniCount = glGetUniformLocation(shader_program, "spot_count");
+	glUniform1i(uniCount, n_spots);
 
-			// set the texture coordinates
-			vbo_data.push_back(vec3(i % (12 * n_side), i / (12 * n_side), 0));
+	if(n_spots > 0)
+	{
+		GLint uniCenter = glGetUniformLocation(shader_program, "spot_center");
+		glUniform3fv(uniCenter, n_spots, glm::value_ptr(mSpotCenters[0]));
+
+		GLint uniCosRadius = glGetUniformLocation(shader_program, "spot_cos_radius");
+		glUniform1fv(uniCosRadius, n_spots, &mSpotCosRadii[0]);
+
+		GLint uniDeltaT = glGetUniformLocation(shader_program, "spot_delta_T");
+		glUniform1fv(uniDeltaT, n_spots, &mSpotDeltaT[0]);
+
+		GLint uniC2Lambda = glGetUniformLocation(shader_program, "spot_c2_lambda");
+		glUniform1f(uniC2Lambda, c2_lambda);
+	}
+
+	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to upload analytic spots");
+}
+
+/// Uploads the flux texture to the currently bound texture.
+///
+/// Facets are laid out in rows of 12 * n_sides texels, matching the texture
+/// coordinates from GenerateVBO. With an adaptive tesselation the last row
+/// may only be partially filled.
+void CHealpixSpheroid::UploadFluxTexture(unsigned int n_sides)
+{
+	const unsigned int width = 12 * n_sides;
+	const unsigned int full_rows = n_pixels / width;
+	const unsigned int remainder = n_pixels % width;
+
+	if(remainder == 0)
+	{
+		glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, width, full_rows, 0, GL_RGBA,
+				GL_FLOAT, &mFluxTexture[0]);
+		return;
+	}
+
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, width, full_rows + 1, 0, GL_RGBA,
+			GL_FLOAT, NULL);
+	if(full_rows > 0)
+		glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, 0, width, full_rows, GL_RGBA,
+				GL_FLOAT, &mFluxTexture[0]);
+	glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, full_rows, remainder, 1, GL_RGBA,
+			GL_FLOAT, &mFluxTexture[full_rows * width]);
+}
+
+/// Updates the tesselation prior to rendering. The surface is built on first
+/// use and changes to the base or the refinement settings rebuild it from
+/// scratch, whereas motion of the limb or of a feature edge only re-tesselates
+/// the affected facets (see Retessellate).
+///
+/// Only the CPU-side surface is updated, the OpenGL buffers follow in
+/// UploadBuffers.
+void CHealpixSpheroid::UpdateTessellation()
+{
+	if(!mSurfaceReady || mParams["n_side_power"].isDirty() || mParams["refine_levels"].isDirty()
+			|| mParams["refine_limb_mu"].isDirty())
+	{
+		InitSurface();
+		return;
+	}
+
+	if(RefinementChanged())
+		Retessellate();
+}
+
+/// Rebuilds the adaptive tesselation for the current line of sight and
+/// feature edges while keeping the base mesh and the solved surface.
+///
+/// Both the old and new facet lists are sorted on mCellStart, so one merge
+/// pass finds the facets common to both. Their geometry, radii, gravity and
+/// base temperatures are copied, only the facets which appeared near the
+/// limb or a feature edge are passed to ComputeFacets. The VAO, VBO and
+/// texture are reused; only the element buffer is rewritten (see UploadEBO).
+void CHealpixSpheroid::Retessellate()
+{
+	// Keep the solved surface for the current facets.
+	const vector<unsigned int> old_order = mCellOrder;
+	const vector<unsigned long long> old_start = mCellStart;
+	const vector<double> old_pixel_theta = pixel_theta;
+	const vector<double> old_pixel_phi = pixel_phi;
+	const vector<double> old_pixel_radii = pixel_radii;
+	const vector<vec3> old_pixel_xyz = pixel_xyz;
+	const vector<double> old_corner_theta = corner_theta;
+	const vector<double> old_corner_phi = corner_phi;
+	const vector<double> old_corner_radii = corner_radii;
+	const vector<vec3> old_corner_xyz = corner_xyz;
+	const vector<double> old_gravity = gravity;
+	const vector<double> old_g_x = g_x;
+	const vector<double> old_g_y = g_y;
+	const vector<double> old_g_z = g_z;
+	const vector<double> old_base_temperatures = mBaseTemperatures;
+
+	GenerateCells();
+
+	mFluxTexture.resize(n_pixels);
+	pixel_xyz.resize(n_pixels);
+	pixel_phi.resize(n_pixels);
+	pixel_theta.resize(n_pixels);
+	pixel_radii.resize(n_pixels);
+	corner_xyz.resize(4 * n_pixels);
+	corner_phi.resize(4 * n_pixels);
+	corner_theta.resize(4 * n_pixels);
+	corner_radii.resize(4 * n_pixels);
+	gravity.resize(n_pixels);
+	g_x.resize(n_pixels);
+	g_y.resize(n_pixels);
+	g_z.resize(n_pixels);
+	mPixelTemperatures.resize(n_pixels);
+	mBaseTemperatures.resize(n_pixels);
+
+	vector<unsigned int> new_facets;
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < n_pixels; i++)
+	{
+		while(j < old_start.size() && old_start[j] < mCellStart[i])
+			j++;
+
+		if(j == old_start.size() || old_start[j] != mCellStart[i] || old_order[j] != mCellOrder[i])
+		{
+			GenerateFacet(i);
+			new_facets.push_back(i);
+			continue;
+		}
+
+		pixel_theta[i] = old_pixel_theta[j];
+		pixel_phi[i] = old_pixel_phi[j];
+		pixel_radii[i] = old_pixel_radii[j];
+		pixel_xyz[i] = old_pixel_xyz[j];
+		for(unsigned int k = 0; k < 4; k++)
+		{
+			corner_theta[4*i + k] = old_corner_theta[4*j + k];
+			corner_phi[4*i + k] = old_corner_phi[4*j + k];
+			corner_radii[4*i + k] = old_corner_radii[4*j + k];
+			corner_xyz[4*i + k] = old_corner_xyz[4*j + k];
 		}
+		gravity[i] = old_gravity[j];
+		g_x[i] = old_g_x[j];
+		g_y[i] = old_g_y[j];
+		g_z[i] = old_g_z[j];
+		mBaseTemperatures[i] = old_base_temperatures[j];
 	}
+
+	if(new_facets.size() > 0)
+		ComputeFacets(new_facets);
+
+	FindHangingVertices();
+
+	// Force the features to be re-applied across the new tesselation
+	mFeatureRanges.clear();
+
+	// The vertices are uploaded on every render, only the elements need to
+	// be replaced.
+	GenerateHealpixVBOIndicies(n_pixels, mElements);
+	mElementsDirty = true;
 }
 
+/// Uploads the element buffer after the surface was re-tesselated.
+void CHealpixSpheroid::UploadEBO()
+{
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+			mElements.size() * sizeof(unsigned int), &mElements[0],
+			GL_DYNAMIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to update the element buffer");
 
-void CHealpixSpheroid::Init()
+	mElementsDirty = false;
+}
+
+/// Brings the OpenGL buffers up to date with the surface computed by
+/// UpdateSurface, creating them if necessary.
+void CHealpixSpheroid::UploadBuffers()
 {
-	// See if buffers are allocated, if so free them before re-initing them
-	if(mEBO) glDeleteBuffers(1, &mEBO);
-	if(mVBO) glDeleteBuffers(1, &mVBO);
-	if(mVAO) glDeleteVertexArrays(1, &mVAO);
+	if(!mModelReady || mBuffersDirty)
+		Init();
+	else if(mElementsDirty)
+		UploadEBO();
+}
 
-	const unsigned int n_sides = pow(2, mParams["n_side_power"].getValue());
+/// Updates the surface for the current parameters and uploads it for
+/// rendering. The surface itself is computed by UpdateSurface, which makes
+/// no OpenGL calls.
+void CHealpixSpheroid::preRender(double & max_flux)
+{
+	UpdateSurface(max_flux);
+	UploadBuffers();
+}
 
-	n_pixels = nside2npix(n_sides);
+/// Builds the (possibly adaptive) list of facets and solves the surface from
+/// scratch. The OpenGL buffers are re-created by the next UploadBuffers.
+void CHealpixSpheroid::InitSurface()
+{
+	// Build the (possibly adaptive) list of facets. This sets n_pixels.
+	GenerateCells();
 
 	gravity.resize(n_pixels);
 	g_x.resize(n_pixels);
 	g_y.resize(n_pixels);
 	g_z.resize(n_pixels);
 	mPixelTemperatures.resize(n_pixels);
+	mBaseTemperatures.resize(n_pixels);
+	// Force the features to be re-applied across the new tesselation
+	mFeatureRanges.clear();
 
 	// Generate the verticies and elements
 	GenerateModel(mVBOData, mElements);
+
+	mSurfaceReady = true;
+	mBuffersDirty = true;
+}
+
+void CHealpixSpheroid::Init()
+{
+	// See if buffers are allocated, if so free them before re-initing them
+	if(mEBO) glDeleteBuffers(1, &mEBO);
+	if(mVBO) glDeleteBuffers(1, &mVBO);
+	if(mVAO) glDeleteVertexArrays(1, &mVAO);
+
+	const unsigned int n_sides = pow(2, mParams["n_side_power"].getValue());
+
+	if(!mSurfaceReady)
+		InitSurface();
+
 	// Create a new Vertex Array Object, Vertex Buffer Object, and Element Buffer
 	// object to store the model's information.
 	//
@@ -233,12 +1232,13 @@ void CHealpixSpheroid::Init()
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	glActiveTexture(GL_TEXTURE0);
-	// Load image as a texture
+	// Load image as a texture. The adaptive tesselation re-initializes the
+	// model often, so release the previous texture.
+	if(mFluxTextureID) glDeleteTextures(1, &mFluxTextureID);
 	glGenTextures(1, &mFluxTextureID);
 	glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
 
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, 12 * n_sides, n_sides, 0, GL_RGBA,
-			GL_FLOAT, &mFluxTexture[0]);
+	UploadFluxTexture(n_sides);
 
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -257,5 +1257,7 @@ void CHealpixSpheroid::Init()
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed bind back to default buffer.");
 
 	// Indicate the model is ready to use.
+	mBuffersDirty = false;
+	mElementsDirty = false;
 	mModelReady = true;
 }
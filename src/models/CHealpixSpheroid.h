@@ -23,6 +23,8 @@
 #include "chealpix.h"
 #include "CModel.h"
 
+struct CFeatureDescriptor;
+
 class CHealpixSpheroid : public CModel
 {
 protected:
@@ -40,6 +42,12 @@ protected:
 	vector<vec3>   pixel_xyz;
 	unsigned int n_pixels;
 
+	// The CPU-side surface exists (see InitSurface). The OpenGL buffers are
+	// out of date with it (mBuffersDirty) or only the elements changed.
+	bool mSurfaceReady;
+	bool mBuffersDirty;
+	bool mElementsDirty;
+
 	vector<double> corner_theta;
 	vector<double> corner_phi;
 	vector<double> corner_radii;
@@ -50,24 +58,107 @@ protected:
 	vector<double> g_y;
 	vector<double> g_z;
 
+	// Temperatures prior to the application of features
+	vector<double> mBaseTemperatures;
+
+	// Flat (structure of arrays) feature descriptors used by ApplyFeatures.
+	// (x,y,z) is the feature center on the surface, r2 the squared radius.
+	vector<double> mFeatureX;
+	vector<double> mFeatureY;
+	vector<double> mFeatureZ;
+	vector<double> mFeatureR2;
+	vector<double> mFeatureDeltaT;
+	// Pixel range [first, last) covered by each feature during the last update
+	vector< pair<unsigned int, unsigned int> > mFeatureRanges;
+
+	// Analytic spots which are evaluated in the fragment shader.
+	// The centers are unit vectors, the radii are stored as cos(radius).
+	static const unsigned int MAX_ANALYTIC_SPOTS = 16;
+	vector<vec3> mSpotCenters;
+	vector<float> mSpotCosRadii;
+	vector<float> mSpotDeltaT;
+
+	// Estimated size of a Healpix facet in image pixels (see UpdateLOD)
+	double mLODError;
+
+	// Adaptive tesselation (see GenerateCells). Each facet is a NESTED Healpix
+	// cell with its own order (n_side = 2^order). mCellStart is the index of
+	// the cell's first descendant at the finest order, thus it is sorted and
+	// can be used to locate the facet containing a given (theta, phi).
+	vector<unsigned int> mCellOrder;
+	vector<long> mCellIndex;
+	vector<unsigned long long> mCellStart;
+	unsigned int mFinestOrder;
+	// Line of sight (in model coordinates) and feature edges (unit center,
+	// angular radius) used for the current tesselation
+	vec3 mRefinementLOS;
+	vector<vec3> mEdgeCenters;
+	vector<double> mEdgeRadii;
+	// Neighbouring facets differ by at most one order (see BalanceCells). For
+	// edge j of facet i, mEdgeVertex[4*i + j] is the index of the corner of a
+	// finer neighbour which lies on that edge, or -1 (see FindHangingVertices).
+	vector<int> mEdgeVertex;
+
 public:
 	CHealpixSpheroid();
 	virtual ~CHealpixSpheroid();
 
+	void ApplyFeatures(bool base_dirty);
+protected:
+	void ComposeFeatures(unsigned int start, unsigned int end, bool record_ranges);
+	pair<unsigned int, unsigned int> FindFeatureRange(unsigned int feature_index);
+public:
+
 	void FindPixels(double s0, double s1, double s2,
 			double ds0, double ds1, double ds2,
 			vector<unsigned int> &pixels_ids);
 
+	long FindPixel(double theta, double phi);
+
+	double GetAnalyticFlux();
+	bool HasAnalyticFlux();
+protected:
+	double IntegrateFlux(const mat4 & rotation, unsigned int start, unsigned int end);
+public:
+
+	void GenerateCells();
+protected:
+	void BalanceCells();
+	void CellEdges(unsigned int order, long index, vec3 & center, vec3 corners[4], vec3 midpoints[4]);
+	long EdgeNeighbour(const vec3 & center, const vec3 & edge_point);
+	double FeatureAngularRadius(const CFeatureDescriptor & descriptor, double surface_radius);
+	void FindFeatureEdges(vector<vec3> & centers, vector<double> & radii);
+	void FindHangingVertices();
+	unsigned int HangingVertexCount(unsigned int i);
+	vec3 LineOfSight();
+	bool RefinementChanged();
+	void RefineCell(unsigned int order, long index);
+	void Retessellate();
+	void UpdateTessellation();
+
+	void GenerateFacet(unsigned int i);
+	/// Computes the radii, gravity and base temperatures of the listed facets
+	/// from the current parameters.
+	virtual void ComputeFacets(const vector<unsigned int> & facets) = 0;
+public:
 	void GenerateHealpixSphere(unsigned int n_pixels, unsigned int n_sides);
 	void GenerateVBO(unsigned int n_pixels, unsigned int n_side, vector<vec3> & vbo_data);
 	void GenerateHealpixVBOIndicies(unsigned int n_pixels, vector<unsigned int> & elements);
 
 	virtual void GenerateModel(vector<vec3> & vbo_data, vector<unsigned int> & elements) = 0;
 
-	void preRender(double & max_flux) = 0;
+	void preRender(double & max_flux);
 	void Render(const glm::mat4 & view, const GLfloat & max_flux) = 0;
 	virtual void Init();
+	void InitSurface();
+	void UpdateLOD();
+	/// Solves the surface, temperatures, flux texture and vertices for the
+	/// current parameters. Makes no OpenGL calls.
+	virtual void UpdateSurface(double & max_flux) = 0;
+	void UploadBuffers();
 
+	void UploadAnalyticSpots(GLuint shader_program);
+	void UploadFluxTexture(unsigned int n_sides);
 	void UploadVBO();
 	void UploadEBO();
 };
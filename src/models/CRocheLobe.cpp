@@ -17,6 +17,8 @@
  *  Copyright (c) 2014 Fabien Baron
  */
 
+#include <algorithm>
+
 #include "CShaderFactory.h"
 #include "CFeature.h"
 #include "CRocheLobe.h"
@@ -69,7 +71,7 @@ void CRocheLobe::ComputeGravity(const double r_pole, const double separation, co
 void CRocheLobe::VonZeipelTemperatures(double T_eff_pole, double g_pole, double beta)
 {
     for(unsigned int i = 0; i < mPixelTemperatures.size(); i++)
-        mPixelTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, beta);
+        mBaseTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, beta);
 }
 
 /// Computes the tangential components and magnitude of gravity at the
@@ -146,17 +148,32 @@ double CRocheLobe::ComputeRadius(const double r_pole, const double separation, c
 }
 
 
-void CRocheLobe::preRender(double & max_flux)
+/// Returns the largest radius of the surface. Tides and rotation stretch the
+/// equipotential along the equatorial axes, so the maximum is taken over those
+/// directions and the pole.
+double CRocheLobe::GetBoundingRadius()
 {
-    if (!mModelReady)
-        Init();
+    const double r_pole = mParams["r_pole"].getValue();
+    const double separation = mParams["separation"].getValue();
+    const double q = mParams["q"].getValue();
+    const double P = mParams["P"].getValue();
 
-    // See if the user change the tesselation
+    double radius = r_pole;
+    for(unsigned int i = 0; i < 4; i++)
+        radius = max(radius, ComputeRadius(r_pole, separation, q, P, PI/2, i * PI/2));
+
+    return radius;
+}
+
+/// Updates the surface for the current parameters, see CHealpixSpheroid::UpdateSurface.
+void CRocheLobe::UpdateSurface(double & max_flux)
+{
+    // Choose the tesselation automatically, if requested.
+    UpdateLOD();
+
+    // See if the user (or the adaptive refinement) changed the tesselation
     const unsigned int n_sides = pow(2, mParams["n_side_power"].getValue());
-    if(mParams["n_side_power"].isDirty())
-    {
-        Init();
-    }
+    UpdateTessellation();
 
     const double r_pole = mParams["r_pole"].getValue();
     const double T_eff_pole = mParams["T_eff_pole"].getValue();
@@ -165,22 +182,25 @@ void CRocheLobe::preRender(double & max_flux)
     const double q = mParams["q"].getValue();
     const double P = mParams["P"].getValue();
 
-    //    if(mParams["r_pole"].isDirty() || mParams["omega_rot"].isDirty())
-    ComputeRadii(r_pole, separation, q, P);
+    // Only recompute the surface when the geometry has changed.
+    const bool geometry_dirty = mParams["r_pole"].isDirty() || mParams["separation"].isDirty()
+            || mParams["q"].isDirty() || mParams["P"].isDirty();
+
+    if(geometry_dirty)
+        ComputeRadii(r_pole, separation, q, P);
 
     double g_pole, tempx, tempy, tempz;
     ComputeGravity(separation, q, P, r_pole, 0.0, 0.0, tempx, tempy, tempz, g_pole);
-    ComputeGravity(r_pole, separation, q, P);
-
-    bool feature_dirty = false;
-    for(auto feature: mFeatures)
-        feature_dirty |= feature->isDirty();
+    if(geometry_dirty)
+        ComputeGravity(r_pole, separation, q, P);
 
-    if(feature_dirty || mParams["T_eff_pole"].isDirty() || mParams["von_zeipel_beta"].isDirty())
+    const bool base_dirty = geometry_dirty || mParams["T_eff_pole"].isDirty()
+            || mParams["von_zeipel_beta"].isDirty();
+    if(base_dirty)
         VonZeipelTemperatures(T_eff_pole, g_pole, von_zeipel_beta);
 
-    for(auto feature: mFeatures)
-        feature->apply(this);
+    // Apply all features in one pass, only touching dirty features if possible.
+    ApplyFeatures(base_dirty);
 
 
     TemperatureToFlux(mPixelTemperatures, mFluxTexture, mWavelength, max_flux);
@@ -218,10 +238,11 @@ void CRocheLobe::Render(const glm::mat4 & view, const GLfloat & max_flux)
     GLint uniScale = glGetUniformLocation(shader_program, "scale");
     glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
 
+    UploadAnalyticSpots(shader_program);
+
     // Bind to the texture, upload it.
     glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
-    glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, 12 * n_sides, n_sides, 0, GL_RGBA,
-            GL_FLOAT, &mFluxTexture[0]);
+    UploadFluxTexture(n_sides);
 
     // Upload the VBO data:
     glBindBuffer(GL_ARRAY_BUFFER, mVBO);
@@ -239,6 +260,29 @@ void CRocheLobe::Render(const glm::mat4 & view, const GLfloat & max_flux)
     CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed");
 }
 
+void CRocheLobe::ComputeFacets(const vector<unsigned int> & facets)
+{
+    const double r_pole = mParams["r_pole"].getValue();
+    const double T_eff_pole = mParams["T_eff_pole"].getValue();
+    const double von_zeipel_beta = mParams["von_zeipel_beta"].getValue();
+    const double separation = mParams["separation"].getValue();
+    const double q = mParams["q"].getValue();
+    const double P = mParams["P"].getValue();
+
+    double g_pole, tempx, tempy, tempz;
+    ComputeGravity(separation, q, P, r_pole, 0.0, 0.0, tempx, tempy, tempz, g_pole);
+
+    for(auto i: facets)
+    {
+        pixel_radii[i] = ComputeRadius(r_pole, separation, q, P, pixel_theta[i], pixel_phi[i]);
+        for(unsigned int k = 4 * i; k < 4 * i + 4; k++)
+            corner_radii[k] = ComputeRadius(r_pole, separation, q, P, corner_theta[k], corner_phi[k]);
+
+        ComputeGravity(separation, q, P, pixel_radii[i], pixel_theta[i], pixel_phi[i], g_x[i], g_y[i], g_z[i], gravity[i]);
+        mBaseTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, von_zeipel_beta);
+    }
+}
+
 /// Computes the geometry of the spherical Healpix surface
 void CRocheLobe::GenerateModel(vector<vec3> & vbo_data,
         vector<unsigned int> & elements)
@@ -261,9 +305,7 @@ void CRocheLobe::GenerateModel(vector<vec3> & vbo_data,
     ComputeGravity(separation, q, P, r_pole, 0.0, 0.0, tempx, tempy, tempz, g_pole);
     ComputeGravity(r_pole, separation, q, P);
     VonZeipelTemperatures(T_eff_pole, g_pole, von_zeipel_beta);
-
-    for(auto feature: mFeatures)
-        feature->apply(this);
+    ApplyFeatures(true);
 
     // Find the maximum temperature
     double max_temperature = 0;
@@ -23,6 +23,8 @@
  *  Note:   most of the code is not optimized at the moment...
  */
 
+#include <algorithm>
+
 #include "CShaderFactory.h"
 #include "CFeature.h"
 #include "CRocheLobe_FF.h"
@@ -73,7 +75,7 @@ void CRocheLobe_FF::ComputeGravity(const double separation, const double q, cons
 void CRocheLobe_FF::VonZeipelTemperatures(double T_eff_pole, double g_pole, double beta)
 {
     for(unsigned int i = 0; i < mPixelTemperatures.size(); i++)
-        mPixelTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, beta);
+        mBaseTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, beta);
 }
 
 /// Computes the tangential components and magnitude of gravity at the
@@ -148,17 +150,44 @@ double CRocheLobe_FF::ComputeRadius(const double pot_surface, const double separ
 }
 
 
-void CRocheLobe_FF::preRender(double & max_flux)
+/// Returns the largest radius of the surface, taken over the equatorial axes
+/// and the pole. The fill factor never exceeds one, so the surface lies within
+/// the Roche lobe whose farthest point is L1. The L1 distance also caps the
+/// radius towards the companion, where the Newton iteration in
+/// ComputeRadius converges poorly for a (nearly) filled lobe.
+double CRocheLobe_FF::GetBoundingRadius()
 {
-    if (!mModelReady)
-        Init();
+    const double separation = mParams["separation"].getValue();
+    const double q = mParams["q"].getValue();
+    const double P = mParams["P"].getValue();
+    const double F = mParams["F"].getValue();
 
-    // See if the user change the tesselation
+    // Potential of the surface, see UpdateSurface
+    double r_L1 = separation * ComputeRL1(q, P);
+    double pot_L1, dpot_L1;
+    ComputePotential(pot_L1, dpot_L1, r_L1, PI/2., 0.0, separation, q, P);
+    double pot_surface = (pot_L1 + 0.5*q*q/(1.+q))/F - 0.5*q*q/(1.+q);
+
+    double radius = ComputeRadius(pot_surface, separation, q, P, 0.0, 0.0);
+    for(unsigned int i = 0; i < 4; i++)
+        radius = max(radius, ComputeRadius(pot_surface, separation, q, P, PI/2, i * PI/2));
+
+    // A non-finite radius means the iteration diverged, fall back to the lobe.
+    if(!(radius <= r_L1))
+        radius = r_L1;
+
+    return radius;
+}
+
+/// Updates the surface for the current parameters, see CHealpixSpheroid::UpdateSurface.
+void CRocheLobe_FF::UpdateSurface(double & max_flux)
+{
+    // Choose the tesselation automatically, if requested.
+    UpdateLOD();
+
+    // See if the user (or the adaptive refinement) changed the tesselation
     const unsigned int n_sides = pow(2, mParams["n_side_power"].getValue());
-    if(mParams["n_side_power"].isDirty())
-    {
-        Init();
-    }
+    UpdateTessellation();
 
     const double T_eff_pole = mParams["T_eff_pole"].getValue();
     const double von_zeipel_beta = mParams["von_zeipel_beta"].getValue();
@@ -183,20 +212,25 @@ void CRocheLobe_FF::preRender(double & max_flux)
     double g_pole, tempx, tempy, tempz;
     ComputeGravity(separation, q, P, r_pole, 0.0, 0.0, tempx, tempy, tempz, g_pole);
 
-    // Compute Radii for all Healpix pixels
-    ComputeRadii(pot_surface, separation, q, P);
-    // Compute Gravity for all Healpix pixels
-    ComputeGravity(separation, q, P);
+    // Only recompute the surface when the geometry has changed.
+    const bool geometry_dirty = mParams["separation"].isDirty() || mParams["q"].isDirty()
+            || mParams["P"].isDirty() || mParams["F"].isDirty();
 
-    bool feature_dirty = false;
-    for(auto feature: mFeatures)
-        feature_dirty |= feature->isDirty();
+    if(geometry_dirty)
+    {
+        // Compute Radii for all Healpix pixels
+        ComputeRadii(pot_surface, separation, q, P);
+        // Compute Gravity for all Healpix pixels
+        ComputeGravity(separation, q, P);
+    }
 
-    if(feature_dirty || mParams["T_eff_pole"].isDirty() || mParams["von_zeipel_beta"].isDirty())
+    const bool base_dirty = geometry_dirty || mParams["T_eff_pole"].isDirty()
+            || mParams["von_zeipel_beta"].isDirty() || mParams["r_pole"].isDirty();
+    if(base_dirty)
         VonZeipelTemperatures(T_eff_pole, g_pole, von_zeipel_beta);
 
-    for(auto feature: mFeatures)
-        feature->apply(this);
+    // Apply all features in one pass, only touching dirty features if possible.
+    ApplyFeatures(base_dirty);
 
 
     TemperatureToFlux(mPixelTemperatures, mFluxTexture, mWavelength, max_flux);
@@ -234,10 +268,11 @@ void CRocheLobe_FF::Render(const glm::mat4 & view, const GLfloat & max_flux)
     GLint uniScale = glGetUniformLocation(shader_program, "scale");
     glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
 
+    UploadAnalyticSpots(shader_program);
+
     // Bind to the texture, upload it.
     glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
-    glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, 12 * n_sides, n_sides, 0, GL_RGBA,
-            GL_FLOAT, &mFluxTexture[0]);
+    UploadFluxTexture(n_sides);
 
     // Upload the VBO data:
     glBindBuffer(GL_ARRAY_BUFFER, mVBO);
@@ -255,6 +290,35 @@ void CRocheLobe_FF::Render(const glm::mat4 & view, const GLfloat & max_flux)
     CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed");
 }
 
+void CRocheLobe_FF::ComputeFacets(const vector<unsigned int> & facets)
+{
+    const double T_eff_pole = mParams["T_eff_pole"].getValue();
+    const double von_zeipel_beta = mParams["von_zeipel_beta"].getValue();
+    const double separation = mParams["separation"].getValue();
+    const double q = mParams["q"].getValue();
+    const double P = mParams["P"].getValue();
+    const double F = mParams["F"].getValue();
+
+    // Potential at the surface, polar radius and gravity, as in UpdateSurface
+    double r_L1 = separation * ComputeRL1(q, P);
+    double pot_L1, dpot_L1;
+    ComputePotential(pot_L1, dpot_L1, r_L1, PI/2., 0.0, separation, q, P);
+    double pot_surface = (pot_L1 + 0.5*q*q/(1.+q))/F - 0.5*q*q/(1.+q);
+    double r_pole = ComputeRadius(pot_surface, separation, q, P, 0.0, 0.0);
+    double g_pole, tempx, tempy, tempz;
+    ComputeGravity(separation, q, P, r_pole, 0.0, 0.0, tempx, tempy, tempz, g_pole);
+
+    for(auto i: facets)
+    {
+        pixel_radii[i] = ComputeRadius(pot_surface, separation, q, P, pixel_theta[i], pixel_phi[i]);
+        for(unsigned int k = 4 * i; k < 4 * i + 4; k++)
+            corner_radii[k] = ComputeRadius(pot_surface, separation, q, P, corner_theta[k], corner_phi[k]);
+
+        ComputeGravity(separation, q, P, pixel_radii[i], pixel_theta[i], pixel_phi[i], g_x[i], g_y[i], g_z[i], gravity[i]);
+        mBaseTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, von_zeipel_beta);
+    }
+}
+
 /// Computes the geometry of the spherical Healpix surface
 void CRocheLobe_FF::GenerateModel(vector<vec3> & vbo_data,
         vector<unsigned int> & elements)
@@ -288,9 +352,7 @@ void CRocheLobe_FF::GenerateModel(vector<vec3> & vbo_data,
     ComputeGravity(separation, q, P);
     // Compute Temperatures for all Healpix pixels
     VonZeipelTemperatures(T_eff_pole, g_pole, von_zeipel_beta);
-
-    for(auto feature: mFeatures)
-        feature->apply(this);
+    ApplyFeatures(true);
 
     // Find the maximum temperature
     double max_temperature = 0;
@@ -37,7 +37,9 @@ class CRocheLobe_FF: public CHealpixSpheroid
 
     public:
 
-        void preRender(double & max_flux);
+        double GetBoundingRadius();
+
+        void UpdateSurface(double & max_flux);
         void Render(const glm::mat4 & view, const GLfloat & max_flux);
 
         static shared_ptr<CModel> Create();
@@ -47,6 +49,7 @@ class CRocheLobe_FF: public CHealpixSpheroid
             return "roche_lobe_FF";
         };
         void GenerateModel(vector<vec3> & vbo_data, vector<unsigned int> & elements);
+        void ComputeFacets(const vector<unsigned int> & facets);
 
         void ComputeModel(double g_pole, double r_pole, double omega_rot);
 
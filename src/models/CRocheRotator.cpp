@@ -131,6 +131,27 @@ void CRocheRotator::ComputeGravity(double g_pole, double r_pole, double omega_ro
 	}
 }
 
+void CRocheRotator::ComputeFacets(const vector<unsigned int> & facets)
+{
+	const double g_pole = mParams["g_pole"].getValue();
+	const double r_pole = mParams["r_pole"].getValue();
+	const double omega_rot = mParams["omega_rot"].getValue();
+	const double T_eff_pole = mParams["T_eff_pole"].getValue();
+	const double von_zeipel_beta = mParams["von_zeipel_beta"].getValue();
+
+	for(auto i: facets)
+	{
+		pixel_radii[i] = ComputeRadius(r_pole, omega_rot, pixel_theta[i]);
+		for(unsigned int k = 4 * i; k < 4 * i + 4; k++)
+			corner_radii[k] = ComputeRadius(r_pole, omega_rot, corner_theta[k]);
+
+		ComputeGravity(g_pole, r_pole, omega_rot,
+				pixel_radii[i], pixel_theta[i], pixel_phi[i],
+				g_x[i], g_y[i], g_z[i], gravity[i]);
+		mBaseTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, von_zeipel_beta);
+	}
+}
+
 void CRocheRotator::GenerateModel(vector<vec3> & vbo_data, vector<unsigned int> & elements)
 {
 	const double g_pole = mParams["g_pole"].getValue();
@@ -148,9 +169,7 @@ void CRocheRotator::GenerateModel(vector<vec3> & vbo_data, vector<unsigned int>
 	ComputeRadii(r_pole, omega_rot);
 	ComputeGravity(g_pole, r_pole, omega_rot);
 	VonZeipelTemperatures(T_eff_pole, g_pole, von_zeipel_beta);
-
-	for(auto feature: mFeatures)
-		feature->apply(this);
+	ApplyFeatures(true);
 
 	// Find the maximum temperature
 	double max_temperature = 0;
@@ -168,17 +187,21 @@ void CRocheRotator::GenerateModel(vector<vec3> & vbo_data, vector<unsigned int>
 	GenerateHealpixVBOIndicies(n_pixels, elements);
 }
 
-void CRocheRotator::preRender(double & max_flux)
+/// The equatorial radius of a Roche rotator never exceeds 1.5 r_pole.
+double CRocheRotator::GetBoundingRadius()
 {
-	if (!mModelReady)
-		Init();
+	return 1.5 * mParams["r_pole"].getValue();
+}
 
-	// See if the user change the tesselation
+/// Updates the surface for the current parameters, see CHealpixSpheroid::UpdateSurface.
+void CRocheRotator::UpdateSurface(double & max_flux)
+{
+	// Choose the tesselation automatically, if requested.
+	UpdateLOD();
+
+	// See if the user (or the adaptive refinement) changed the tesselation
 	const unsigned int n_sides = pow(2, mParams["n_side_power"].getValue());
-	if(mParams["n_side_power"].isDirty())
-	{
-		Init();
-	}
+	UpdateTessellation();
 
 	const double g_pole = mParams["g_pole"].getValue();
 	const double r_pole = mParams["r_pole"].getValue();
@@ -192,15 +215,14 @@ void CRocheRotator::preRender(double & max_flux)
 	if(mParams["g_pole"].isDirty() || mParams["r_pole"].isDirty() || mParams["omega_rot"].isDirty())
 		ComputeGravity(g_pole, r_pole, omega_rot);
 
-	bool feature_dirty = false;
-	for(auto feature: mFeatures)
-		feature_dirty |= feature->isDirty();
-
-	if(feature_dirty || mParams["T_eff_pole"].isDirty() || mParams["g_pole"].isDirty() || mParams["von_zeipel_beta"].isDirty())
+	const bool base_dirty = mParams["T_eff_pole"].isDirty() || mParams["g_pole"].isDirty()
+			|| mParams["von_zeipel_beta"].isDirty() || mParams["r_pole"].isDirty()
+			|| mParams["omega_rot"].isDirty();
+	if(base_dirty)
 		VonZeipelTemperatures(T_eff_pole, g_pole, von_zeipel_beta);
 
-	for(auto feature: mFeatures)
-		feature->apply(this);
+	// Apply all features in one pass, only touching dirty features if possible.
+	ApplyFeatures(base_dirty);
 
 	TemperatureToFlux(mPixelTemperatures, mFluxTexture, mWavelength, max_flux);
 
@@ -236,10 +258,11 @@ void CRocheRotator::Render(const glm::mat4 & view, const GLfloat & max_flux)
 	GLint uniScale = glGetUniformLocation(shader_program, "scale");
 	glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
 
+	UploadAnalyticSpots(shader_program);
+
 	// Bind to the texture, upload it.
 	glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, 12 * n_sides, n_sides, 0, GL_RGBA,
-			GL_FLOAT, &mFluxTexture[0]);
+	UploadFluxTexture(n_sides);
 
 	// Upload the VBO data:
 	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
@@ -260,5 +283,5 @@ void CRocheRotator::Render(const glm::mat4 & view, const GLfloat & max_flux)
 void CRocheRotator::VonZeipelTemperatures(double T_eff_pole, double g_pole, double beta)
 {
 	for(unsigned int i = 0; i < mPixelTemperatures.size(); i++)
-		mPixelTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, beta);
+		mBaseTemperatures[i] = T_eff_pole * pow(gravity[i] / g_pole, beta);
 }
@@ -36,9 +36,15 @@ CSphere::CSphere()
 
 	addParameter("T_eff", 5000, 2E3, 1E6, false, 100, "T_eff", "Effective temperature (Kelvin)", 0);
 	addParameter("radius", 0.5, 0, 1, true, 0.05, "Radius", "Radius of the sphere (mas)", 4);
+	addParameter("impostor", 1, 0, 1, false, 1, "Impostor",
+			"Render an exact sphere on a screen-aligned quad (1) or a latitude/longitude mesh (0). Requires a shader which supports impostors.", 0);
 
 	mNumElements = 0;
 
+	mImpostorVAO = 0;
+	mImpostorVBO = 0;
+	mImpostorEBO = 0;
+
 	mFluxTexture.resize(1);	// single element texture.
 	mPixelTemperatures.resize(1);
 
@@ -47,6 +53,10 @@ CSphere::CSphere()
 
 CSphere::~CSphere()
 {
+	if(mImpostorEBO) glDeleteBuffers(1, &mImpostorEBO);
+	if(mImpostorVBO) glDeleteBuffers(1, &mImpostorVBO);
+	if(mImpostorVAO) glDeleteVertexArrays(1, &mImpostorVAO);
+
 	glDeleteBuffers(1, &mEBO);
 	glDeleteBuffers(1, &mVBO);
 	glDeleteVertexArrays(1, &mVAO);
@@ -57,6 +67,26 @@ shared_ptr<CModel> CSphere::Create()
 	return shared_ptr<CModel>(new CSphere());
 }
 
+/// Generates a screen-aligned quad spanning [-1, 1] on which the sphere is
+/// drawn as an impostor (see sphere_impostor_frag.glsl). Render with
+/// GL_TRIANGLES.
+///
+/// The VBO follows the packing used in GenerateSphere_LatLon.
+void CSphere::GenerateImpostorQuad(vector<vec3> & vbo_data, vector<unsigned int> & elements)
+{
+	const vec3 corners[4] = {vec3(-1, -1, 0), vec3(1, -1, 0), vec3(1, 1, 0), vec3(-1, 1, 0)};
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		vbo_data.push_back(corners[i]);
+		vbo_data.push_back(vec3(0, 0, 1));
+		vbo_data.push_back(vec3(1.0, 0, 0));
+	}
+
+	// Three vec3s define a vertex, thus the indices are multiples of three.
+	unsigned int quad[6] = {0, 3, 6, 0, 6, 9};
+	elements.assign(quad, quad + 6);
+}
+
 /// Generates a sphere by dividing it into subdivisions in latitude and longitude.
 /// Render with GL_TRIANGLES.
 ///
@@ -130,6 +160,12 @@ void CSphere::GenerateSphere_LatLon(vector<vec3> & vbo_data, vector<unsigned int
 	}
 }
 
+/// Returns the radius of the sphere.
+double CSphere::GetBoundingRadius()
+{
+	return mParams["radius"].getValue();
+}
+
 void CSphere::Init()
 {
 	// Generate the verticies and elements
@@ -171,6 +207,28 @@ void CSphere::Init()
 
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed bind back the default buffers");
 
+	// Create the impostor quad following the same procedure.
+	vector<vec3> quad_vbo_data;
+	vector<unsigned int> quad_elements;
+	GenerateImpostorQuad(quad_vbo_data, quad_elements);
+
+	glGenVertexArrays(1, &mImpostorVAO);
+	glBindVertexArray(mImpostorVAO);
+	glGenBuffers(1, &mImpostorVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mImpostorVBO);
+	glBufferData(GL_ARRAY_BUFFER, quad_vbo_data.size() * sizeof(vec3), &quad_vbo_data[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &mImpostorEBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mImpostorEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, quad_elements.size() * sizeof(unsigned int), &quad_elements[0], GL_STATIC_DRAW);
+
+	InitShaderVariables(GetImpostorShader());
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to create the impostor buffers");
+
 	// Indicate the model is ready to use.
 	mModelReady = true;
 }
@@ -194,12 +252,18 @@ void CSphere::Render(const glm::mat4 & view, const GLfloat & max_flux)
 
 	NormalizeFlux(max_flux);
 
-	// Activate the shader
-	GLuint shader_program = mShader->GetProgram();
-	mShader->UseShader();
+	// Activate the shader. Impostors use a separate program because writing
+	// gl_FragDepth disables early depth testing.
+	const bool impostor = UseImpostor();
+	CShaderPtr shader = impostor ? GetImpostorShader() : mShader;
+	GLuint shader_program = shader->GetProgram();
+	shader->UseShader();
 
 	// bind back to the VAO
-	glBindVertexArray(mVAO);
+	glBindVertexArray(impostor ? mImpostorVAO : mVAO);
+
+	GLint uniImpostor = glGetUniformLocation(shader_program, "impostor");
+	glUniform1i(uniImpostor, impostor);
 
 	// Define the view:
 	GLint uniView = glGetUniformLocation(shader_program, "view");
@@ -217,11 +281,14 @@ void CSphere::Render(const glm::mat4 & view, const GLfloat & max_flux)
 	// bind to this object's texture
 	glBindTexture(GL_TEXTURE_RECTANGLE, mFluxTextureID);
 	// upload the image
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, mFluxTexture.size(), 1, 0, GL_RGBA,
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, mFluxTexture.size(), 1, 0, GL_RGBA,
 			GL_FLOAT, &mFluxTexture[0]);
 
 	// render
-	glDrawElements(GL_TRIANGLE_STRIP, mNumElements, GL_UNSIGNED_INT, 0);
+	if(impostor)
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	else
+		glDrawElements(GL_TRIANGLE_STRIP, mNumElements, GL_UNSIGNED_INT, 0);
 
 	// Unbind
 	glBindTexture(GL_TEXTURE_RECTANGLE, 0);
@@ -232,3 +299,278 @@ void CSphere::Render(const glm::mat4 & view, const GLfloat & max_flux)
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed");
 }
 
+/// Returns the flux of the (limb-darkened) disk of the sphere, see `CModel::GetAnalyticFlux`.
+double CSphere::GetAnalyticFlux()
+{
+	// c2 = h*c / k_b, see TemperatureToFlux
+	const double c2 = 0.0143877696;
+
+	const double radius = mParams["radius"].getValue();
+	const double T_eff = mParams["T_eff"].getValue();
+
+	UpdateLimbDarkening();
+
+	const double brightness = 1.0 / (exp(c2 / (mWavelength * T_eff)) - 1.0);
+	return brightness * PI * radius * radius * RadialVisibility(0);
+}
+
+/// Returns the visibilities of the (limb-darkened) disk of the sphere.
+///
+/// The sphere is rendered as a disk whose intensity follows the limb
+/// darkening law implemented by its shader. The visibility is the Hankel
+/// transform of this radial profile, see `RadialVisibility`.
+double CSphere::GetAnalyticVisibilities(const vector<pair<double,double> > & uv,
+		vector<complex<double> > & vis)
+{
+	// Conversion from milliarcseconds to radians
+	const double mas_to_rad = PI / (180.0 * 3600.0 * 1000.0);
+	// c2 = h*c / k_b, see TemperatureToFlux
+	const double c2 = 0.0143877696;
+
+	const double radius = mParams["radius"].getValue() * mas_to_rad;
+	const double T_eff = mParams["T_eff"].getValue();
+
+	UpdateLimbDarkening();
+
+	// Planck's law, without the constant c1 (as in TemperatureToFlux)
+	const double brightness = 1.0 / (exp(c2 / (mWavelength * T_eff)) - 1.0);
+	const double area_brightness = brightness * PI * radius * radius;
+
+	for(unsigned int i = 0; i < uv.size(); i++)
+	{
+		const double rho = sqrt(uv[i].first * uv[i].first + uv[i].second * uv[i].second);
+		vis[i] = area_brightness * RadialVisibility(2 * PI * radius * rho);
+	}
+
+	return area_brightness * RadialVisibility(0);
+}
+
+/// Returns the flux of the sphere hidden behind an opaque disk, see
+/// `CModel::GetOccultedFlux`.
+///
+/// For a uniform disk the hidden area is the lens formed by the two disks.
+/// Otherwise the limb-darkened intensity is integrated over radius,
+///		\int I(mu(r)) theta(r) r dr,
+/// where theta(r) is the angle of the circle of radius r behind the occulter.
+double CSphere::GetOccultedFlux(double x, double y, double radius)
+{
+	// c2 = h*c / k_b, see TemperatureToFlux
+	const double c2 = 0.0143877696;
+
+	const double R = mParams["radius"].getValue();
+	const double T_eff = mParams["T_eff"].getValue();
+	const double d = sqrt(x * x + y * y);
+
+	if(d >= R + radius || radius <= 0)
+		return 0;
+
+	UpdateLimbDarkening();
+	const double brightness = 1.0 / (exp(c2 / (mWavelength * T_eff)) - 1.0);
+
+	// Completely hidden
+	if(d + R <= radius)
+		return brightness * PI * R * R * RadialVisibility(0);
+
+	if(mLDLaw == LDL_UNIFORM)
+	{
+		// Area of the intersection of two circles
+		if(d + radius <= R)
+			return brightness * PI * radius * radius;
+
+		const double a = acos(min(max((d * d + R * R - radius * radius) / (2 * d * R), -1.0), 1.0));
+		const double b = acos(min(max((d * d + radius * radius - R * R) / (2 * d * radius), -1.0), 1.0));
+		const double area = R * R * a + radius * radius * b
+				- 0.5 * sqrt(max((-d + R + radius) * (d + R - radius) * (d - R + radius) * (d + R + radius), 0.0));
+		return brightness * area;
+	}
+
+	// Circles with r < radius - d are completely hidden, those with
+	// r < d - radius are completely visible. theta(r) is smooth in between.
+	const double r_full = min(max(radius - d, 0.0), R);
+	const double r_start = max(fabs(d - radius), r_full);
+	const double r_end = min(d + radius, R);
+
+	double sum = OccultedIntensity(0, r_full, d, radius);
+	if(r_end > r_start)
+		sum += OccultedIntensity(r_start, r_end, d, radius);
+
+	return brightness * sum;
+}
+
+/// Integrates I(mu(r)) theta(r) r dr over [r0, r1] for the sphere hidden by
+/// a disk of the given radius at distance d, see `GetOccultedFlux`.
+///
+/// The substitution r = r0 + (r1 - r0) (1 - cos(pi t)) / 2 removes the square
+/// root behaviour of theta(r) and mu(r) at the ends of the interval so that
+/// Gauss-Legendre quadrature converges quickly.
+double CSphere::OccultedIntensity(double r0, double r1, double d, double radius)
+{
+	if(r1 <= r0)
+		return 0;
+
+	const double R = mParams["radius"].getValue();
+	const double half_width = 0.5 * (r1 - r0);
+
+	double sum = 0;
+	for(auto & node: Quadrature())
+	{
+		const double t = PI * node.first;
+		const double r = r0 + half_width * (1 - cos(t));
+		const double dr = half_width * PI * sin(t);
+
+		double theta = 2 * PI;
+		if(r > 0 && d > 0 && r + d > radius)
+			theta = 2 * acos(min(max((r * r + d * d - radius * radius) / (2 * r * d), -1.0), 1.0));
+		else if(r + d > radius)
+			theta = 0;
+
+		const double mu = sqrt(max(1 - (r * r) / (R * R), 0.0));
+		sum += node.second * Intensity(mu) * theta * r * dr;
+	}
+
+	return sum;
+}
+
+/// Spheres have an analytic flux under the same conditions as their visibilities.
+bool CSphere::HasAnalyticFlux()
+{
+	return HasAnalyticVisibility();
+}
+
+/// The silhouette of a sphere is a disk, thus it can occult and be occulted
+/// analytically whenever its flux is analytic.
+bool CSphere::HasAnalyticOccultation()
+{
+	return HasAnalyticFlux();
+}
+
+/// Spheres have analytic visibilities if they use the default (uniform disk)
+/// shader or one of the limb darkening shaders and have no surface features.
+bool CSphere::HasAnalyticVisibility()
+{
+	return mFeatures.size() == 0 && HasAnalyticLimbDarkening();
+}
+
+/// Returns the normalized Hankel transform of the disk's radial profile,
+///		2 \int_0^1 I(mu(r)) J_0(x r) r dr,
+/// where x = 2 pi R rho. For the uniform and quadratic laws this is evaluated
+/// in closed form. Other laws are integrated numerically in mu using
+/// Gauss-Legendre quadrature.
+double CSphere::RadialVisibility(double x)
+{
+	if(mLDLaw == LDL_UNIFORM)
+		return PowerLawVisibility(0, x);
+
+	if(mLDLaw == LDL_QUADRATIC)
+	{
+		// I(mu) = (1 - a1 - a2) + (a1 + 2 a2) mu - a2 mu^2
+		const double a1 = mLDCoefficients[0];
+		const double a2 = mLDCoefficients[1];
+		return (1 - a1 - a2) * PowerLawVisibility(0, x)
+				+ (a1 + 2 * a2) * PowerLawVisibility(1, x)
+				- a2 * PowerLawVisibility(2, x);
+	}
+
+	// With r dr = -mu dmu the integral becomes 2 \int_0^1 I(mu) J_0(x r) mu dmu
+	double sum = 0;
+	for(auto & node: Quadrature())
+	{
+		const double mu = node.first;
+		const double r = sqrt(1 - mu * mu);
+		sum += node.second * Intensity(mu) * j0(x * r) * mu;
+	}
+
+	return 2 * sum;
+}
+
+/// Returns the 64-point Gauss-Legendre (node, weight) pairs on [0, 1],
+/// computed on first use.
+const vector<pair<double, double> > & CSphere::Quadrature()
+{
+	static const unsigned int n_nodes = 64;
+	static vector<pair<double, double> > nodes;
+	if(nodes.size() == 0)
+	{
+		nodes.resize(n_nodes);
+		for(unsigned int i = 0; i < n_nodes; i++)
+		{
+			// Newton iteration on the Legendre polynomial P_n
+			double t = cos(PI * (i + 0.75) / (n_nodes + 0.5));
+			double dp = 0;
+			for(unsigned int iteration = 0; iteration < 100; iteration++)
+			{
+				double p0 = 1, p1 = t;
+				for(unsigned int k = 2; k <= n_nodes; k++)
+				{
+					double p2 = ((2 * k - 1) * t * p1 - (k - 1) * p0) / k;
+					p0 = p1;
+					p1 = p2;
+				}
+				dp = n_nodes * (t * p1 - p0) / (t * t - 1);
+				double dt = p1 / dp;
+				t -= dt;
+				if(fabs(dt) < 1E-15)
+					break;
+			}
+
+			nodes[i].first = 0.5 * (t + 1);
+			nodes[i].second = 1.0 / ((1 - t * t) * dp * dp);
+		}
+	}
+
+	return nodes;
+}
+
+/// Returns the normalized Hankel transform of I(mu) = mu^alpha for
+/// alpha = 0, 1, or 2:
+///		2 \int_0^1 mu^alpha J_0(x r) r dr = 2^(a+1) Gamma(a+1) J_(a+1)(x) / x^(a+1)
+/// with a = alpha / 2.
+double CSphere::PowerLawVisibility(double alpha, double x)
+{
+	// Use the Taylor series near the origin to avoid cancellation,
+	// 1/(a+1) - x^2 / (4 (a+1) (a+2)).
+	if(x < 1E-3)
+	{
+		const double a = alpha / 2;
+		return 1 / (a + 1) - x * x / (4 * (a + 1) * (a + 2));
+	}
+
+	if(alpha == 0)
+		return 2 * j1(x) / x;
+	if(alpha == 1)	// J_(3/2) in terms of elementary functions
+		return 2 * (sin(x) / x - cos(x)) / (x * x);
+
+	return 4 * jn(2, x) / (x * x);
+}
+
+/// Returns a copy of the model's shader which links sphere_impostor_frag.glsl
+/// in place of surface_normal_frag.glsl. The copy is recreated when the
+/// model's shader changes and its parameters are kept in sync with it.
+///
+/// If the shader does not support impostors, the shader itself is returned.
+CShaderPtr CSphere::GetImpostorShader()
+{
+	if(!mShader->HasFragmentLibrary("surface_normal_frag.glsl"))
+		return mShader;
+
+	if(mImpostorSource != mShader)
+	{
+		mImpostorShader = CShaderPtr(new CShader(*mShader));
+		mImpostorShader->ReplaceFragmentLibrary("surface_normal_frag.glsl", "sphere_impostor_frag.glsl");
+		mImpostorSource = mShader;
+	}
+
+	for(auto & it: mShader->getParameterMap())
+		mImpostorShader->getParameter(it.first).setValue(it.second.getValue());
+
+	return mImpostorShader;
+}
+
+/// Returns true if the sphere should be drawn as an impostor. The shader must
+/// link against surface_normal_frag.glsl, which is replaced by the impostor
+/// variant (see GetImpostorShader).
+bool CSphere::UseImpostor()
+{
+	return mParams["impostor"].getValue() > 0.5
+			&& mShader->HasFragmentLibrary("surface_normal_frag.glsl");
+}
@@ -32,6 +32,13 @@ protected:
 	GLuint mVBO;
 	GLuint mEBO;
 
+	// Screen-aligned quad used when rendering the sphere as an impostor
+	GLuint mImpostorVAO;
+	GLuint mImpostorVBO;
+	GLuint mImpostorEBO;
+	// Copy of mImpostorSource linked against sphere_impostor_frag.glsl
+	CShaderPtr mImpostorShader;
+	CShaderPtr mImpostorSource;
 
 public:
 	CSphere();
@@ -40,16 +47,34 @@ public:
 	static shared_ptr<CModel> Create();
 
 	virtual string GetID() { return "sphere"; };
+	double GetBoundingRadius();
 	double GetMaxHeight();
 
+	static void GenerateImpostorQuad(vector<vec3> & vbo_data, vector<unsigned int> & elements);
 	static void GenerateSphere_LatLon(vector<vec3> & vbo_data, vector<unsigned int> & elements,
 			unsigned int latitude_subdivisions, unsigned int longitude_subdivisions);
 
+	double GetAnalyticFlux();
+	double GetAnalyticVisibilities(const vector<pair<double,double> > & uv,
+			vector<complex<double> > & vis);
+	double GetOccultedFlux(double x, double y, double radius);
+	bool HasAnalyticFlux();
+	bool HasAnalyticOccultation();
+	bool HasAnalyticVisibility();
+
 	void Init();
 
 	void preRender(double & max_flux);
 	void Render(const glm::mat4 & view, const GLfloat & max_flux);
 	void postRender();
+
+protected:
+	CShaderPtr GetImpostorShader();
+	bool UseImpostor();
+	double OccultedIntensity(double r0, double r1, double d, double radius);
+	double RadialVisibility(double x);
+	static double PowerLawVisibility(double alpha, double x);
+	static const vector<pair<double, double> > & Quadrature();
 };
 
 #endif /* CSPHERE_H_ */
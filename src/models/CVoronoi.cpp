@@ -21,46 +21,40 @@
 #include "CShaderFactory.h"
 
 #include <sstream>
+#include <stdexcept>
 using namespace std;
 
 CVoronoi::CVoronoi()
 : 	CModel()
 {
 	// give this object a name
-	id = "voronoi_pixels";
-	name = "Voronoi tesselation model";
-	mNRegions = 20;
+	mID = "voronoi";
+	mName = "Voronoi Tesselation";
 
-	stringstream x_id;
-	stringstream y_id;
-	stringstream flux_id;
-
-	for(unsigned int i = 0; i < mNRegions; i++)
-	{
-		// create unique IDs for mapping the pixels
-		x_id << "x_" << i;
-		y_id << "y_" << i;
-		flux_id << "flux_" << i;
+	mNRegions = 0;
+	mNElements = 0;
+	mVAO = 0;
+	mVBO = 0;
+	mEBO = 0;
+	mInstanceVBO = 0;
 
-		// add the parameters
-		addParameter(x_id.str(), 0, -12, 12, true, 1, x_id.str(), "x position");
-		addParameter(y_id.str(), 0, -12, 12, true, 1, y_id.str(), "y position");
-		addParameter(flux_id.str(), 0, -12, 12, true, 1, flux_id.str(), "Pixel flux");
-
-		// clear the stringstreams
-		x_id.str(std::string());
-		y_id.str(std::string());
-		flux_id.str(std::string());
-	}
+	// The number of regions defines the parameter map, so it is a setting of
+	// the model (see Restore) rather than a parameter.
+	SetNRegions(20);
 
-	// We only ever use the default shader in this instance.
+	// We only ever use the Voronoi shader in this instance.
 	auto shaders = CShaderFactory::Instance();
-	mShader = shaders.CreateShader("default");
+	mShader = shaders.CreateShader("voronoi");
+
+	mModelReady = false;
 }
 
 CVoronoi::~CVoronoi()
 {
-
+	if(mInstanceVBO) glDeleteBuffers(1, &mInstanceVBO);
+	if(mEBO) glDeleteBuffers(1, &mEBO);
+	if(mVBO) glDeleteBuffers(1, &mVBO);
+	if(mVAO) glDeleteVertexArrays(1, &mVAO);
 }
 
 shared_ptr<CModel> CVoronoi::Create()
@@ -68,7 +62,9 @@ shared_ptr<CModel> CVoronoi::Create()
 	return shared_ptr<CModel>(new CVoronoi());
 }
 
-/// Draws a unit cylindrical wall in the z-direction from (z = -0.5 ... 0.5, at r = 1)
+/// Generates a cone with its apex at the origin which opens in the -z
+/// direction. The vertices are stored as {x,y,z,n_x,n_y,n_z}_i.
+/// Render with GL_TRIANGLES.
 void CVoronoi::GenerateCone(vector<vec3> & vertices, vector<unsigned int> & elements)
 {
 	double coneRadius = 6;
@@ -136,8 +132,6 @@ void CVoronoi::Init()
 	GLuint shader_program = mShader->GetProgram();
 	glUseProgram(shader_program);
 	// Now start defining the storage for the VBO.
-	// The 'vbo_data' variable stores a unit cylindrical shell (i.e. r = 1,
-	// h = -0.5 ... 0.5).
 	GLint posAttrib = glGetAttribLocation(shader_program, "position");
 	glEnableVertexAttribArray(posAttrib);
 	glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), 0);
@@ -149,6 +143,14 @@ void CVoronoi::Init()
 		glVertexAttribPointer(normAttrib, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
 	}
 
+	// The per-region (x, y, flux) values advance once per instance.
+	glGenBuffers(1, &mInstanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	GLint regionAttrib = glGetAttribLocation(shader_program, "region");
+	glEnableVertexAttribArray(regionAttrib);
+	glVertexAttribPointer(regionAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), 0);
+	glVertexAttribDivisor(regionAttrib, 1);
+
 	// Check that things loaded correctly.
 	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to create buffers");
 
@@ -164,7 +166,24 @@ void CVoronoi::Init()
 	mModelReady = true;
 }
 
-void CVoronoi::Render(const glm::mat4 & view)
+void CVoronoi::preRender(double & max_flux)
+{
+	if(!mModelReady)
+		Init();
+
+	// Gather the region parameters into a contiguous block.
+	for(unsigned int i = 0; i < mNRegions; i++)
+	{
+		mInstanceData[i].x = mRegionParams[3*i]->getValue();
+		mInstanceData[i].y = mRegionParams[3*i + 1]->getValue();
+		mInstanceData[i].z = mRegionParams[3*i + 2]->getValue();
+
+		if(mInstanceData[i].z > max_flux)
+			max_flux = mInstanceData[i].z;
+	}
+}
+
+void CVoronoi::Render(const glm::mat4 & view, const GLfloat & max_flux)
 {
 	if(!mModelReady)
 		Init();
@@ -172,16 +191,11 @@ void CVoronoi::Render(const glm::mat4 & view)
 	// Activate the shader
 	GLuint shader_program = mShader->GetProgram();
 	mShader->UseShader();
-	GLint uniColorFlag = glGetUniformLocation(shader_program, "color_from_uniform");
-	glUniform1i(uniColorFlag, true);
 
 	// bind back to the VAO
 	glBindVertexArray(mVAO);
 
-	// Look up the color uniform
-    GLint uniColor = glGetUniformLocation(shader_program, "uni_color");
-
-    // Define zero rotation
+	// The regions lie in the plane of the sky, so no rotation is applied.
 	glm::mat4 rotation = mat4(1.0f);
 	GLint uniRotation = glGetUniformLocation(shader_program, "rotation");
 	glUniformMatrix4fv(uniRotation, 1, GL_FALSE, glm::value_ptr(rotation));
@@ -190,43 +204,92 @@ void CVoronoi::Render(const glm::mat4 & view)
 	GLint uniView = glGetUniformLocation(shader_program, "view");
 	glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
 
-	// Look up the translation uniform:
 	GLint uniTranslation = glGetUniformLocation(shader_program, "translation");
+	glUniformMatrix4fv(uniTranslation, 1, GL_FALSE, glm::value_ptr(Translate()));
 
 	GLint uniScale = glGetUniformLocation(shader_program, "scale");
 	glm::mat4 scale = glm::scale(mat4(1.0f), glm::vec3(1.0, 1.0, 1.0));
 	glUniformMatrix4fv(uniScale, 1, GL_FALSE, glm::value_ptr(scale));
 
-	float x = 0;
-	float y = 0;
-	vec2 color = vec2(0.0, 1.0);
-	glm::mat4 location;
+	GLint uniMaxFlux = glGetUniformLocation(shader_program, "max_flux");
+	glUniform1f(uniMaxFlux, max_flux);
+
+	// Upload the region data and draw every cone in one call.
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, mInstanceData.size() * sizeof(vec3), &mInstanceData[0],
+			GL_STREAM_DRAW);
+	glDrawElementsInstanced(GL_TRIANGLES, mNElements, GL_UNSIGNED_INT, 0, mNRegions);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed");
+}
 
+/// Restores the model, creating the required number of regions prior to
+/// restoring their values.
+void CVoronoi::Restore(Json::Value input)
+{
+	if(input.isMember("n_regions"))
+	{
+		unsigned int n_regions = input["n_regions"].asUInt();
+		if(n_regions < 1)
+			throw runtime_error("The Voronoi model requires at least one region.");
+
+		SetNRegions(n_regions);
+	}
+
+	CModel::Restore(input);
+}
+
+/// Serializes the model, including the number of regions.
+Json::Value CVoronoi::Serialize()
+{
+	Json::Value output = CModel::Serialize();
+	output["n_regions"] = mNRegions;
+	return output;
+}
+
+/// Creates (or removes) region parameters such that there are exactly
+/// `n_regions` regions. Existing regions retain their values.
+///
+/// This restructures the parameter map, so it must not be called while the
+/// model is being rendered or fit.
+void CVoronoi::SetNRegions(unsigned int n_regions)
+{
 	stringstream x_id;
 	stringstream y_id;
 	stringstream flux_id;
 
-	for(unsigned int region = 0; region < mNRegions; region++)
+	// Remove regions which are no longer needed.
+	for(unsigned int i = n_regions; i < mNRegions; i++)
 	{
-		// create unique IDs for mapping the pixels
-		x_id << "x_" << region;
-		y_id << "y_" << region;
-		flux_id << "flux_" << region;
+		x_id << "x_" << i;
+		y_id << "y_" << i;
+		flux_id << "flux_" << i;
 
-		x = mParams[x_id.str()].getValue();
-		y = mParams[y_id.str()].getValue();
-		color.x = mParams[flux_id.str()].getValue();
+		removeParameter(x_id.str());
+		removeParameter(y_id.str());
+		removeParameter(flux_id.str());
 
-		// define the position
-		location = glm::translate(mat4(1.0f), vec3(x, y, 0.0));
-		glUniformMatrix4fv(uniTranslation, 1, GL_FALSE, glm::value_ptr(location));
+		// clear the stringstreams
+		x_id.str(std::string());
+		y_id.str(std::string());
+		flux_id.str(std::string());
+	}
 
-		// define the color
-	    glUniform2fv(uniColor, 1, glm::value_ptr(color));
+	// Add any new regions
+	for(unsigned int i = mNRegions; i < n_regions; i++)
+	{
+		// create unique IDs for mapping the pixels
+		x_id << "x_" << i;
+		y_id << "y_" << i;
+		flux_id << "flux_" << i;
 
-		// draw the cone
-//		glDrawElements(GL_POINTS, mNElements, GL_UNSIGNED_INT, 0);
-		glDrawElements(GL_TRIANGLES, mNElements, GL_UNSIGNED_INT, 0);
+		// add the parameters
+		addParameter(x_id.str(), 0, -12, 12, false, 1, x_id.str(), "x position");
+		addParameter(y_id.str(), 0, -12, 12, false, 1, y_id.str(), "y position");
+		addParameter(flux_id.str(), 0, 0, 1, false, 0.1, flux_id.str(), "Pixel flux");
 
 		// clear the stringstreams
 		x_id.str(std::string());
@@ -234,7 +297,27 @@ void CVoronoi::Render(const glm::mat4 & view)
 		flux_id.str(std::string());
 	}
 
-	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Rendering failed");
+	mNRegions = n_regions;
+
+	// Cache pointers to the region parameters so that they need not be looked
+	// up by name every frame.
+	mRegionParams.resize(3 * mNRegions);
+	for(unsigned int i = 0; i < mNRegions; i++)
+	{
+		x_id << "x_" << i;
+		y_id << "y_" << i;
+		flux_id << "flux_" << i;
+
+		mRegionParams[3*i] = &mParams[x_id.str()];
+		mRegionParams[3*i + 1] = &mParams[y_id.str()];
+		mRegionParams[3*i + 2] = &mParams[flux_id.str()];
+
+		x_id.str(std::string());
+		y_id.str(std::string());
+		flux_id.str(std::string());
+	}
+
+	mInstanceData.resize(mNRegions);
 }
 
 /// Overrides the default CModel::SetShader function.
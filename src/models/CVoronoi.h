@@ -22,6 +22,12 @@
 
 #include "CModel.h"
 
+/// \brief A Voronoi tessellation of the image plane.
+///
+/// Each region is described by an (x, y, flux) triplet. The tessellation is
+/// rendered by drawing one cone per region with depth testing enabled so the
+/// nearest seed wins each pixel. All cones are drawn with a single instanced
+/// call whose per-instance attributes are taken from a contiguous buffer.
 class CVoronoi: public CModel
 {
 protected:
@@ -32,6 +38,13 @@ protected:
 	GLuint mVAO;
 	GLuint mVBO;
 	GLuint mEBO;
+	GLuint mInstanceVBO;
+
+	// Pointers to the (x, y, flux) parameters of each region. std::map never
+	// moves its nodes so these remain valid until the regions are rebuilt.
+	vector<CParameter*> mRegionParams;
+	// Per-instance (x, y, flux) data uploaded to mInstanceVBO
+	vector<vec3> mInstanceData;
 
 public:
 	CVoronoi();
@@ -44,8 +57,14 @@ public:
 
 	void Init();
 
-	void Render(const glm::mat4 & view);
+	void preRender(double & max_flux);
+	void Render(const glm::mat4 & view, const GLfloat & max_flux);
+
+	virtual void Restore(Json::Value input); // Overrides CModel::Restore
+
+	virtual Json::Value Serialize(); // Overrides CModel::Serialize
 
+	void SetNRegions(unsigned int n_regions);
 	virtual void SetShader(CShaderPtr shader); // Overrides CModel::SetShader
 
 };
@@ -27,6 +27,7 @@
 #include "CRocheLobe.h"
 #include "CRocheRotator.h"
 #include "CRocheLobe_FF.h"
+#include "CVoronoi.h"
 
 namespace models {
 
@@ -42,6 +43,7 @@ namespace models {
         CModelFactory::getInstance().addItem(&CRocheLobe::Create);
         CModelFactory::getInstance().addItem(&CRocheLobe_FF::Create);
         CModelFactory::getInstance().addItem(&CRocheRotator::Create);
+        CModelFactory::getInstance().addItem(&CVoronoi::Create);
     }
 
 } // namespace models
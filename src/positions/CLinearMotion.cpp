@@ -50,6 +50,19 @@ CPositionPtr CLinearMotion::Create()
 	return CPositionPtr(new CLinearMotion());
 }
 
+/// Linear motion is not periodic (unless the object is stationary).
+double CLinearMotion::GetPeriod()
+{
+	const char * rates[] = {"vN", "aN", "vE", "aE", "vZ", "aZ"};
+	for(auto rate: rates)
+	{
+		if(mParams[rate].getValue() != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
 void CLinearMotion::GetXYZ(double & x, double & y, double & z)
 {
 	// Compute the (N,E,Z) positions based upon simple linear motion.
@@ -31,6 +31,7 @@ public:
 	static CPositionPtr Create();
 
 	virtual void GetXYZ(double & x, double & y, double & z);
+	virtual double GetPeriod();
 };
 
 #endif /* CLINEAR_MOTION_H_ */
@@ -21,6 +21,7 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <cstdio>
+#include <algorithm>
 
 #ifdef M_PI
 #define PI M_PI
@@ -61,57 +62,115 @@ double CPositionOrbit::ComputeM(double tau, double n, double t)
     return n*(t - tau);
 }
 
+/// Solves Kepler's equation, M = E - e sin(E), for the eccentric anomaly E.
+///
+/// Uses the Laguerre-Conway method (Conway 1986, Celestial Mechanics 39, 199)
+/// which converges for all 0 <= e < 1, typically in 2-4 iterations. The mean
+/// anomaly is reduced to [-pi, pi] before solving and the same number of
+/// revolutions is added back to E so that E remains continuous with M.
 double CPositionOrbit::ComputeE(double M, double e)
 {
-    /*
-    Solve Kepler's equation, M = E - e sin(E), using a Newton-Raphson method:
+	// Order of the Laguerre-Conway iteration (Conway recommends n = 5)
+	const double n = 5;
 
-    TODO: This function could be rewritten to use Laguerre polynomials:
-    http://www.springerlink.com/content/p122000960815647/
-    as it has been shown to converge for all e, and faster than the Newton-Raphson
-    method used below.
+	double revolutions = floor(M / (2 * PI) + 0.5);
+	double M_r = M - 2 * PI * revolutions;
 
-    TODO: Possibly try memoization of of E given (M, e).  Should help speed things up
-    a little, especially if M and e are held constant.
-    */
+	// Starting guess from Danby (1987)
+	double E = M_r + 0.85 * e * ((sin(M_r) < 0) ? -1 : 1);
+	double dE = 0;
+	double f, f1, f2, sin_E, cos_E, root, denom;
 
-    int i = 0;
+	for(int i = 0; i < ORBIT_MAX_ITERATIONS; i++)
+	{
+		sin_E = sin(E);
+		cos_E = cos(E);
+		f = E - e * sin_E - M_r;
+		f1 = 1 - e * cos_E;
+		f2 = e * sin_E;
 
-    //printf("M %f \n", M);
-    // Initial guess (from Smith (1979))
-    double E = M + e * sin(M) / (1 - sin(M + e) + sin(M));
-    double E_old = 0;
-    //printf("E0 %f \n", E);
+		root = sqrt(fabs((n - 1) * (n - 1) * f1 * f1 - n * (n - 1) * f * f2));
+		denom = f1 + ((f1 < 0) ? -root : root);
+		if(denom == 0)
+			break;
 
-    // Below we are using the Newton-Raphson solution.  The second term is the derivative
-    // of Kepler's equation.
-    if(e > 0.5)
-    {
-		do
+		dE = -n * f / denom;
+		E += dE;
+
+		if(fabs(dE) < ORBIT_THRESH)
+			break;
+	}
+
+	return E + 2 * PI * revolutions;
+}
+
+/// Solves Kepler's equation for a batch of mean anomalies sharing the same
+/// eccentricity.
+void CPositionOrbit::ComputeE(const vector<double> & M, double e, vector<double> & E)
+{
+	E.resize(M.size());
+	for(unsigned int i = 0; i < M.size(); i++)
+		E[i] = ComputeE(M[i], e);
+}
+
+/// Returns the eccentric anomaly at time t.
+///
+/// Values are cached per epoch and invalidated when any of the parameters
+/// returned by GetEphemeris change. If epochs were supplied by SetEpochs, all
+/// of them are solved at once when the cache is rebuilt.
+double CPositionOrbit::GetE(double t)
+{
+	vector<double> ephemeris = GetEphemeris();
+	if(ephemeris != mEphemeris)
+	{
+		mEphemeris = ephemeris;
+		mEpochE.clear();
+
+		if(mEpochs.size() > 0)
 		{
-			i++;
-			E_old = E;
-			E = E_old + (M + e * sin(E_old) - E_old) / (1 - e * cos(E_old));
-			//printf("E %f \n", E);
+			vector<double> M(mEpochs.size());
+			vector<double> E;
+			for(unsigned int i = 0; i < mEpochs.size(); i++)
+				M[i] = GetMeanAnomaly(mEpochs[i]);
+
+			ComputeE(M, mParams["e"].getValue(), E);
+
+			for(unsigned int i = 0; i < mEpochs.size(); i++)
+				mEpochE[mEpochs[i]] = E[i];
 		}
-		while ((i < ORBIT_MAX_ITERATIONS) && ((E - E_old) > ORBIT_THRESH));
-    }
-    else
-    {
-		do
-		{
-			i++;
-			E_old = E;
-			E = M + e * sin(E);
-		} while ((i < ORBIT_MAX_ITERATIONS) && ((E - E_old) > ORBIT_THRESH));
-    }
+	}
 
-//    if(i == (MAX_ITERATIONS - 1))
-//        printf("WARNING: Failed to Solve Kepler's Equation!");
+	auto it = mEpochE.find(t);
+	if(it != mEpochE.end())
+		return it->second;
 
-    //printf("Ef %f \n", E);
+	// Times not known in advance (e.g. animations) are cached too, but keep the
+	// cache bounded so that scrubbing through time does not grow it indefinitely.
+	if(mEpochE.size() > mEpochs.size() + 1024)
+		mEpochE.clear();
 
-    return E;
+	double E = ComputeE(GetMeanAnomaly(t), mParams["e"].getValue());
+	mEpochE[t] = E;
+	return E;
+}
+
+/// Returns the values of the parameters which determine the eccentric anomaly.
+vector<double> CPositionOrbit::GetEphemeris()
+{
+	vector<double> ephemeris(3);
+	ephemeris[0] = mParams["e"].getValue();
+	ephemeris[1] = mParams["T"].getValue();
+	ephemeris[2] = mParams["P"].getValue();
+	return ephemeris;
+}
+
+/// Returns the mean anomaly at time t.
+double CPositionOrbit::GetMeanAnomaly(double t)
+{
+	double T = mParams["T"].getValue();	// time of periastron
+	double P = mParams["P"].getValue();	// orbital period
+	double n = ComputeN(P);
+	return ComputeM(T, n, t);
 }
 
 // Computes the coefficients, L1, L2, M1, M2, N1, N2 for the orbital equations
@@ -156,20 +215,19 @@ CPositionPtr CPositionOrbit::Create()
 
 void CPositionOrbit::GetAngles(double & Omega_t, double & inc_t, double & omega_t)
 {
-    double e = mParams["e"].getValue();	// eccentricy
-    double T = mParams["T"].getValue();	// time of periastron
-    double P = mParams["P"].getValue();	// orbital period
-    double t = mTime;
-
-    double n = ComputeN(P);
-    double M = ComputeM(T, n, t);
-    double E = ComputeE(M, e);
+    double E = GetE(mTime);
 
     Omega_t = mParams["Omega"].getValue() * PI / 180.0;
     inc_t = mParams["inclination"].getValue() * PI / 180.0;
     omega_t = E;
 }
 
+/// Returns the orbital period (days).
+double CPositionOrbit::GetPeriod()
+{
+	return mParams["P"].getValue();
+}
+
 void CPositionOrbit::GetXYZ(double & x, double & y, double & z)
 {
 	// Local variables (mostly renaming mParams variables for convenience).
@@ -180,14 +238,9 @@ void CPositionOrbit::GetXYZ(double & x, double & y, double & z)
     double omega = mParams["omega"].getValue() * PI / 180.0;
     double alpha = mParams["alpha"].getValue();
     double e = mParams["e"].getValue();	// eccentricy
-    double T = mParams["T"].getValue();	// time of periastron
-    double P = mParams["P"].getValue();	// orbital period
-    double t = mTime;
 
 	// Pre-compute a few values
-    double n = ComputeN(P);
-    double M = ComputeM(T, n, t);
-    double E = ComputeE(M, e);
+    double E = GetE(mTime);
 
     double cos_E = cos(E);
     double sin_E = sin(E);
@@ -197,3 +250,23 @@ void CPositionOrbit::GetXYZ(double & x, double & y, double & z)
     Compute_Coefficients(Omega, inc, omega, l1, m1, n1, l2, m2, n2);
     Compute_xyz(alpha, beta, e, l1, m1, n1, l2, m2, n2, cos_E, sin_E, x, y, z);
 }
+
+/// Sets the epochs at which the orbit will be evaluated. The eccentric anomaly
+/// for all of these epochs is computed in one batch whenever the ephemeris changes.
+///
+/// The tasks call this before every evaluation, so the cache is only
+/// invalidated when the set of epochs actually changes.
+void CPositionOrbit::SetEpochs(const vector<double> & epochs)
+{
+	vector<double> sorted_epochs = epochs;
+	sort(sorted_epochs.begin(), sorted_epochs.end());
+	sorted_epochs.erase(unique(sorted_epochs.begin(), sorted_epochs.end()), sorted_epochs.end());
+
+	if(sorted_epochs == mEpochs)
+		return;
+
+	mEpochs.swap(sorted_epochs);
+
+	// Force the cache to be rebuilt on the next request.
+	mEphemeris.clear();
+}
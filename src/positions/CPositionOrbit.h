@@ -24,12 +24,26 @@
 double const ORBIT_THRESH = 1E-8;
 int const ORBIT_MAX_ITERATIONS = 50;
 
+#include <map>
 #include "CPosition.h"
 
+/// \brief A Keplerian orbit.
+///
+/// Kepler's equation is solved using the Laguerre-Conway method, which converges
+/// for all eccentricities. Because GetAngles and GetXYZ are both called for the same
+/// time, the eccentric anomaly is cached per epoch. When the epochs of the data are
+/// known in advance (see SetEpochs) all of them are solved in one batch whenever
+/// the parameters controlling the ephemeris change.
 class CPositionOrbit: public CPosition
 {
 	friend class CBinaryOrbit;
 
+protected:
+	// Cached eccentric anomaly, keyed by time.
+	map<double, double> mEpochE;
+	vector<double> mEpochs;
+	vector<double> mEphemeris;	// parameter values for which mEpochE is valid
+
 public:
 	CPositionOrbit();
 	virtual ~CPositionOrbit();
@@ -37,7 +51,11 @@ public:
 protected:
 	double ComputeN(double P);
 	double ComputeM(double T, double n, double t);
-	double ComputeE(double M, double e);
+	static double ComputeE(double M, double e);
+	static void ComputeE(const vector<double> & M, double e, vector<double> & E);
+	double GetE(double t);
+	virtual vector<double> GetEphemeris();
+	virtual double GetMeanAnomaly(double t);
 	void Compute_Coefficients(double Omega, double inc, double omega,
 			double & L1, double & M1, double & N1, double & L2, double & M2, double & N2);
 	void Compute_xyz(double a, double beta, double e,
@@ -50,6 +68,9 @@ public:
 
 	void GetAngles(double & Omega_t, double & inc_t, double & omega_t);
 	void GetXYZ(double & x, double & y, double & z);
+	virtual double GetPeriod();
+
+	virtual void SetEpochs(const vector<double> & epochs);
 };
 
 #endif /* CPOSITIONORBIT_H_ */
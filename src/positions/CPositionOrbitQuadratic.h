@@ -22,37 +22,27 @@
 #ifndef CPOSITIONORBITQUADRATIC_H_
 #define CPOSITIONORBITQUADRATIC_H_
 
-// Constants for computing E.
-// double const ORBIT_THRESH = 1E-8;
-// int const ORBIT_MAX_ITERATIONS = 50;
+#include "CPositionOrbit.h"
 
-#include "CPosition.h"
-
-class CPositionOrbitQuadratic: public CPosition
+/// \brief A Keplerian orbit whose period changes linearly with time.
+///
+/// Shares the Kepler solver and per-epoch cache of CPositionOrbit; only the
+/// mean anomaly differs.
+class CPositionOrbitQuadratic: public CPositionOrbit
 {
-	friend class CBinaryOrbit;
-
 public:
 	CPositionOrbitQuadratic();
 	virtual ~CPositionOrbitQuadratic();
 
 protected:
-	double ComputeN(double P);
-	double ComputeM(double T, double n, double t);
 	double ComputeMQuadratic(double T, double P, double dP, double t);
-	double ComputeE(double M, double e);
-	void Compute_Coefficients(double Omega, double inc, double omega,
-			double & L1, double & M1, double & N1, double & L2, double & M2, double & N2);
-	void Compute_xyz(double a, double beta, double e,
-			double l1, double m1, double n1, double l2, double m2, double n2,
-			double cos_E, double sin_E,
-			double & x, double & y, double & z);
+	virtual vector<double> GetEphemeris();
+	virtual double GetMeanAnomaly(double t);
 
 public:
-	static CPositionPtr Create();
+	virtual double GetPeriod();
 
-	void GetAngles(double & Omega_t, double & inc_t, double & omega_t);
-	void GetXYZ(double & x, double & y, double & z);
+	static CPositionPtr Create();
 };
 
 #endif /* CPOSITIONORBITQUADRATIC_H_ */
@@ -0,0 +1,61 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2012 Brian Kloppenborg
+ */
+
+// Analytic spots evaluated per fragment.
+// The base temperature of the surface is stored in the green channel of the
+// flux texture. Fragments within a spot have their flux rescaled by the ratio
+// of the Planck functions at the spotted and unspotted temperatures.
+
+#define MAX_ANALYTIC_SPOTS 16
+
+in vec3 ModelPosition;
+
+uniform int spot_count;
+uniform vec3 spot_center[MAX_ANALYTIC_SPOTS];
+uniform float spot_cos_radius[MAX_ANALYTIC_SPOTS];
+uniform float spot_delta_T[MAX_ANALYTIC_SPOTS];
+uniform float spot_c2_lambda;
+
+vec4 analytic_spots(vec4 color)
+{
+    float T = color.g;
+    if(spot_count == 0 || T <= 0.0)
+        return color;
+
+    // Sum the temperature differences of all spots covering this fragment.
+    vec3 direction = normalize(ModelPosition);
+    float delta_T = 0.0;
+    for(int i = 0; i < spot_count; i++)
+    {
+        if(dot(direction, spot_center[i]) >= spot_cos_radius[i])
+            delta_T += spot_delta_T[i];
+    }
+
+    if(delta_T == 0.0)
+        return color;
+
+    // B(T_spot) / B(T) written to avoid overflowing exp() at low temperatures.
+    float x = spot_c2_lambda / T;
+    float x_spot = spot_c2_lambda / max(T + delta_T, 1.0);
+    color.r *= exp(x - x_spot) * (1.0 - exp(-x)) / (1.0 - exp(-x_spot));
+
+    return color;
+}
@@ -26,8 +26,15 @@ out vec4 out_color;
 
 uniform sampler2DRect TexSampler;
 
+// Defined in analytic_spots_frag.glsl
+vec4 analytic_spots(vec4 color);
+// Defined in surface_normal_frag.glsl (or sphere_impostor_frag.glsl)
+vec3 surface_normal(vec3 normal);
+
 void main()
 {
-    vec4 Color = texture(TexSampler, Tex_Coords);
+    // Discards fragments outside of impostor spheres.
+    surface_normal(Normal);
+    vec4 Color = analytic_spots(texture(TexSampler, Tex_Coords));
     out_color = vec4(Color.r, 0.0, 0.0, Color.a);
 }
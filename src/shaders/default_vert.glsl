@@ -28,15 +28,31 @@ uniform mat4 rotation;
 uniform mat4 scale;
 uniform mat4 translation;
 uniform mat4 view;
+uniform bool impostor;
 
 out vec3 ModelPosition;
 out vec3 Normal;
 out vec2 Tex_Coords;
+out float ImpostorDepth;
 
 void main()
 {
-    Normal =  (rotation * vec4(normal, 0.0)).xyz;
     ModelPosition = (scale * vec4(position, 1.0)).xyz;
-    gl_Position = view * translation * rotation * scale * vec4(position, 1.0);
     Tex_Coords = (tex_coords).xy;
+
+    if(impostor)
+    {
+        // Screen-aligned quad spanning [-1, 1], see sphere_impostor_frag.glsl.
+        // The rotation is irrelevant for a sphere.
+        Normal = vec3(position.xy, 0.0);
+        gl_Position = view * translation * scale * vec4(position, 1.0);
+        // Change in window depth per unit of the sphere's normal.z
+        ImpostorDepth = 0.5 * (view * translation * scale * vec4(0.0, 0.0, 1.0, 0.0)).z;
+    }
+    else
+    {
+        Normal =  (rotation * vec4(normal, 0.0)).xyz;
+        gl_Position = view * translation * rotation * scale * vec4(position, 1.0);
+        ImpostorDepth = 0.0;
+    }
 }
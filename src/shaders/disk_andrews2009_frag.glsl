@@ -34,31 +34,49 @@ uniform float h0;
 uniform float gamma;
 uniform float beta;
 uniform float r_in;
+uniform bool volumetric;
 uniform sampler2DRect TexSampler;
 
 out vec4 out_color;
 
-void main(void)
+// Defined in disk_raymarch_frag.glsl
+float raymarch_column_density(vec3 entry, float max_column);
+
+float density(vec3 position)
 {
-    // Compute the radius and height of this fragment
-    float radius = sqrt(ModelPosition.x * ModelPosition.x + ModelPosition.y * ModelPosition.y);
-    float height = abs(ModelPosition.z);
+    // Compute the radius and height of this point
+    float radius = sqrt(position.x * position.x + position.y * position.y);
+    float height = abs(position.z);
+    if(radius - r_in < 0)
+        return 0.0;
 
     // Compute the density
     float radius_ratio = radius / r0;
-    float midplane_density = rho0 * pow(radius_ratio, -gamma);
     float height_scaling = -0.5 * pow(height / (h0 * pow(radius_ratio, beta)), 2);
     float radial_taper = -1 * pow(radius_ratio, 2 - gamma);
-    float rho = rho0 * pow(radius_ratio, -gamma) * exp(height_scaling) * exp(radial_taper);
+    return rho0 * pow(radius_ratio, -gamma) * exp(height_scaling) * exp(radial_taper);
+}
+
+void main(void)
+{
+    vec4 Color = texture(TexSampler, Tex_Coords);
+    float transparency = 0;
 
-    // Compute the transparency
-    float transparency = 1 - exp(-1 * kappa * rho);
+    if(volumetric)
+    {
+        // Integrate along the line of sight, stopping once tau > 10.
+        float column = raymarch_column_density(ModelPosition, 10.0 / kappa);
+        transparency = 1 - exp(-1 * kappa * column);
+    }
+    else
+    {
+        // Compute the transparency of this ring
+        transparency = 1 - exp(-1 * kappa * density(ModelPosition));
+    }
 
     // compute the output color
-    vec4 Color = texture(TexSampler, Tex_Coords);
-    if(radius - r_in < 0)
+    if(transparency <= 0)
         out_color = vec4(0.0, 0.0, 0.0, 0.0);
     else
         out_color = vec4(Color.r, 0.0, 0.0, Color.a * transparency);
-
 }
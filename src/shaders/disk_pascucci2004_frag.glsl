@@ -32,30 +32,46 @@ uniform float h0;
 uniform float alpha;
 uniform float beta;
 uniform float r_in;
+uniform bool volumetric;
 uniform sampler2DRect TexSampler;
 
 out vec4 out_color;
 
-void main(void)
+// Defined in disk_raymarch_frag.glsl
+float raymarch_column_density(vec3 entry, float max_column);
+
+float density(vec3 position)
 {
-    // Compute the radius and height of this fragment
-    float radius = sqrt(ModelPosition.x * ModelPosition.x + ModelPosition.y * ModelPosition.y);
-    float height = abs(ModelPosition.z);
+    // Compute the radius and height of this point
+    float radius = sqrt(position.x * position.x + position.y * position.y);
+    float height = abs(position.z);
+    if(radius - r_in < 0)
+        return 0.0;
 
     // Compute the density:
-    float midplane_density = rho0 * pow(radius / r0, -alpha);
     float height_scaling = -0.5 * pow(height / (h0 * pow(radius / r0, beta)), 2);
-    float rho = rho0 * pow(radius / r0, -alpha) * exp(height_scaling);
- 
-    // Compute the opacity:
-    // Nothing to do - assume opacity is constant w.r.t. wavelength.
-    
-    // Compute the transparency
-    float transparency = 1 - exp(-1 * kappa * rho);
-    
-    // compute the output color
+    return rho0 * pow(radius / r0, -alpha) * exp(height_scaling);
+}
+
+void main(void)
+{
     vec4 Color = texture(TexSampler, Tex_Coords);
-    if(radius - r_in < 0)
+    float transparency = 0;
+
+    if(volumetric)
+    {
+        // Integrate along the line of sight, stopping once tau > 10.
+        float column = raymarch_column_density(ModelPosition, 10.0 / kappa);
+        transparency = 1 - exp(-1 * kappa * column);
+    }
+    else
+    {
+        // Compute the transparency of this ring
+        transparency = 1 - exp(-1 * kappa * density(ModelPosition));
+    }
+
+    // compute the output color
+    if(transparency <= 0)
         out_color = vec4(0.0, 0.0, 0.0, 0.0);
     else
         out_color = vec4(Color.r, 0.0, 0.0, Color.a * transparency);
@@ -0,0 +1,77 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2012 Brian Kloppenborg
+ */
+
+// Volumetric rendering of density disks.
+// Integrates the density along the line of sight from the fragment to the
+// point where the ray exits the bounding box. The step size adapts to the
+// local contribution to the column density and the march terminates early
+// once the ray becomes opaque.
+
+#define MAX_RAY_STEPS 1024
+
+uniform vec3 ray_direction;    // unit vector along the line of sight (model coordinates)
+uniform vec3 ray_box_max;      // half-size of the bounding box
+uniform float ray_step;        // nominal step size
+
+// Defined in the density shader
+float density(vec3 position);
+
+float raymarch_column_density(vec3 entry, float max_column)
+{
+    // Distance to the exit of the box (slab method)
+    float t_exit = 1E30;
+    for(int i = 0; i < 3; i++)
+    {
+        if(abs(ray_direction[i]) > 1E-6)
+        {
+            float bound = sign(ray_direction[i]) * ray_box_max[i];
+            t_exit = min(t_exit, (bound - entry[i]) / ray_direction[i]);
+        }
+    }
+
+    float min_step = 0.125 * ray_step;
+    float max_step = 4.0 * ray_step;
+    float dt = ray_step;
+    float t = 0.0;
+    float column = 0.0;
+
+    for(int i = 0; i < MAX_RAY_STEPS && t < t_exit && column < max_column; i++)
+    {
+        dt = min(dt, t_exit - t);
+        float d_column = density(entry + (t + 0.5 * dt) * ray_direction) * dt;
+
+        // Refine the step where the column grows quickly...
+        if(d_column > 0.02 * max_column && dt > min_step)
+        {
+            dt = max(0.5 * dt, min_step);
+            continue;
+        }
+
+        column += d_column;
+        t += dt;
+
+        // ... and coarsen it where the ray is nearly empty.
+        if(d_column < 0.002 * max_column)
+            dt = min(2.0 * dt, max_step);
+    }
+
+    return column;
+}
@@ -0,0 +1,53 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2012 Brian Kloppenborg
+ */
+
+// Vertex shader for instanced concentric ring disks.
+// Each instance is a cylindrical wall of unit radius and height, scaled to
+//   radius = ring_r_start + gl_InstanceID * ring_dr
+// and height ring_height. The midplane is drawn as a single instance with
+// ring_dr = 0.
+
+in vec3 position;
+in vec3 normal;
+in vec3 tex_coords;
+
+uniform mat4 rotation;
+uniform mat4 translation;
+uniform mat4 view;
+
+uniform float ring_r_start;
+uniform float ring_dr;
+uniform float ring_height;
+
+out vec3 ModelPosition;
+out vec3 Normal;
+out vec2 Tex_Coords;
+
+void main()
+{
+    float radius = ring_r_start + float(gl_InstanceID) * ring_dr;
+    vec4 scaled = vec4(radius * position.x, radius * position.y, ring_height * position.z, 1.0);
+
+    Normal =  (rotation * vec4(normal, 0.0)).xyz;
+    ModelPosition = scaled.xyz;
+    gl_Position = view * translation * rotation * scaled;
+    Tex_Coords = (tex_coords).xy;
+}
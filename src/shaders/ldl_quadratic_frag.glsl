@@ -28,12 +28,18 @@ in vec2 Tex_Coords;
 uniform float a1;
 uniform float a2;
 uniform sampler2DRect TexSampler;
+
+// Defined in analytic_spots_frag.glsl
+vec4 analytic_spots(vec4 color);
+// Defined in surface_normal_frag.glsl (or sphere_impostor_frag.glsl)
+vec3 surface_normal(vec3 normal);
 out vec4 out_color;
 
 void main(void)
 {
-	vec4 Color = texture(TexSampler, Tex_Coords);
-	float mu = abs(dot(Normal, vec3(0.0, 0.0, 1.0)));
+	vec4 Color = analytic_spots(texture(TexSampler, Tex_Coords));
+	vec3 normal = surface_normal(Normal);
+	float mu = abs(dot(normal, vec3(0.0, 0.0, 1.0)));
   // Simple quadratic limb darkening:
   float intensity = 1- a1 * (1 - mu) - a2 * pow( (1 - mu), 2.0);
   out_color = vec4(intensity * Color.r, 0, 0, Color.a);
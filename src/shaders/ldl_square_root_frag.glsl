@@ -29,15 +29,21 @@ uniform float a1;
 uniform float a2;
 uniform sampler2DRect TexSampler;
 
+// Defined in analytic_spots_frag.glsl
+vec4 analytic_spots(vec4 color);
+// Defined in surface_normal_frag.glsl (or sphere_impostor_frag.glsl)
+vec3 surface_normal(vec3 normal);
+
 void main(void)
 {
-    float mu = abs(dot(Normal, vec3(0.0, 0.0, 1.0)));
+    vec3 normal = surface_normal(Normal);
+    float mu = abs(dot(normal, vec3(0.0, 0.0, 1.0)));
     
     // Simple quadratic limb darkening:
     float intensity = 1;
 	intensity -= a1 * (1 - mu);
 	intensity -= a2 * (1 - sqrt(mu));
 
-    vec4 Color = texture(TexSampler, Tex_Coords);
+    vec4 Color = analytic_spots(texture(TexSampler, Tex_Coords));
     gl_FragColor = vec4(intensity * Color.x, 0, 0, Color.a);
 }
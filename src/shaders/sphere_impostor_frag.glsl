@@ -0,0 +1,41 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+// Sphere impostors.
+// The model is drawn as a screen-aligned quad whose (interpolated) normal
+// holds the quad coordinates in [-1, 1]. The exact normal of the sphere is
+// reconstructed per fragment, fragments outside of the disk are discarded,
+// and the depth is moved onto the sphere's surface.
+// This replaces surface_normal_frag.glsl in the programs CSphere uses for
+// impostors only, see CSphere::GetImpostorShader.
+
+in float ImpostorDepth;
+
+vec3 surface_normal(vec3 normal)
+{
+    float r2 = dot(normal.xy, normal.xy);
+    if(r2 > 1.0)
+        discard;
+
+    vec3 sphere_normal = vec3(normal.xy, sqrt(1.0 - r2));
+    gl_FragDepth = gl_FragCoord.z + ImpostorDepth * sphere_normal.z;
+    return sphere_normal;
+}
@@ -0,0 +1,30 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+// Surface normal of a rasterized mesh, the interpolated normal is returned
+// as-is. CSphere replaces this library with sphere_impostor_frag.glsl when it
+// draws an impostor, so this variant must not write gl_FragDepth (doing so
+// disables early depth testing).
+
+vec3 surface_normal(vec3 normal)
+{
+    return normal;
+}
@@ -0,0 +1,35 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2012 Brian Kloppenborg
+ */
+
+// Fragment shader for the Voronoi tessellation model.
+// The depth test selects the nearest region, we simply output its flux.
+
+flat in float Flux;
+
+uniform float max_flux;
+
+out vec4 out_color;
+
+void main()
+{
+    float flux = (max_flux > 0.0) ? Flux / max_flux : Flux;
+    out_color = vec4(flux, 0.0, 0.0, 1.0);
+}
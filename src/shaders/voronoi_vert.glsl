@@ -0,0 +1,40 @@
+#version 330 core
+
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2012 Brian Kloppenborg
+ */
+
+// Vertex shader for the Voronoi tessellation model.
+// Each instance is a cone centered on the (x, y) position of a region.
+
+in vec3 position;
+in vec3 region;     // per-instance (x, y, flux)
+
+uniform mat4 rotation;
+uniform mat4 scale;
+uniform mat4 translation;
+uniform mat4 view;
+
+flat out float Flux;
+
+void main()
+{
+    vec4 vertex = vec4(position.xy + region.xy, position.z, 1.0);
+    gl_Position = view * translation * rotation * scale * vertex;
+    Flux = region.z;
+}
@@ -21,18 +21,28 @@
 
 #include "OpenGL.h" // OpenGL includes, plus several workarounds for various OSes
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <stdexcept>
 #include <fstream>
 #include <random>
+#include <complex>
+#include <mutex>
+#include "fitsio.h"
 #include "oi_tools.hpp"
+#include "oi_file.hpp"
 // TODO: Figure out how to pull in additional calibrator models
 #include "CUniformDisk.h"
 #include "CTask.h"
 
 #include "CModelList.h"
+#include "CSnapshot.h"
 
 extern string EXE_FOLDER;
 
+const unsigned int COI::N_PIXEL_BUFFERS;
+
 COI::COI(CWorkerThread * WorkerThread)
 	: CTask(WorkerThread)
 {
@@ -45,8 +55,13 @@ COI::COI(CWorkerThread * WorkerThread)
 	mLibOI = NULL;
 	mLibOIInitialized = false;
 	mInteropEnabled = false;
-
-	mTempFloat = NULL;
+	mEngine = ENGINE_OPENCL;
+	mTransform = CVisibilityEngine::METHOD_AUTO;
+	mOversampling = 2;
+	mKernelWidth = 6;
+	mDFTCacheSize = 512;
+	mHostImage = NULL;
+	mNextPixelBuffer = 0;
 
 	// Describe the data and provide extensions
 	mDataDescription = "OIFITS data";
@@ -58,23 +73,25 @@ COI::COI(CWorkerThread * WorkerThread)
 COI::~COI()
 {
 	delete mLibOI;
-	if(mTempFloat) delete mTempFloat;
+	if(mPixelBuffers.size() > 0) glDeleteBuffers(mPixelBuffers.size(), &mPixelBuffers[0]);
 
 	if(mFBO_render) delete mFBO_render;
 	if(mFBO_storage) delete mFBO_storage;
 }
 
 /// \brief Creates a new data set via. bootstrapping and replacing currently loaded data.
+///
+/// Data sets restored from a snapshot have no OIFITS data to resample and are
+/// left unchanged.
 void COI::BootstrapNext(unsigned int maxBootstrapFailures)
 {
-	unsigned int nBootstrapFailures;
+	unsigned int nBootstrapFailures = 0;
 
 	// If this is our first bootstrap, copy the OIDataList into local memory.
-	if(mData.size() == 0)
+	for(auto & data: mAnalyticData)
 	{
-		int nData = mLibOI->GetNDataSets();
-		for(int data_set = 0; data_set < nData; data_set++)
-			mData.push_back(mLibOI->GetData(data_set));
+		if(data.liboi_index >= 0 && data.source.size() == 0)
+			data.source = mLibOI->GetData(data.liboi_index);
 	}
 
 	// TODO: Calibrator information is hard-coded for eps Aur. This should be read in from elsewhere.
@@ -91,21 +108,43 @@ void COI::BootstrapNext(unsigned int maxBootstrapFailures)
 	// Recalibrate the data.
 	// TODO: Note this function assumes the SAME calibrator is used on ALL data sets. This probably isn't true.
 	// This issue is listed in https://github.com/bkloppenborg/simtoi/issues/53.
-	for(int i = 0; i < mData.size(); i++)
+	for(int i = 0; i < mAnalyticData.size(); i++)
 	{
-		auto data = mData[i];
+		COIAnalyticData & data = mAnalyticData[i];
+		if(data.source.size() == 0)
+			continue;
 
 		// Recalibrate, bootstrap, then push to the OpenCL device:
-//		OIDataList t_data = Recalibrate(data, old_cal, new_cal);
+//		OIDataList t_data = Recalibrate(data.source, old_cal, new_cal);
 //		t_data = Bootstrap_Spectral(t_data);
-		OIDataList t_data = Bootstrap_Spectral(data);
+		OIDataList t_data = Bootstrap_Spectral(data.source);
 
 		// Replace the 0th entry with temp.
 		// Due to a bug in ccoifits the total data size may not be preserved, so we need to
 		// catch and repeat.
 		try
 		{
-			mLibOI->ReplaceData(i, t_data);
+			if(data.liboi_index >= 0)
+			{
+				mLibOI->ReplaceData(data.liboi_index, t_data);
+				data.loaded = false;
+			}
+			else
+			{
+				// Host data sets must keep their size, as liboi requires.
+				COIAnalyticData resampled;
+				ExtractHostData(t_data, resampled);
+				if(resampled.v2.size() != data.v2.size() || resampled.t3.size() != data.t3.size())
+					throw length_error("The bootstrapped data set changed size.");
+
+				data.v2.swap(resampled.v2);
+				data.v2_err.swap(resampled.v2_err);
+				data.t3.swap(resampled.t3);
+				data.t3_err.swap(resampled.t3_err);
+				data.jd.swap(resampled.jd);
+				data.wavelength.swap(resampled.wavelength);
+				data.uv.swap(resampled.uv);
+			}
 		}
 		catch(length_error& l)
 		{
@@ -123,6 +162,9 @@ void COI::BootstrapNext(unsigned int maxBootstrapFailures)
 		}
 		nBootstrapFailures = 0;
 	}
+
+	// The data changed, re-gather the epochs.
+	mEpochs.clear();
 }
 
 CTaskPtr COI::Create(CWorkerThread * WorkerThread)
@@ -132,12 +174,15 @@ CTaskPtr COI::Create(CWorkerThread * WorkerThread)
 
 void COI::clearData()
 {
-	unsigned int n_data_sets = mLibOI->GetNDataSets();
+	unsigned int n_data_sets = (mLibOI != NULL) ? mLibOI->GetNDataSets() : 0;
 
 	for(int i = n_data_sets - 1; i > -1; i--)
 	{
 		mLibOI->RemoveData(i);
 	}
+
+	mAnalyticData.clear();
+	mEpochs.clear();
 }
 
 void  COI::copyImage()
@@ -149,41 +194,118 @@ void  COI::copyImage()
 	if(mInteropEnabled)
 	{
 		mLibOI->CopyImageToBuffer(0);
+		return;
 	}
-	else
+
+	FinishImageCopy(StartImageCopy());
+	mLibOI->CopyImageToBuffer(0);
+}
+
+/// Computes chi for an image read back by StartImageCopy, using either the
+/// CPU visibility engine or liboi.
+void COI::FinishChi(const COIImageReadback & readback)
+{
+	FinishImageCopy(readback);
+
+	if(readback.cpu)
 	{
-		unsigned int width = mWorkerThread->GetImageWidth();
-		unsigned int height = mWorkerThread->GetImageHeight();
-		// something with mFBO_storage
+		GetImageChi(readback, &mTempFloat[readback.chi_offset]);
+		return;
+	}
 
-		GLint buffer_format = this->mWorkerThread->glPixelDataFormat();
-		switch(buffer_format)
-		{
-		case GL_FLOAT:
-			// floating point buffer, simply copy the data directly
-			glReadPixels(0, 0, width, height, GL_RED, buffer_format, mHostImage);
-			mLibOI->CopyImageToBuffer(0);
+	mLibOI->CopyImageToBuffer(0);
+	mLibOI->ImageToChi(mAnalyticData[readback.data_set].liboi_index,
+			&mTempFloat[readback.chi_offset], readback.chi_size);
+}
 
-			break;
+/// Waits for a readback started by StartImageCopy and converts the image into
+/// the host image.
+void COI::FinishImageCopy(const COIImageReadback & readback)
+{
+	unsigned int width = mWorkerThread->GetImageWidth();
+	unsigned int height = mWorkerThread->GetImageHeight();
+	GLint buffer_format = mWorkerThread->glPixelDataFormat();
+	const GLint * region = readback.region;
 
-		case GL_UNSIGNED_INT:
-			// unsigned integer buffer, copy and convert the data
-			unsigned int * temp = new unsigned int[width * height];
-			glReadPixels(0, 0, width, height, GL_RED, buffer_format, temp);
+	// Nothing was drawn, the image is empty.
+	if(region[2] <= 0 || region[3] <= 0)
+	{
+		fill(mHostImage, mHostImage + width * height, 0.0f);
+		return;
+	}
 
-			float sum = 0;
-			for(int i = 0; i < width * height; i++)
-			{
-				mHostImage[i] = float(temp[i]);
-			}
+	// Map only the rows which were read.
+	const size_t row_offset = size_t(region[1]) * width;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, mPixelBuffers[readback.buffer]);
+	const void * pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, row_offset * sizeof(GLfloat),
+			size_t(region[3]) * width * sizeof(GLfloat), GL_MAP_READ_BIT);
+	if(pixels == NULL)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		throw runtime_error("Could not map the pixel buffer holding the rendered image.");
+	}
 
-			delete[] temp;
-			break;
+	// Pixels outside of the occupied region are zero.
+	if(region[2] < GLint(width) || region[3] < GLint(height))
+		fill(mHostImage, mHostImage + width * height, 0.0f);
 
-			mLibOI->CopyImageToBuffer(0);
-		}
+	for(GLint row = 0; row < region[3]; row++)
+	{
+		const size_t start = size_t(row) * width + region[0];
+		float * output = mHostImage + row_offset + start;
 
+		if(buffer_format == GL_FLOAT)
+			memcpy(output, (const GLfloat *) pixels + start, region[2] * sizeof(GLfloat));
+		else
+		{
+			// unsigned integer buffer, convert the data
+			const GLuint * input = (const GLuint *) pixels + start;
+			for(GLint i = 0; i < region[2]; i++)
+				output[i] = float(input[i]);
+		}
 	}
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/// Starts reading the rendered image from the storage buffer into the next
+/// pixel buffer object. With a pack buffer bound glReadPixels returns
+/// immediately, so the copy proceeds while the next image is rendered. Only
+/// the region occupied by the models is read.
+COIImageReadback COI::StartImageCopy()
+{
+	unsigned int width = mWorkerThread->GetImageWidth();
+	GLint buffer_format = mWorkerThread->glPixelDataFormat();
+
+	COIImageReadback readback;
+	readback.buffer = mNextPixelBuffer;
+	readback.data_set = -1;
+	readback.cpu = false;
+	readback.chi_offset = 0;
+	readback.chi_size = 0;
+	mWorkerThread->GetModelList()->GetOccupiedRegion(readback.region);
+	mNextPixelBuffer = (mNextPixelBuffer + 1) % mPixelBuffers.size();
+
+	const GLint * region = readback.region;
+	if(region[2] <= 0 || region[3] <= 0)
+		return readback;
+
+	// Both GL_FLOAT and GL_UNSIGNED_INT pixels are four bytes, the pointer
+	// passed to glReadPixels is an offset into the pack buffer.
+	const size_t offset = (size_t(region[1]) * width + region[0]) * sizeof(GLfloat);
+
+	mFBO_storage->bind();
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, mPixelBuffers[readback.buffer]);
+	glPixelStorei(GL_PACK_ROW_LENGTH, width);
+	glReadPixels(region[0], region[1], region[2], region[3], GL_RED, buffer_format, (GLvoid *) offset);
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	mFBO_storage->release();
+
+	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to start reading the rendered image");
+
+	return readback;
 }
 
 void COI::Export(string folder_name)
@@ -198,49 +320,67 @@ void COI::Export(string folder_name)
 	summary.open(folder_name + "summary.txt", ios::app | ios_base::in | ios_base::out);
 	summary.precision(8);
 	// Allocate a buffer in which the data may be stored.
-	unsigned int max_data = mLibOI->GetMaxDataSize();
+	unsigned int n_data_sets = mAnalyticData.size();
+	unsigned int max_data = 0;
+	for(unsigned int data_set = 0; data_set < n_data_sets; data_set++)
+		max_data = max(max_data, GetDataSize(data_set));
 	vector<float> temp_chi(max_data);
 	unsigned int n_vis = 0, n_vis2 = 0, n_t3 = 0, start = 0, n_data_size = 0;
 	double total_chi2 = 0, vis_real_chi2 = 0, vis_imag_chi2 = 0, vis2_chi2 = 0, t3_real_chi2 = 0, t3_imag_chi2 = 0;
 
-	unsigned int n_data_sets = mLibOI->GetNDataSets();
 	for(int data_set = 0; data_set < n_data_sets; data_set++)
 	{
+		COIAnalyticData & data = mAnalyticData[data_set];
+
 		// Get the base name for the file:
-		filename = mLibOI->GetDataFileName(data_set);
+		filename = data.filename;
 		filename = StripPath(filename);
 		filename = StripExtension(filename, mExtensions);
 
 		// Set the current JD, render the model.
-		model_list->SetTime(mLibOI->GetDataAveJD(data_set));
-		model_list->SetWavelength(mLibOI->GetDataAveWavelength(data_set));
-		// render
-		mFBO_render->bind();
-		model_list->Render(mWorkerThread->GetView());
-		mFBO_render->release();
-
-		// Blit to the storage buffer (for liboi to use the image)
-		mWorkerThread->BlitToBuffer(mFBO_render, mFBO_storage);
-		mWorkerThread->BlitToScreen(mFBO_render);
-		copyImage();
-
-		// Now export the image, overwriting any image that already exists:
-		mLibOI->ExportImage("!" + folder_name + filename + "_model.fits");
+		model_list->SetTime(data.jd_mean);
+		model_list->SetWavelength(data.wavelength_mean);
 
-		// Now generate and save the simulated data:
-		mLibOI->ImageToData(data_set);
-		mLibOI->ExportData(data_set, folder_name + filename);
-
-		// Generate the chi2
-//		n_vis = mLibOI->GetNVis(data_set);
-		n_vis = 0;
-		n_vis2 = mLibOI->GetNV2(data_set);
-		n_t3 = mLibOI->GetNT3(data_set);
-		n_data_size = mLibOI->GetNDataAllocated(data_set);
+		n_data_size = GetDataSize(data_set);
 		// Clear out the chi buffer:
 		for(unsigned int i = 0; i < max_data; i++)
 			temp_chi[i] = 0;
-		mLibOI->ImageToChi(data_set, &temp_chi[0], n_data_size);
+
+		if(data.liboi_index >= 0)
+		{
+			// render
+			mFBO_render->bind();
+			model_list->Render(mWorkerThread->GetView());
+			mFBO_render->release();
+
+			// Blit to the storage buffer (for liboi to use the image)
+			mWorkerThread->BlitToBuffer(mFBO_render, mFBO_storage);
+			mWorkerThread->BlitToScreen(mFBO_render);
+			copyImage();
+
+			// Now export the image, overwriting any image that already exists:
+			mLibOI->ExportImage("!" + folder_name + filename + "_model.fits");
+
+			// Now generate and save the simulated data:
+			mLibOI->ImageToData(data.liboi_index);
+			mLibOI->ExportData(data.liboi_index, folder_name + filename);
+
+//			n_vis = mLibOI->GetNVis(data.liboi_index);
+			n_vis = 0;
+			n_vis2 = mLibOI->GetNV2(data.liboi_index);
+			n_t3 = mLibOI->GetNT3(data.liboi_index);
+			mLibOI->ImageToChi(data.liboi_index, &temp_chi[0], n_data_size);
+		}
+		else
+		{
+			// Data sets restored from a snapshot are not held by liboi, so
+			// only their chi-squared is exported.
+			n_vis = 0;
+			n_vis2 = data.v2.size();
+			n_t3 = data.t3.size();
+			GetDataSetChi(data_set, &temp_chi[0], n_data_size);
+		}
+
 		// Compute the chi-squared for each element.
 		for(unsigned int i = 0; i < n_data_size; i++)
 			temp_chi[i] *= temp_chi[i];
@@ -273,6 +413,104 @@ void COI::Export(string folder_name)
 	}
 }
 
+/// Computes chi for one data set held on the host, from the analytic
+/// visibilities if possible or by rendering the model and transforming the
+/// image with the CPU visibility engine. The time and wavelength must be set.
+void COI::GetDataSetChi(unsigned int data_set, float * chis, unsigned int size)
+{
+	CModelListPtr model_list = mWorkerThread->GetModelList();
+	if(model_list->HasAnalyticVisibility() && GetAnalyticChi(data_set, chis, size))
+		return;
+
+	InitReadback();
+
+	mFBO_render->bind();
+	model_list->Render(mWorkerThread->GetView());
+	mFBO_render->release();
+
+	mWorkerThread->BlitToBuffer(mFBO_render, mFBO_storage);
+	mWorkerThread->BlitToScreen(mFBO_render);
+
+	COIImageReadback readback = StartImageCopy();
+	readback.data_set = data_set;
+	readback.cpu = true;
+	readback.chi_offset = 0;
+	readback.chi_size = size;
+	FinishImageCopy(readback);
+	GetImageChi(readback, chis);
+}
+
+/// Computes chi for the specified data set directly from the analytic
+/// visibilities of the models, without rendering an image. Returns false if
+/// the data set contains data which is not supported by this path (see
+/// `HasHostChi`), in which case the caller should fall back to rendering the
+/// model.
+bool COI::GetAnalyticChi(unsigned int data_set, float * chis, unsigned int size)
+{
+	if(!HasHostChi(data_set, size))
+		return false;
+
+	COIAnalyticData & data = mAnalyticData[data_set];
+	mWorkerThread->GetModelList()->GetVisibilities(data.uv, data.vis);
+	GetHostChi(data, chis);
+
+	return true;
+}
+
+/// Computes chi from the model visibilities stored in `data.vis`.
+///
+/// The chi values follow liboi's packing, [vis_real, vis_imag, vis2, t3_real,
+/// t3_imag], where the T3 residuals are taken on the real and imaginary parts
+/// independently.
+void COI::GetHostChi(COIAnalyticData & data, float * chis)
+{
+	const unsigned int n_v2 = data.v2.size();
+	const unsigned int n_t3 = data.t3.size();
+
+	for(unsigned int i = 0; i < n_v2; i++)
+	{
+		const double model_v2 = norm(data.vis[i]);
+		chis[i] = (data.v2_err[i] > 0) ? (model_v2 - data.v2[i]) / data.v2_err[i] : 0;
+	}
+
+	float * t3_real = chis + n_v2;
+	float * t3_imag = t3_real + n_t3;
+	for(unsigned int i = 0; i < n_t3; i++)
+	{
+		const unsigned int j = n_v2 + 3 * i;
+		const complex<double> model_t3 = data.vis[j] * data.vis[j + 1] * data.vis[j + 2];
+		const complex<double> residual = model_t3 - data.t3[i];
+		const complex<double> error = data.t3_err[i];
+
+		t3_real[i] = (error.real() > 0) ? residual.real() / error.real() : 0;
+		t3_imag[i] = (error.imag() > 0) ? residual.imag() / error.imag() : 0;
+	}
+}
+
+/// Computes chi for an image read back by StartImageCopy using the CPU
+/// visibility engine. The engine's geometry is kept with the data set, so the
+/// twiddle factors are reused across evaluations.
+void COI::GetImageChi(const COIImageReadback & readback, float * chis)
+{
+	unsigned int width = mWorkerThread->GetImageWidth();
+	unsigned int height = mWorkerThread->GetImageHeight();
+
+	// dft_cache_size is the total for all data sets. The twiddle factor tables
+	// grow with the number of (u,v) points, so the budget is split likewise.
+	size_t n_uv_total = 0;
+	for(auto & data_set: mAnalyticData)
+		n_uv_total += data_set.uv.size();
+
+	COIAnalyticData & data = mAnalyticData[readback.data_set];
+	const double cache_fraction = (n_uv_total > 0) ? double(data.uv.size()) / n_uv_total : 1;
+	data.engine.SetMethod(mTransform, mOversampling, mKernelWidth);
+	data.engine.SetCacheLimit(size_t(mDFTCacheSize * cache_fraction * 1024 * 1024));
+	data.engine.SetGeometry(data.uv, width, height, mWorkerThread->GetImageScale());
+	data.engine.GetVisibilities(mHostImage, readback.region, data.vis);
+
+	GetHostChi(data, chis);
+}
+
 void COI::GetChi(double * chis, unsigned int size)
 {
 	InitBuffers();
@@ -282,13 +520,44 @@ void COI::GetChi(double * chis, unsigned int size)
 
 	CModelListPtr model_list = mWorkerThread->GetModelList();
 
+	// If all of the models have closed-form visibilities, skip rendering.
+	const bool analytic = model_list->HasAnalyticVisibility();
+
+	// Without interop the images are read back asynchronously and the chi of
+	// a data set is computed while the next one is rendered.
+	deque<COIImageReadback> pending;
+
 	// Now iterate through the data and pull out the residuals, notice we do pointer math on mResiduals
-	unsigned int n_data_sets = mLibOI->GetNDataSets();
+	unsigned int n_data_sets = mAnalyticData.size();
+
+	// Let time-dependent positions solve for all of the epochs at once. The
+	// epochs are only gathered again after the data changes.
+	if(mEpochs.size() != n_data_sets)
+	{
+		mEpochs.resize(n_data_sets);
+		for(int data_set = 0; data_set < n_data_sets; data_set++)
+			mEpochs[data_set] = mAnalyticData[data_set].jd_mean;
+	}
+	model_list->SetEpochs(mEpochs);
+
 	for(int data_set = 0; data_set < n_data_sets; data_set++)
 	{
-		n_data_alloc = mLibOI->GetNDataAllocated(data_set);
-		model_list->SetTime(mLibOI->GetDataAveJD(data_set));
-		model_list->SetWavelength(mLibOI->GetDataAveWavelength(data_set));
+		n_data_alloc = GetDataSize(data_set);
+		model_list->SetTime(mAnalyticData[data_set].jd_mean);
+		model_list->SetWavelength(mAnalyticData[data_set].wavelength_mean);
+
+		if(analytic && GetAnalyticChi(data_set, &mTempFloat[n_data_offset], n_data_alloc))
+		{
+			n_data_offset += n_data_alloc;
+			continue;
+		}
+
+		// Data sets which are not held by liboi always use the CPU engine.
+		const bool cpu = (mAnalyticData[data_set].liboi_index < 0)
+				|| ((mEngine == ENGINE_CPU) && HasHostChi(data_set, n_data_alloc));
+		if(cpu)
+			InitReadback();
+
 		mFBO_render->bind();
 		model_list->Render(mWorkerThread->GetView());
 		mFBO_render->release();
@@ -298,17 +567,39 @@ void COI::GetChi(double * chis, unsigned int size)
 		// Blit to the screen (to show the user, not required, but nice.
 		mWorkerThread->BlitToScreen(mFBO_render);
 
-		copyImage();
+		if(mInteropEnabled && !cpu)
+		{
+			copyImage();
 
-		// Notice, the ImageToChi expects a floating point array, not a valarray<float>.
-		// C++11 guarantees that storage is contiguous so we can do pointer math
-		// within the valarray storage without issues.
-		mLibOI->ImageToChi(data_set, mTempFloat + n_data_offset, n_data_alloc);
+			// Notice, the ImageToChi expects a floating point array, not a valarray<float>.
+			// C++11 guarantees that storage is contiguous so we can do pointer math
+			// within the valarray storage without issues.
+			mLibOI->ImageToChi(mAnalyticData[data_set].liboi_index, &mTempFloat[n_data_offset], n_data_alloc);
+		}
+		else
+		{
+			COIImageReadback readback = StartImageCopy();
+			readback.data_set = data_set;
+			readback.cpu = cpu;
+			readback.chi_offset = n_data_offset;
+			readback.chi_size = n_data_alloc;
+			pending.push_back(readback);
+
+			// Free the oldest pixel buffer before it is needed again.
+			if(pending.size() >= mPixelBuffers.size())
+			{
+				FinishChi(pending.front());
+				pending.pop_front();
+			}
+		}
 
 		// Advance the pointer
 		n_data_offset += n_data_alloc;
 	}
 
+	for(auto & readback: pending)
+		FinishChi(readback);
+
 	// Copy the floats from liboi into doubles for SIMTOI.
 	for(unsigned int i = 0; i < size; i++)
 	{
@@ -337,18 +628,104 @@ CDataInfo COI::getDataInfo()
 
 unsigned int COI::GetNData()
 {
-	return mLibOI->GetNData();
+	unsigned int n_data = (mLibOI != NULL) ? mLibOI->GetNData() : 0;
+	for(unsigned int data_set = 0; data_set < mAnalyticData.size(); data_set++)
+	{
+		if(mAnalyticData[data_set].liboi_index < 0)
+			n_data += GetDataSize(data_set);
+	}
+
+	return n_data;
 }
 
 int COI::GetNDataFiles()
 {
-	int n_data = 0;
-	if(mLibOI != NULL)
-		n_data = mLibOI->GetNDataSets();
+	return mAnalyticData.size();
+}
+
+/// Returns the number of chi values of a data set, following liboi's packing.
+unsigned int COI::GetDataSize(unsigned int data_set)
+{
+	const COIAnalyticData & data = mAnalyticData[data_set];
+	if(data.liboi_index >= 0)
+		return mLibOI->GetNDataAllocated(data.liboi_index);
+
+	return data.v2.size() + 2 * data.t3.size();
+}
+
+/// Returns the number of chi values of all data sets.
+unsigned int COI::GetDataSize()
+{
+	unsigned int n_data = 0;
+	for(unsigned int data_set = 0; data_set < mAnalyticData.size(); data_set++)
+		n_data += GetDataSize(data_set);
 
 	return n_data;
 }
 
+/// Finds the dates of the V2 and T3 data read by ParseData.
+bool COI::GetEpochs(CTaskDataPtr data, vector<double> & epochs)
+{
+	COIDataPtr oi_data = dynamic_pointer_cast<COIData>(data);
+	if(!oi_data)
+		return false;
+
+	if(oi_data->host.loaded)
+		epochs = oi_data->host.jd;
+	else
+	{
+		// OIFITS stores modified Julian dates.
+		epochs.clear();
+		for(auto mjd: ExportV2MJD(oi_data->data))
+			epochs.push_back(mjd + 2400000.5);
+		for(auto mjd: ExportT3MJD(oi_data->data))
+			epochs.push_back(mjd + 2400000.5);
+	}
+
+	return epochs.size() > 0;
+}
+
+/// Finds the shortest and longest (non-zero) baselines, in wavelengths, of the
+/// V2 and T3 data read by ParseData.
+bool COI::GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max)
+{
+	COIDataPtr oi_data = dynamic_pointer_cast<COIData>(data);
+	if(!oi_data)
+		return false;
+
+	// Data restored from a snapshot carries its (u,v) points.
+	vector<pair<double,double> > v2_uv;
+	vector<pair<double,double> > t3_uv;
+	if(oi_data->host.loaded)
+		v2_uv = oi_data->host.uv;
+	else
+	{
+		auto oi_v2_uv = ExportV2UV(oi_data->data);
+		auto oi_t3_uv = ExportT3UV(oi_data->data);
+		v2_uv.assign(begin(oi_v2_uv), end(oi_v2_uv));
+		t3_uv.assign(begin(oi_t3_uv), end(oi_t3_uv));
+	}
+
+	min = 0;
+	max = 0;
+	auto add = [&min, &max](const pair<double,double> & uv)
+	{
+		const double r = sqrt(uv.first * uv.first + uv.second * uv.second);
+		if(r <= 0)
+			return;
+
+		min = (min > 0) ? std::min(min, r) : r;
+		max = std::max(max, r);
+	};
+
+	for(auto & uv: v2_uv)
+		add(uv);
+	for(auto & uv: t3_uv)
+		add(uv);
+
+	return max > 0;
+}
+
 void COI::GetUncertainties(double * uncertainties, unsigned int size)
 {
 	InitBuffers();
@@ -357,15 +734,31 @@ void COI::GetUncertainties(double * uncertainties, unsigned int size)
 	unsigned int n_data_alloc = 0;
 
 	// Now iterate through the data and pull out the residuals, notice we do pointer math on mResiduals
-	unsigned int n_data_sets = mLibOI->GetNDataSets();
+	unsigned int n_data_sets = mAnalyticData.size();
 	for(int data_set = 0; data_set < n_data_sets; data_set++)
 	{
-		n_data_alloc = mLibOI->GetNDataAllocated(data_set);
+		const COIAnalyticData & data = mAnalyticData[data_set];
+		n_data_alloc = GetDataSize(data_set);
 
 		// Notice, the ImageToChi expects a floating point array, not a valarray<float>.
 		// C++11 guarantees that storage is contiguous so we can do pointer math
 		// within the valarray storage without issues.
-		mLibOI->GetDataUncertainties(data_set, mTempFloat + n_data_offset, n_data_alloc);
+		if(data.liboi_index >= 0)
+			mLibOI->GetDataUncertainties(data.liboi_index, &mTempFloat[n_data_offset], n_data_alloc);
+		else
+		{
+			// Same packing as GetHostChi: [vis2, t3_real, t3_imag]
+			float * output = &mTempFloat[n_data_offset];
+			const unsigned int n_v2 = data.v2.size();
+			const unsigned int n_t3 = data.t3.size();
+			for(unsigned int i = 0; i < n_v2; i++)
+				output[i] = data.v2_err[i];
+			for(unsigned int i = 0; i < n_t3; i++)
+			{
+				output[n_v2 + i] = data.t3_err[i].real();
+				output[n_v2 + n_t3 + i] = data.t3_err[i].imag();
+			}
+		}
 
 		// Advance the pointer
 		n_data_offset += n_data_alloc;
@@ -380,13 +773,13 @@ void COI::GetUncertainties(double * uncertainties, unsigned int size)
 
 void COI::InitBuffers()
 {
+	// Make sure the residuals buffer is large enough
+	mTempFloat.resize(GetDataSize());
+
 	// During the first call there may be some remaining initialization to be done.
 	// Lets make sure they are ready to go:
-	if(!mLibOIInitialized)
+	if(!mLibOIInitialized && mLibOI != NULL)
 	{
-		// Make sure the residuals buffer is large enough
-		mTempFloat = new float[mLibOI->GetNDataAllocated()];
-
 		// Get image properties
 		unsigned int width = mWorkerThread->GetImageWidth();
 		unsigned int height = mWorkerThread->GetImageHeight();
@@ -400,7 +793,7 @@ void COI::InitBuffers()
 			mLibOI->SetImageSource(mFBO_storage->handle(), LibOIEnums::OPENGL_TEXTUREBUFFER);
 		else
 		{
-			mHostImage = new float[width * height];
+			InitReadback();
 			mLibOI->SetImageSource(mHostImage);
 		}
 
@@ -422,9 +815,21 @@ void COI::InitGL()
 	mFBO_storage = mWorkerThread->CreateStorageBuffer();
 }
 
+/// Initializes liboi unless the CPU engine is selected, in which case liboi
+/// (and OpenCL) are only initialized if data requiring them is opened.
 void COI::InitCL()
 {
-	// Initialize liboi using the worker thread's OpenCL+OpenGL context
+	if(mEngine == ENGINE_OPENCL)
+		InitLibOI();
+}
+
+/// Initializes liboi using the worker thread's OpenCL+OpenGL context, if this
+/// has not been done already.
+void COI::InitLibOI()
+{
+	if(mLibOI != NULL)
+		return;
+
 	COpenCLPtr OCL = mWorkerThread->GetOpenCL();
 	mLibOI = new CLibOI(OCL);
 	// detect if we have an integrated GPU
@@ -434,27 +839,358 @@ void COI::InitCL()
 		cout << "Warning: Your device does not support OpenCL-OpenGL interoperability, this will result in a significant performance degredation.";
 }
 
+/// Allocates the host image and the pixel buffer objects used to read images
+/// back from OpenGL, if this has not been done already.
+void COI::InitReadback()
+{
+	if(mHostImage != NULL)
+		return;
+
+	unsigned int width = mWorkerThread->GetImageWidth();
+	unsigned int height = mWorkerThread->GetImageHeight();
+
+	mHostImage = new float[width * height];
+
+	mPixelBuffers.resize(N_PIXEL_BUFFERS);
+	glGenBuffers(mPixelBuffers.size(), &mPixelBuffers[0]);
+	for(auto buffer: mPixelBuffers)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(GLfloat), NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	mNextPixelBuffer = 0;
+
+	CHECK_OPENGL_STATUS_ERROR(glGetError(), "Failed to create the pixel buffer objects");
+}
+
+/// Returns true if chi for the data set can be computed on the host, that is
+/// if it only contains V2 and T3 data. Loads the data if necessary.
+bool COI::HasHostChi(unsigned int data_set, unsigned int size)
+{
+	LoadAnalyticData(data_set);
+	const COIAnalyticData & data = mAnalyticData[data_set];
+
+	return data.v2.size() + 2 * data.t3.size() == size;
+}
+
+/// Extracts the V2 and T3 data, their (u,v) points, dates and wavelengths
+/// from OIFITS data using ccoifits' tools. The T3 (u,v) points are stored as
+/// three consecutive points for each triple.
+void COI::ExtractHostData(const OIDataList & data, COIAnalyticData & output)
+{
+	auto v2 = ExportV2(data);
+	auto v2_err = ExportV2Err(data);
+	auto v2_uv = ExportV2UV(data);
+	auto v2_mjd = ExportV2MJD(data);
+	auto v2_wavelength = ExportV2Wavelength(data);
+	auto t3 = ExportT3(data);
+	auto t3_err = ExportT3Err(data);
+	auto t3_uv = ExportT3UV(data);
+	auto t3_mjd = ExportT3MJD(data);
+	auto t3_wavelength = ExportT3Wavelength(data);
+
+	output.v2.assign(begin(v2), end(v2));
+	output.v2_err.assign(begin(v2_err), end(v2_err));
+	output.t3.assign(begin(t3), end(t3));
+	output.t3_err.assign(begin(t3_err), end(t3_err));
+
+	output.uv.assign(begin(v2_uv), end(v2_uv));
+	output.uv.insert(output.uv.end(), begin(t3_uv), end(t3_uv));
+
+	// OIFITS stores modified Julian dates.
+	output.jd.clear();
+	for(auto mjd: v2_mjd)
+		output.jd.push_back(mjd + 2400000.5);
+	for(auto mjd: t3_mjd)
+		output.jd.push_back(mjd + 2400000.5);
+
+	output.wavelength.assign(begin(v2_wavelength), end(v2_wavelength));
+	output.wavelength.insert(output.wavelength.end(), begin(t3_wavelength), end(t3_wavelength));
+
+	output.loaded = true;
+}
+
+/// Extracts the V2 and T3 data of a data set held by liboi for the host
+/// paths. The data is cached until the data sets change.
+void COI::LoadAnalyticData(unsigned int data_set)
+{
+	COIAnalyticData & output = mAnalyticData[data_set];
+	if(output.loaded)
+		return;
+
+	ExtractHostData(mLibOI->GetData(output.liboi_index), output);
+}
+
 CDataInfo COI::OpenData(string filename)
 {
-	mFilename = filename;
-	mFilenameShort = StripPath(filename);
+	return OpenData(ParseData(filename));
+}
+
+/// Uploads OIFITS data read by ParseData to liboi. With the CPU engine, V2 and
+/// T3 data is kept on the host instead, as is data restored by ReadSnapshot.
+/// Must be called on the worker thread.
+CDataInfo COI::OpenData(CTaskDataPtr data)
+{
+	COIDataPtr oi_data = dynamic_pointer_cast<COIData>(data);
+	if(!oi_data)
+		throw runtime_error("COI::OpenData was passed data from a different task.");
+
+	mFilename = oi_data->filename;
+	mFilenameShort = StripPath(mFilename);
 //	mFilenameNoExtension = StripExtension(mFilenameShort, mExtensions);
 
-	unsigned int data_id = mLibOI->LoadData(filename);
-	mNV2 = mLibOI->GetNV2(data_id);
-	mNT3 = mLibOI->GetNT3(data_id);
-	mJDMean = mLibOI->GetDataAveJD(data_id);
-	mWavelengthMean = mLibOI->GetDataAveWavelength(data_id);
+	COIAnalyticData data_set;
+	if(oi_data->host.loaded)
+	{
+		data_set = oi_data->host;
+		mNV2 = data_set.v2.size();
+		mNT3 = data_set.t3.size();
+	}
+	else if(mEngine == ENGINE_CPU && ExportVis(oi_data->data).size() == 0)
+	{
+		ExtractHostData(oi_data->data, data_set);
+		data_set.source = oi_data->data;
+		mNV2 = data_set.v2.size();
+		mNT3 = data_set.t3.size();
+
+		// Average over all of the data points.
+		const unsigned int n_points = data_set.jd.size();
+		for(unsigned int i = 0; i < n_points; i++)
+		{
+			data_set.jd_mean += data_set.jd[i] / n_points;
+			data_set.wavelength_mean += data_set.wavelength[i] / n_points;
+		}
+	}
+	else
+	{
+		InitLibOI();
+		unsigned int data_id = mLibOI->LoadData(oi_data->data);
+		data_set.liboi_index = data_id;
+		data_set.jd_mean = mLibOI->GetDataAveJD(data_id);
+		data_set.wavelength_mean = mLibOI->GetDataAveWavelength(data_id);
+		mNV2 = mLibOI->GetNV2(data_id);
+		mNT3 = mLibOI->GetNT3(data_id);
+	}
+
+	data_set.filename = mFilename;
+	mAnalyticData.push_back(data_set);
+	mEpochs.clear();
+
+	mJDMean = data_set.jd_mean;
+	mWavelengthMean = data_set.wavelength_mean;
 
 	return getDataInfo();
 }
 
+/// Reads an OIFITS file. Does not touch liboi, so it is safe to call from any thread.
+CTaskDataPtr COI::ParseData(string filename)
+{
+	COIDataPtr data = COIDataPtr(new COIData());
+	data->filename = filename;
+
+	// CFITSIO may only be used from several threads at once if it was built
+	// reentrant. Otherwise OIFITS files are read one at a time.
+	static mutex fits_mutex;
+	if(fits_is_reentrant())
+	{
+		data->data = read_oifits(filename);
+	}
+	else
+	{
+		lock_guard<mutex> lock(fits_mutex);
+		data->data = read_oifits(filename);
+	}
+
+	return data;
+}
+
+/// Restores a data set from the columns written by WriteSnapshot. Data sets
+/// which were stored by filename only are re-read from their OIFITS file.
+CTaskDataPtr COI::ReadSnapshot(const CSnapshotRecord & record)
+{
+	if(record.size == 0)
+		return CTaskDataPtr();
+
+	size_t offset = 0;
+	const uint64_t * counts = CSnapshot::Read<uint64_t>(record, offset, 2);
+	const double * metadata = CSnapshot::Read<double>(record, offset, 2);
+
+	// Bound the counts by the record size before computing the column sizes.
+	const uint64_t n_v2 = counts[0];
+	const uint64_t n_t3 = counts[1];
+	if(n_v2 > record.size || n_t3 > record.size)
+		throw runtime_error("The snapshot record for '" + record.filename + "' is truncated.");
+
+	const uint64_t n_uv = n_v2 + 3 * n_t3;
+	const uint64_t n_points = n_v2 + n_t3;
+
+	const double * u = CSnapshot::Read<double>(record, offset, n_uv);
+	const double * v = CSnapshot::Read<double>(record, offset, n_uv);
+	const double * v2 = CSnapshot::Read<double>(record, offset, n_v2);
+	const double * v2_err = CSnapshot::Read<double>(record, offset, n_v2);
+	const double * t3_real = CSnapshot::Read<double>(record, offset, n_t3);
+	const double * t3_imag = CSnapshot::Read<double>(record, offset, n_t3);
+	const double * t3_err_real = CSnapshot::Read<double>(record, offset, n_t3);
+	const double * t3_err_imag = CSnapshot::Read<double>(record, offset, n_t3);
+	const double * jd = CSnapshot::Read<double>(record, offset, n_points);
+	const double * wavelength = CSnapshot::Read<double>(record, offset, n_points);
+
+	COIDataPtr data = COIDataPtr(new COIData());
+	data->filename = record.filename;
+
+	COIAnalyticData & host = data->host;
+	host.filename = record.filename;
+	host.jd_mean = metadata[0];
+	host.wavelength_mean = metadata[1];
+
+	host.uv.resize(n_uv);
+	for(uint64_t i = 0; i < n_uv; i++)
+		host.uv[i] = make_pair(u[i], v[i]);
+
+	host.v2.assign(v2, v2 + n_v2);
+	host.v2_err.assign(v2_err, v2_err + n_v2);
+
+	host.t3.resize(n_t3);
+	host.t3_err.resize(n_t3);
+	for(uint64_t i = 0; i < n_t3; i++)
+	{
+		host.t3[i] = complex<double>(t3_real[i], t3_imag[i]);
+		host.t3_err[i] = complex<double>(t3_err_real[i], t3_err_imag[i]);
+	}
+
+	host.jd.assign(jd, jd + n_points);
+	host.wavelength.assign(wavelength, wavelength + n_points);
+	host.loaded = true;
+
+	return data;
+}
+
+/// Adds the open data sets to the snapshot. The V2 and T3 data are stored as
+/// columns of doubles:
+///	  uint64 n_v2, n_t3
+///	  double jd_mean, wavelength_mean
+///	  double u[n_uv], v[n_uv]		(n_uv = n_v2 + 3 n_t3, see COIAnalyticData)
+///	  double v2[n_v2], v2_err[n_v2]
+///	  double t3_real[n_t3], t3_imag[n_t3], t3_err_real[n_t3], t3_err_imag[n_t3]
+///	  double jd[n_v2 + n_t3], wavelength[n_v2 + n_t3]
+/// Data sets with other kinds of data (e.g. complex visibilities) store only
+/// their filename and are re-read when the snapshot is restored.
+void COI::WriteSnapshot(CSnapshot & snapshot)
+{
+	for(unsigned int data_set = 0; data_set < mAnalyticData.size(); data_set++)
+	{
+		if(!HasHostChi(data_set, GetDataSize(data_set)))
+		{
+			snapshot.AddRecord(mAnalyticData[data_set].filename, "");
+			continue;
+		}
+
+		const COIAnalyticData & data = mAnalyticData[data_set];
+		const uint64_t counts[2] = {data.v2.size(), data.t3.size()};
+		const double metadata[2] = {data.jd_mean, data.wavelength_mean};
+
+		vector<double> u(data.uv.size());
+		vector<double> v(data.uv.size());
+		for(unsigned int i = 0; i < data.uv.size(); i++)
+		{
+			u[i] = data.uv[i].first;
+			v[i] = data.uv[i].second;
+		}
+
+		const unsigned int n_t3 = data.t3.size();
+		vector<double> t3_real(n_t3);
+		vector<double> t3_imag(n_t3);
+		vector<double> t3_err_real(n_t3);
+		vector<double> t3_err_imag(n_t3);
+		for(unsigned int i = 0; i < n_t3; i++)
+		{
+			t3_real[i] = data.t3[i].real();
+			t3_imag[i] = data.t3[i].imag();
+			t3_err_real[i] = data.t3_err[i].real();
+			t3_err_imag[i] = data.t3_err[i].imag();
+		}
+
+		string payload;
+		CSnapshot::Append(payload, counts, 2);
+		CSnapshot::Append(payload, metadata, 2);
+		CSnapshot::Append(payload, u.data(), u.size());
+		CSnapshot::Append(payload, v.data(), v.size());
+		CSnapshot::Append(payload, data.v2.data(), data.v2.size());
+		CSnapshot::Append(payload, data.v2_err.data(), data.v2_err.size());
+		CSnapshot::Append(payload, t3_real.data(), n_t3);
+		CSnapshot::Append(payload, t3_imag.data(), n_t3);
+		CSnapshot::Append(payload, t3_err_real.data(), n_t3);
+		CSnapshot::Append(payload, t3_err_imag.data(), n_t3);
+		CSnapshot::Append(payload, data.jd.data(), data.jd.size());
+		CSnapshot::Append(payload, data.wavelength.data(), data.wavelength.size());
+
+		snapshot.AddRecord(data.filename, payload);
+	}
+}
+
 void COI::RemoveData(unsigned int data_index)
 {
-	if(mLibOI != NULL)
+	if(data_index >= mAnalyticData.size())
+		return;
+
+	const int liboi_index = mAnalyticData[data_index].liboi_index;
+	if(liboi_index >= 0)
+	{
+		mLibOI->RemoveData(liboi_index);
+		for(auto & data: mAnalyticData)
+		{
+			if(data.liboi_index > liboi_index)
+				data.liboi_index--;
+		}
+	}
+
+	mAnalyticData.erase(mAnalyticData.begin() + data_index);
+	mEpochs.clear();
+}
+
+/// Restores the task settings, see the class description.
+void COI::Restore(Json::Value input)
+{
+	string engine = input.get("engine", "opencl").asString();
+	mEngine = (engine == "cpu") ? ENGINE_CPU : ENGINE_OPENCL;
+
+	string transform = input.get("transform", "auto").asString();
+	if(transform == "dft")
+		mTransform = CVisibilityEngine::METHOD_DFT;
+	else if(transform == "nufft")
+		mTransform = CVisibilityEngine::METHOD_NUFFT;
+	else
+		mTransform = CVisibilityEngine::METHOD_AUTO;
+
+	mOversampling = input.get("oversampling", 2.0).asDouble();
+	mKernelWidth = input.get("kernel_width", 6).asUInt();
+	mDFTCacheSize = input.get("dft_cache_size", 512.0).asDouble();
+}
+
+/// Serializes the task settings.
+Json::Value COI::Serialize()
+{
+	Json::Value output;
+	output["engine"] = (mEngine == ENGINE_CPU) ? "cpu" : "opencl";
+
+	switch(mTransform)
 	{
-		mLibOI->RemoveData(data_index);
+	case CVisibilityEngine::METHOD_DFT:
+		output["transform"] = "dft";
+		break;
+	case CVisibilityEngine::METHOD_NUFFT:
+		output["transform"] = "nufft";
+		break;
+	default:
+		output["transform"] = "auto";
+		break;
 	}
+
+	output["oversampling"] = mOversampling;
+	output["kernel_width"] = mKernelWidth;
+	output["dft_cache_size"] = mDFTCacheSize;
+	return output;
 }
 
 double COI::sum(vector<float> & values, unsigned int start, unsigned int end)
@@ -21,12 +21,110 @@
 #define COI_H_
 
 #include "CTask.h"
+#include "CVisibilityEngine.h"
 #include "liboi.hpp"
 
 using namespace liboi;
 
+/// One OIFITS data set, with the data used for computing chi on the host,
+/// either from analytic visibilities or from an image using the CPU
+/// visibility engine.
+///
+/// Data sets read from OIFITS files are uploaded to liboi (`liboi_index`) and
+/// their V2 and T3 data are extracted when first needed (`loaded`). Data sets
+/// opened with the CPU engine, or restored from a snapshot, only exist on the
+/// host (`liboi_index` is -1).
+struct COIAnalyticData
+{
+	bool loaded;
+	int liboi_index;
+	// The original OIFITS data of host data sets, kept for bootstrapping.
+	// Copied from liboi on the first bootstrap for liboi data sets.
+	OIDataList source;
+
+	string filename;
+	double jd_mean;
+	double wavelength_mean;
+
+	vector<double> v2;
+	vector<double> v2_err;
+	vector<complex<double> > t3;
+	vector<complex<double> > t3_err;
+	// Julian date and wavelength (m) of each V2 point followed by each T3.
+	vector<double> jd;
+	vector<double> wavelength;
+
+	// The (u,v) points of the V2 data followed by three points per T3.
+	vector<pair<double,double> > uv;
+	// Model visibilities at the (u,v) points above.
+	vector<complex<double> > vis;
+	// Transforms images to visibilities at the (u,v) points above.
+	CVisibilityEngine engine;
+
+	COIAnalyticData()
+	{
+		loaded = false;
+		liboi_index = -1;
+		jd_mean = 0;
+		wavelength_mean = 0;
+	};
+};
+
+/// An asynchronous readback of a rendered image, see COI::StartImageCopy.
+struct COIImageReadback
+{
+	unsigned int buffer;	///< Index of the pixel buffer object holding the image
+	GLint region[4];		///< Region (x, y, width, height) which was read
+	int data_set;			///< Data set whose chi is computed from the image
+	bool cpu;				///< Compute chi with the CPU visibility engine rather than liboi
+	unsigned int chi_offset;
+	unsigned int chi_size;
+};
+
+/// OIFITS data read by COI::ParseData, waiting to be uploaded to liboi, or
+/// a data set restored by COI::ReadSnapshot (`host.loaded` is set).
+class COIData : public CTaskData
+{
+public:
+	OIDataList data;
+	COIAnalyticData host;
+};
+typedef shared_ptr<COIData> COIDataPtr;
+
+/// \brief Task for interferometric (OIFITS) data.
+///
+/// Images are transformed into visibilities by liboi (OpenCL) unless the
+/// task settings select the CPU engine:
+///		"oi": {"engine": "cpu"}
+/// The CPU engine supports V2 and T3 data, which are read on the host without
+/// initializing liboi or OpenCL. Data sets with complex visibilities are
+/// still handed to liboi. The CPU engine's transform is chosen with
+///		"transform": "auto" | "dft" | "nufft"
+/// where "auto" (the default) picks the cheaper of the direct transform and
+/// the NUFFT for the data's (u,v) coverage. The NUFFT accuracy is set by
+/// "oversampling" (default 2) and "kernel_width" (default 6, grid cells).
+/// The DFT twiddle factors are cached up to "dft_cache_size" (MB, default
+/// 512) in total, and computed for every image otherwise. The budget is split
+/// across the data sets in proportion to their number of (u,v) points.
+///
+/// Snapshots store the V2 and T3 columns of each data set. Restored data sets
+/// are not uploaded to liboi and always use the CPU engine.
 class COI: public CTask
 {
+public:
+	enum Engines
+	{
+		ENGINE_OPENCL,
+		ENGINE_CPU
+	};
+
+protected:
+	Engines mEngine;
+	CVisibilityEngine::Methods mTransform;
+	double mOversampling;
+	unsigned int mKernelWidth;
+	double mDFTCacheSize;
+
 protected:
 	unsigned int mNV2;
 	unsigned int mNT3;
@@ -38,12 +136,19 @@ protected:
 	CLibOI * mLibOI;
 	bool mLibOIInitialized;
 
-	float * mTempFloat;
+	vector<float> mTempFloat;
 
 	bool mInteropEnabled;
 	GLfloat * mHostImage;
 
-	vector<OIDataList> mData;	/// A copy of the original data. Used when bootstrapping
+	// Pixel buffer objects used to read images back asynchronously when
+	// OpenCL-OpenGL interop is not available.
+	static const unsigned int N_PIXEL_BUFFERS = 2;
+	vector<GLuint> mPixelBuffers;
+	unsigned int mNextPixelBuffer;
+
+	vector<COIAnalyticData> mAnalyticData;	/// Data used when the models have analytic visibilities
+	vector<double> mEpochs;	/// Average JD of each data set, cleared when the data changes
 
 public:
 	COI(CWorkerThread * WorkerThread);
@@ -54,22 +159,52 @@ public:
 	static CTaskPtr Create(CWorkerThread * worker);
 	void clearData();
 	void copyImage();
+protected:
+	void FinishImageCopy(const COIImageReadback & readback);
+	void FinishChi(const COIImageReadback & readback);
+	COIImageReadback StartImageCopy();
+public:
 
 	void Export(string folder_name);
 
+protected:
+	bool GetAnalyticChi(unsigned int data_set, float * chis, unsigned int size);
+	void GetHostChi(COIAnalyticData & data, float * chis);
+	void GetImageChi(const COIImageReadback & readback, float * chis);
+	unsigned int GetDataSize(unsigned int data_set);
+	unsigned int GetDataSize();
+	void GetDataSetChi(unsigned int data_set, float * chis, unsigned int size);
+	bool HasHostChi(unsigned int data_set, unsigned int size);
+	static void ExtractHostData(const OIDataList & data, COIAnalyticData & output);
+	void LoadAnalyticData(unsigned int data_set);
+
+public:
 	virtual void GetChi(double * residuals, unsigned int size);
 	virtual CDataInfo getDataInfo();
 	virtual unsigned int GetNData();
 	virtual int GetNDataFiles();
+	virtual bool GetEpochs(CTaskDataPtr data, vector<double> & epochs);
+	virtual bool GetSpatialFrequencies(CTaskDataPtr data, double & min, double & max);
 	virtual void GetUncertainties(double * residuals, unsigned int size);
 
 	void InitBuffers();
 	virtual void InitGL();
 	virtual void InitCL();
+protected:
+	void InitLibOI();
+	void InitReadback();
+public:
 
 	CDataInfo OpenData(string filename);
+	CDataInfo OpenData(CTaskDataPtr data);
+	CTaskDataPtr ParseData(string filename);
+	CTaskDataPtr ReadSnapshot(const CSnapshotRecord & record);
+	void WriteSnapshot(CSnapshot & snapshot);
 
 	void RemoveData(unsigned int data_index);
+	void Restore(Json::Value input);
+
+	Json::Value Serialize();
 
 	double sum(vector<float> & values, unsigned int start, unsigned int end);
 };
@@ -17,10 +17,19 @@
  * Copyright (c) 2013 Brian Kloppenborg
  */
 #include "CPhotometry.h"
-#include "textio.hpp"
 #include "CModelList.h"
+#include "CSnapshot.h"
 #include "minimizers/CBenchmark.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+
 extern string EXE_FOLDER;
 
 CPhotometry::CPhotometry(CWorkerThread * WorkerThread)
@@ -43,8 +52,36 @@ CPhotometry::CPhotometry(CWorkerThread * WorkerThread)
 	mWavelengthMean = 0;
 	mFilename = "NO_FILE.phot";
 	mFilenameShort = "NO_FILE";
+
+	mEvaluationMode = EVALUATE_EXACT;
+	mGridPoints = 32;
+	mBinWidth = 0.1;
+	mTolerance = 1E-3;
+	mMaxRefinements = 6;
+	mInterpolationError = 0;
+	mNRenders = 0;
+	mWarnedInterpolation = false;
 }
 
+/// Model light curve on an adaptive grid, see CPhotometry::SimulateLightCurve.
+/// The grid coordinate, x, is the orbital phase or the time.
+struct CLightCurveGrid
+{
+	CPhotometry::EvaluationModes mode;
+	double wavelength;
+	double period;
+	double t_ref;		///< Time of phase zero (phase mode)
+	vector<double> x;	///< Sorted coordinates of the observations
+	map<double, double> mags;
+
+	/// Returns true if any observation lies in [x0, x1]
+	bool HasData(double x0, double x1)
+	{
+		auto it = lower_bound(x.begin(), x.end(), x0);
+		return (it != x.end() && *it <= x1);
+	}
+};
+
 CPhotometry::~CPhotometry()
 {
 	delete mLibOI;
@@ -71,8 +108,6 @@ void CPhotometry::clearData()
 
 void CPhotometry::Export(string folder_name)
 {
-	InitBuffers();
-
 	ofstream real_data;
 	ofstream sim_data;
 	ofstream summary;
@@ -81,8 +116,12 @@ void CPhotometry::Export(string folder_name)
 	double sim_flux = 1;
 	double sim_mag = 0;
 	double t0_delta_mag = 0;
+	unsigned int index = 0;
 	CModelListPtr model_list = mWorkerThread->GetModelList();
 
+	vector<double> sim_mags;
+	SimulateLightCurve(model_list, sim_mags);
+
 	// Open the statistics file in append mode:
 	summary.open(folder_name + "summary.txt", ios::app | ios_base::in | ios_base::out);
 	summary.precision(8);
@@ -109,29 +148,35 @@ void CPhotometry::Export(string folder_name)
 		// Provide some information about the format
 		sim_data << "# Simulated photometry from SIMTOI" << endl;
 		sim_data << "# The data is normalized to the first data point in the real data." << endl;
+		if(mEvaluationMode != EVALUATE_EXACT)
+			sim_data << "# Interpolated from " << mNRenders << " renders, the estimated interpolation error is "
+				<< mInterpolationError << " mag." << endl;
 		sim_data << "# CSV format: JD, mag " << endl;
 
 		// Iterate over the data points in this data file:
-		for(auto data_point: data_file->data)
+		const double * jd = data_file->jd.data();
+		const double * mag = data_file->mag.data();
+		const double * mag_err = data_file->mag_err.data();
+		for(unsigned int i = 0; i < data_file->GetNData(); i++)
 		{
 			// Write out to the real data file:
-			real_data << data_point->jd << "," << data_point->mag << "," << data_point->mag_err << endl;
+			real_data << jd[i] << "," << mag[i] << "," << mag_err[i] << endl;
 
-			// Simulate the photometry
-			sim_mag = SimulatePhotometry(model_list, data_point);
+			// Simulated photometry
+			sim_mag = sim_mags[index++];
 			// Cache the t = 0 magnitude.
 			if(first_point)
 			{
-				t0_delta_mag = sim_mag - data_point->mag;
+				t0_delta_mag = sim_mag - mag[i];
 				first_point = false;
 			}
 			// Add the zero-point offset:
 			sim_mag -= (t0_delta_mag);
 			// Write out oto the simulated file
-			sim_data << data_point->jd << "," << sim_mag << endl;
+			sim_data << jd[i] << "," << sim_mag << endl;
 
 			// Append the chi (residual / error) for this data point:
-			chi_values.push_back((sim_mag - data_point->mag) / data_point->mag_err);
+			chi_values.push_back((sim_mag - mag[i]) / mag_err[i]);
 		}
 		// Close the file.
 		real_data.close();
@@ -148,7 +193,7 @@ void CPhotometry::Export(string folder_name)
 
 		// Write out the chi2r for this file:
 		summary << mFilenameNoExtension << ".phot," << mDataDescription << "," << chi2r
-				<< "," << data_file->data.size() << endl;
+				<< "," << data_file->GetNData() << endl;
 	}
 
 	// Close the statistics file.
@@ -157,8 +202,6 @@ void CPhotometry::Export(string folder_name)
 
 void CPhotometry::GetChi(double * chi, unsigned int size)
 {
-	InitBuffers();
-
 	// Enable if you want to see frames per second
 	//int total_start = CBenchmark::GetMilliCount();
 
@@ -168,23 +211,28 @@ void CPhotometry::GetChi(double * chi, unsigned int size)
 	unsigned int index = 0;
 	CModelListPtr model_list = mWorkerThread->GetModelList();
 
+	vector<double> sim_mags;
+	SimulateLightCurve(model_list, sim_mags);
+
 	// Iterate through the data, copying the mag_err into the uncertainties buffer
 	for(auto data_file: mData)
 	{
+		const double * mag = data_file->mag.data();
+		const double * mag_err = data_file->mag_err.data();
 
-		for(auto data_point: data_file->data)
+		for(unsigned int i = 0; i < data_file->GetNData(); i++)
 		{
-			sim_mag = SimulatePhotometry(model_list, data_point);
+			sim_mag = sim_mags[index];
 
 			// Cache the t = 0 magnitude.
 			if(index == 0)
-				t0_delta_mag = sim_mag - data_point->mag;
+				t0_delta_mag = sim_mag - mag[i];
 
 			// Add the zero-point offset:
 			sim_mag -= (t0_delta_mag);
 
 			// store the residual calculation
-			chi[index] = (sim_mag - data_point->mag) / data_point->mag_err;
+			chi[index] = (sim_mag - mag[i]) / mag_err[i];
 
 			// increment the index
 			index += 1;
@@ -238,6 +286,17 @@ int CPhotometry::GetNDataFiles()
 	return mData.size();
 }
 
+/// Returns the dates of the observations read by ParseData.
+bool CPhotometry::GetEpochs(CTaskDataPtr data, vector<double> & epochs)
+{
+	CPhotometricDataPtr photometric_data = dynamic_pointer_cast<CPhotometricData>(data);
+	if(!photometric_data)
+		return false;
+
+	epochs = photometric_data->data_file->jd;
+	return epochs.size() > 0;
+}
+
 /// Returns the wavelength, in meters, of the filter. If wavelength is
 /// numeric, it is expected that the units are in meters.
 double CPhotometry::GetWavelength(const string & wavelength_or_band)
@@ -270,34 +329,29 @@ double CPhotometry::GetWavelength(const string & wavelength_or_band)
 
 void CPhotometry::GetUncertainties(double * uncertainties, unsigned int size)
 {
-	InitBuffers();
-
 	unsigned int index = 0;
 
 	// Iterate through the data, copying the mag_err into the uncertainties buffer
 	for(auto data_file: mData)
 	{
-		for(auto data_point: data_file->data)
-		{
-			// be sure not to go out of bounds
-			if(index < size)
-				uncertainties[index] = data_point->mag_err;
-			else
-				break;
-
-			// increment the index
-			index += 1;
-		}
+		unsigned int n_data = min(data_file->GetNData(), size - min(index, size));
+		copy(data_file->mag_err.begin(), data_file->mag_err.begin() + n_data, uncertainties + index);
+		index += n_data;
 	}
 }
 
 
+/// Initializes liboi, which is only needed to sum rendered images. Models
+/// with analytic fluxes thus never initialize liboi or OpenCL.
 void CPhotometry::InitBuffers()
 {
 	// During the first call there may be some remaining initialization to be done.
 	// Lets make sure they are ready to go:
 	if(!mLibOIInitialized)
 	{
+		// Initialize liboi using the worker thread's OpenCL+OpenGL context
+		mLibOI = new CLibOI(mWorkerThread->GetOpenCL());
+
 		// Get image properties
 		unsigned int width = mWorkerThread->GetImageWidth();
 		unsigned int height = mWorkerThread->GetImageHeight();
@@ -325,77 +379,166 @@ void CPhotometry::InitGL()
 	mFBO_storage = mWorkerThread->CreateStorageBuffer();
 }
 
-void CPhotometry::InitCL()
+CDataInfo CPhotometry::OpenData(string filename)
 {
-	// Initialize liboi using the worker thread's OpenCL+OpenGL context
-	mLibOI = new CLibOI(mWorkerThread->GetOpenCL());
+	return OpenData(ParseData(filename));
 }
 
-CDataInfo CPhotometry::OpenData(string filename)
+/// Appends photometric data read by ParseData to this task.
+CDataInfo CPhotometry::OpenData(CTaskDataPtr data)
 {
-	// The photometric data files must conform to a very specific format
-	// foremost they MUST have the same extension as returned from
-	// CPhotometry::GetExtensions()
-	// The file must conform to the following format:
-	//	# comment lines prefixed by #, /, ;, or !
-	//	JD,mag,sig_mag,ANYTHING_ELSE
-
-	string line;
-	double JDStart = std::numeric_limits<double>::max();
-	double JDEnd = 0;
-	double JDMean = 0;
-	double WavelengthMean = 0;
+	CPhotometricDataPtr photometric_data = dynamic_pointer_cast<CPhotometricData>(data);
+	if(!photometric_data)
+		throw runtime_error("CPhotometry::OpenData was passed data from a different task.");
+
+	// The data was imported correctly, push it onto our data list
+	mData.push_back(photometric_data->data_file);
+
+	return getDataInfo(photometric_data->data_file);
+}
+
+/// Reads a photometric data file. Does not modify the task, so it is safe to
+/// call from any thread.
+///
+/// The photometric data files must conform to a very specific format
+/// foremost they MUST have the same extension as returned from
+/// CPhotometry::GetExtensions()
+/// The file must conform to the following format:
+///	# comment lines prefixed by #, /, ;, or !
+///	JD,mag,sig_mag,ANYTHING_ELSE,wavelength_or_band
+///
+/// The file is read into memory in one operation and parsed in a single pass
+/// directly into the data file's columns.
+CTaskDataPtr CPhotometry::ParseData(string filename)
+{
+	ifstream infile(filename.c_str(), ios::in | ios::binary | ios::ate);
+	if(!infile.good())
+		throw runtime_error("Could not read photometric data file " + filename + ".");
+
+	// Read the file into a single null-terminated buffer.
+	string buffer(size_t(infile.tellg()), '\0');
+	infile.seekg(0, ios::beg);
+	infile.read(&buffer[0], buffer.size());
+	infile.close();
 
 	// Create a new data file for storing input data.
 	CPhotometricDataFilePtr data_file = CPhotometricDataFilePtr(new CPhotometricDataFile());
 	data_file->mFilename = filename;
 	data_file->mFilenameShort = StripExtension(StripPath(filename), mExtensions);
 
-	// Get a vector of the non-comment lines in the text file:
-	int lineCount = 0;
-	vector<string> lines = ReadFile(filename, "#/;!", "Could not read photometric data file " + filename + ".");
-	for(unsigned int i = 0; i < lines.size(); i++)
+	// Guess the number of rows from the number of lines in the file.
+	size_t n_lines = std::count(buffer.begin(), buffer.end(), '\n') + 1;
+	data_file->jd.reserve(n_lines);
+	data_file->mag.reserve(n_lines);
+	data_file->mag_err.reserve(n_lines);
+	data_file->wavelength.reserve(n_lines);
+
+	double JDStart = std::numeric_limits<double>::max();
+	double JDEnd = 0;
+	double JDMean = 0;
+	double WavelengthMean = 0;
+
+	// Most files use a single band, so cache the last band-to-wavelength conversion.
+	string last_band;
+	double last_wavelength = -1;
+
+	const char * whitespace = " \t\r";
+	const char * comments = "#/;!";
+	const char * line = buffer.c_str();
+	const char * file_end = line + buffer.size();
+	const char * line_end = NULL;
+	for(; line < file_end; line = line_end + 1)
 	{
-		line = lines[i];
-		line = StripWhitespace(line);
-		vector<string> t_line = SplitString(line, ',');
+		line_end = (const char *) memchr(line, '\n', file_end - line);
+		if(line_end == NULL)
+			line_end = file_end;
+
+		// Skip leading whitespace, blank lines, and comments.
+		while(line < line_end && strchr(whitespace, *line) != NULL)
+			line++;
+		if(line == line_end || strchr(comments, *line) != NULL)
+			continue;
 
-		if(t_line.size() < 3)
+		// Find the start and end of the first five fields.
+		const char * field_start[5];
+		const char * field_end[5];
+		unsigned int n_fields = 0;
+		const char * field = line;
+		while(n_fields < 5 && field <= line_end)
 		{
-			cout << "WARNING: Could not parse '" + line + "' from photometric data file " + filename << endl;
-			continue;
+			const char * next = (const char *) memchr(field, ',', line_end - field);
+			if(next == NULL)
+				next = line_end;
+
+			field_start[n_fields] = field;
+			field_end[n_fields] = next;
+			n_fields++;
+			field = next + 1;
 		}
 
-		// Attempt to cast variables
-		try
+		// Convert the numeric fields. strtod stops at the comma, so no copies are required.
+		double values[3];
+		bool valid = (n_fields == 5);
+		for(unsigned int i = 0; i < 3 && valid; i++)
 		{
-			CPhotometricDataPointPtr t_data = CPhotometricDataPointPtr(new CPhotometricDataPoint());
-			t_data->jd = atof(t_line[0].c_str());
-			t_data->mag = atof(t_line[1].c_str());
-			t_data->mag_err = atof(t_line[2].c_str());
-			t_data->wavelength = GetWavelength(t_line[4]);
-
-			data_file->data.push_back(t_data);
-
-			// find the start, end, and mean Julian dates.
-			if(t_data->jd < JDStart)
-				JDStart = t_data->jd;
-			if(t_data->jd > mJDEnd)
-				JDEnd = t_data->jd;
-
-			JDMean += t_data->jd;
-			WavelengthMean += t_data->wavelength;
-			lineCount++;
+			char * end = NULL;
+			values[i] = strtod(field_start[i], &end);
+			valid = (end != field_start[i] && end <= field_end[i]);
 		}
-		catch(...)
+
+		double wavelength = -1;
+		if(valid)
 		{
-			cout << "WARNING: Could not parse '" + line + "' from photometric data file " + filename << endl;
+			// Trim the wavelength or band
+			const char * start = field_start[4];
+			const char * end = field_end[4];
+			while(start < end && strchr(whitespace, *start) != NULL)
+				start++;
+			while(end > start && strchr(whitespace, *(end - 1)) != NULL)
+				end--;
+
+			if(last_band.size() != size_t(end - start) || last_band.compare(0, end - start, start, end - start) != 0)
+			{
+				last_band.assign(start, end);
+				try
+				{
+					last_wavelength = GetWavelength(last_band);
+				}
+				catch(...)
+				{
+					last_wavelength = -1;
+				}
+			}
+
+			wavelength = last_wavelength;
+			valid = (wavelength > 0);
 		}
+
+		if(!valid)
+		{
+			cout << "WARNING: Could not parse '" + string(line, line_end) + "' from photometric data file " + filename << endl;
+			continue;
+		}
+
+		data_file->jd.push_back(values[0]);
+		data_file->mag.push_back(values[1]);
+		data_file->mag_err.push_back(values[2]);
+		data_file->wavelength.push_back(wavelength);
+
+		// find the start, end, and mean Julian dates.
+		if(values[0] < JDStart)
+			JDStart = values[0];
+		if(values[0] > JDEnd)
+			JDEnd = values[0];
+
+		JDMean += values[0];
+		WavelengthMean += wavelength;
 	}
 
 	// Calculate the mean wavelength
-	JDMean /= lineCount;
-	WavelengthMean /= lineCount;
+	unsigned int n_data = data_file->GetNData();
+	JDMean /= n_data;
+	WavelengthMean /= n_data;
 
 	// Assign some metadata
 	data_file->mJDStart = JDStart;
@@ -403,10 +546,60 @@ CDataInfo CPhotometry::OpenData(string filename)
 	data_file->mJDMean = JDMean;
 	data_file->mWavelengthMean = WavelengthMean;
 
-	// The data was imported correctly, push it onto our data list
-	mData.push_back(data_file);
+	CPhotometricDataPtr data = CPhotometricDataPtr(new CPhotometricData());
+	data->filename = filename;
+	data->data_file = data_file;
+	return data;
+}
+
+/// Restores a photometric data file from the columns written by WriteSnapshot.
+CTaskDataPtr CPhotometry::ReadSnapshot(const CSnapshotRecord & record)
+{
+	size_t offset = 0;
+	uint64_t n_data = *CSnapshot::Read<uint64_t>(record, offset, 1);
+	const double * metadata = CSnapshot::Read<double>(record, offset, 4);
+	const double * jd = CSnapshot::Read<double>(record, offset, n_data);
+	const double * mag = CSnapshot::Read<double>(record, offset, n_data);
+	const double * mag_err = CSnapshot::Read<double>(record, offset, n_data);
+	const double * wavelength = CSnapshot::Read<double>(record, offset, n_data);
+
+	CPhotometricDataFilePtr data_file = CPhotometricDataFilePtr(new CPhotometricDataFile());
+	data_file->mFilename = record.filename;
+	data_file->mFilenameShort = StripExtension(StripPath(record.filename), mExtensions);
+	data_file->mJDStart = metadata[0];
+	data_file->mJDEnd = metadata[1];
+	data_file->mJDMean = metadata[2];
+	data_file->mWavelengthMean = metadata[3];
+	data_file->jd.assign(jd, jd + n_data);
+	data_file->mag.assign(mag, mag + n_data);
+	data_file->mag_err.assign(mag_err, mag_err + n_data);
+	data_file->wavelength.assign(wavelength, wavelength + n_data);
+
+	CPhotometricDataPtr data = CPhotometricDataPtr(new CPhotometricData());
+	data->filename = record.filename;
+	data->data_file = data_file;
+	return data;
+}
 
-	return getDataInfo(data_file);
+/// Stores the parsed photometry in the snapshot as columns of doubles.
+void CPhotometry::WriteSnapshot(CSnapshot & snapshot)
+{
+	for(auto data_file: mData)
+	{
+		uint64_t n_data = data_file->GetNData();
+		double metadata[4] = {data_file->mJDStart, data_file->mJDEnd,
+				data_file->mJDMean, data_file->mWavelengthMean};
+
+		string payload;
+		CSnapshot::Append(payload, &n_data, 1);
+		CSnapshot::Append(payload, metadata, 4);
+		CSnapshot::Append(payload, data_file->jd.data(), n_data);
+		CSnapshot::Append(payload, data_file->mag.data(), n_data);
+		CSnapshot::Append(payload, data_file->mag_err.data(), n_data);
+		CSnapshot::Append(payload, data_file->wavelength.data(), n_data);
+
+		snapshot.AddRecord(data_file->mFilename, payload);
+	}
 }
 
 void CPhotometry::RemoveData(unsigned int data_index)
@@ -415,14 +608,272 @@ void CPhotometry::RemoveData(unsigned int data_index)
 		mData.erase(mData.begin() + data_index);
 }
 
-double CPhotometry::SimulatePhotometry(CModelListPtr model_list, CPhotometricDataPointPtr data_point)
+/// Restores the light curve evaluation settings.
+void CPhotometry::Restore(Json::Value input)
+{
+	string mode = input.get("evaluation", "exact").asString();
+	if(mode == "phase")
+		mEvaluationMode = EVALUATE_PHASE;
+	else if(mode == "time")
+		mEvaluationMode = EVALUATE_TIME;
+	else
+		mEvaluationMode = EVALUATE_EXACT;
+
+	mGridPoints = max(1u, input.get("grid_points", mGridPoints).asUInt());
+	mBinWidth = input.get("bin_width", mBinWidth).asDouble();
+	mTolerance = input.get("tolerance", mTolerance).asDouble();
+	mMaxRefinements = input.get("max_refinements", mMaxRefinements).asUInt();
+	mWarnedInterpolation = false;
+}
+
+/// Serializes the light curve evaluation settings.
+Json::Value CPhotometry::Serialize()
+{
+	const char * modes[] = {"exact", "phase", "time"};
+
+	Json::Value output;
+	output["evaluation"] = modes[mEvaluationMode];
+	output["grid_points"] = mGridPoints;
+	output["bin_width"] = mBinWidth;
+	output["tolerance"] = mTolerance;
+	output["max_refinements"] = mMaxRefinements;
+	return output;
+}
+
+/// Bisects the grid interval [x0, x1] until linear interpolation across it is
+/// better than mTolerance (or mMaxRefinements is reached). Intervals which do not
+/// contain observations are not refined.
+void CPhotometry::RefineLightCurve(CModelListPtr model_list, CLightCurveGrid & grid,
+		double x0, double mag0, double x1, double mag1, unsigned int depth)
+{
+	double x = 0.5 * (x0 + x1);
+	double mag = SimulateGridPoint(model_list, grid, x);
+	double error = fabs(mag - 0.5 * (mag0 + mag1));
+
+	if(error > mTolerance && depth + 1 < mMaxRefinements)
+	{
+		if(grid.HasData(x0, x))
+			RefineLightCurve(model_list, grid, x0, mag0, x, mag, depth + 1);
+		if(grid.HasData(x, x1))
+			RefineLightCurve(model_list, grid, x, mag, x1, mag1, depth + 1);
+	}
+	else
+	{
+		// The interpolation error at the midpoint of the coarser interval.
+		// This overestimates the error of the final grid.
+		mInterpolationError = max(mInterpolationError, error);
+	}
+}
+
+/// Renders the model at grid coordinate x and stores the result in the grid.
+double CPhotometry::SimulateGridPoint(CModelListPtr model_list, CLightCurveGrid & grid, double x)
+{
+	double t = x;
+	if(grid.mode == EVALUATE_PHASE)
+		t = grid.t_ref + x * grid.period;
+
+	double mag = SimulatePhotometry(model_list, t, grid.wavelength);
+	grid.mags[x] = mag;
+	mNRenders++;
+
+	return mag;
+}
+
+/// Computes the model magnitude at every observation (in the order of mData)
+/// using the current evaluation mode.
+void CPhotometry::SimulateLightCurve(CModelListPtr model_list, vector<double> & sim_mag)
+{
+	sim_mag.resize(GetNData());
+	mInterpolationError = 0;
+	mNRenders = 0;
+
+	// Phase folding requires that everything in the scene repeats with the same period.
+	EvaluationModes mode = mEvaluationMode;
+	double period = 0;
+	if(mode == EVALUATE_PHASE)
+	{
+		period = model_list->GetPeriod();
+		if(!(period > 0))
+		{
+			if(!mWarnedInterpolation)
+				cout << "WARNING: The models are not periodic, photometry will be evaluated on a time grid instead." << endl;
+			mWarnedInterpolation = true;
+			mode = EVALUATE_TIME;
+		}
+	}
+
+	if(mode == EVALUATE_EXACT)
+	{
+		// Let time-dependent positions solve for all of the epochs at once.
+		vector<double> epochs;
+		for(auto data_file: mData)
+			epochs.insert(epochs.end(), data_file->jd.begin(), data_file->jd.end());
+		model_list->SetEpochs(epochs);
+
+		// Models whose flux can be integrated directly are evaluated at all
+		// epochs of a wavelength at once. Epochs which cannot be evaluated
+		// analytically (e.g. multiple eclipses) are rendered.
+		unsigned int index = 0;
+		for(auto data_file: mData)
+		{
+			map<double, vector<unsigned int> > wavelengths;
+			for(unsigned int i = 0; i < data_file->GetNData(); i++)
+				wavelengths[data_file->wavelength[i]].push_back(i);
+
+			for(auto & wavelength: wavelengths)
+			{
+				const vector<unsigned int> & points = wavelength.second;
+				vector<double> jds(points.size());
+				for(unsigned int i = 0; i < points.size(); i++)
+					jds[i] = data_file->jd[points[i]];
+
+				vector<double> flux;
+				model_list->SetWavelength(wavelength.first);
+				model_list->GetFlux(jds, flux);
+
+				for(unsigned int i = 0; i < points.size(); i++)
+				{
+					if(std::isnan(flux[i]))
+					{
+						model_list->SetTime(jds[i]);
+						sim_mag[index + points[i]] = RenderPhotometry(model_list);
+					}
+					else
+						sim_mag[index + points[i]] = -2.5 * log10(flux[i]);
+				}
+			}
+
+			index += data_file->GetNData();
+		}
+
+		mNRenders = index;
+		return;
+	}
+
+	// Light curves at different wavelengths are evaluated separately. Find the
+	// observations at each wavelength and their grid coordinates.
+	map<double, vector<unsigned int> > indices;
+	vector<double> coordinates(sim_mag.size());
+	double t_ref = 0;
+	unsigned int index = 0;
+	for(auto data_file: mData)
+	{
+		for(unsigned int i = 0; i < data_file->GetNData(); i++)
+		{
+			double t = data_file->jd[i];
+			if(index == 0 && mode == EVALUATE_PHASE)
+				t_ref = period * floor(t / period);
+
+			coordinates[index] = t;
+			if(mode == EVALUATE_PHASE)
+				coordinates[index] = (t - t_ref) / period - floor((t - t_ref) / period);
+
+			indices[data_file->wavelength[i]].push_back(index);
+			index++;
+		}
+	}
+
+	for(auto it: indices)
+	{
+		CLightCurveGrid grid;
+		grid.mode = mode;
+		grid.wavelength = it.first;
+		grid.period = period;
+		grid.t_ref = t_ref;
+		for(auto i: it.second)
+			grid.x.push_back(coordinates[i]);
+		sort(grid.x.begin(), grid.x.end());
+
+		// Build the initial grid. In phase mode this covers one period, in
+		// time mode only the bins which contain data.
+		set<double> nodes;
+		if(mode == EVALUATE_PHASE)
+		{
+			for(unsigned int k = 0; k < mGridPoints; k++)
+				nodes.insert(double(k) / mGridPoints);
+		}
+		else
+		{
+			double x_min = grid.x.front();
+			double width = (mBinWidth > 0) ? mBinWidth : max(grid.x.back() - x_min, 1.0);
+			for(auto x: grid.x)
+			{
+				double bin = floor((x - x_min) / width);
+				nodes.insert(x_min + bin * width);
+				nodes.insert(x_min + (bin + 1) * width);
+			}
+		}
+
+		for(auto x: nodes)
+			SimulateGridPoint(model_list, grid, x);
+
+		// The light curve is periodic, phase one is phase zero.
+		if(mode == EVALUATE_PHASE)
+			grid.mags[1.0] = grid.mags[0.0];
+
+		// Refine every interval of the initial grid which contains observations.
+		vector<pair<double, double> > intervals(grid.mags.begin(), grid.mags.end());
+		for(unsigned int k = 0; k + 1 < intervals.size(); k++)
+		{
+			if(grid.HasData(intervals[k].first, intervals[k + 1].first))
+				RefineLightCurve(model_list, grid, intervals[k].first, intervals[k].second,
+						intervals[k + 1].first, intervals[k + 1].second, 0);
+		}
+
+		// Interpolate to the observations.
+		for(auto i: it.second)
+		{
+			double x = coordinates[i];
+			auto upper = grid.mags.lower_bound(x);
+			if(upper == grid.mags.end())
+				upper--;
+
+			if(upper == grid.mags.begin() || upper->first == x)
+			{
+				sim_mag[i] = upper->second;
+				continue;
+			}
+
+			auto lower = upper;
+			lower--;
+			double w = (x - lower->first) / (upper->first - lower->first);
+			sim_mag[i] = (1 - w) * lower->second + w * upper->second;
+		}
+	}
+
+	// Report the interpolation error so that the grid density can be adjusted.
+	if(mInterpolationError > mTolerance && !mWarnedInterpolation)
+	{
+		cout << "WARNING: The estimated photometric interpolation error (" << mInterpolationError
+			 << " mag) exceeds the tolerance (" << mTolerance << " mag) after " << mMaxRefinements
+			 << " refinements. Increase grid_points or max_refinements." << endl;
+		mWarnedInterpolation = true;
+	}
+}
+
+double CPhotometry::SimulatePhotometry(CModelListPtr model_list, double jd, double wavelength)
+{
+	// Set the time, render the model
+	model_list->SetTime(jd);
+	model_list->SetWavelength(wavelength);
+
+	// Models whose flux can be integrated directly need not be rendered.
+	double flux = 0;
+	if(model_list->GetAnalyticFlux(flux))
+		return -2.5 * log10(flux);
+
+	return RenderPhotometry(model_list);
+}
+
+/// Renders the models at the current time and wavelength and returns their
+/// magnitude.
+double CPhotometry::RenderPhotometry(CModelListPtr model_list)
 {
 	double sim_flux = 0;
 	double max_flux = 0;
 
-	// Set the time, render the model
-	model_list->SetTime(data_point->jd);
-	model_list->SetWavelength(data_point->wavelength);
+	InitBuffers();
+
 	mFBO_render->bind();
 	max_flux = model_list->Render(mWorkerThread->GetView());
 	mFBO_render->release();
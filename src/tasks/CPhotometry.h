@@ -28,16 +28,7 @@
 using namespace std;
 using namespace liboi;
 
-class CPhotometricDataPoint
-{
-public:
-	double jd;
-	double mag;
-	double mag_err;
-	double wavelength;
-};
-typedef shared_ptr<CPhotometricDataPoint> CPhotometricDataPointPtr;
-
+/// A photometric data file. The data points are stored as contiguous columns.
 class CPhotometricDataFile
 {
 public:
@@ -49,17 +40,58 @@ public:
 	string mFilename;		///< The full filename including path and extension
 	string mFilenameShort;	///< The filename less the path and extension.
 
-	vector<CPhotometricDataPointPtr> data;
+	vector<double> jd;
+	vector<double> mag;
+	vector<double> mag_err;
+	vector<double> wavelength;
 
-	unsigned int GetNData() { return data.size(); };
+	unsigned int GetNData() { return jd.size(); };
 };
 typedef shared_ptr<CPhotometricDataFile> CPhotometricDataFilePtr;
 
+/// Photometric data read by CPhotometry::ParseData.
+class CPhotometricData : public CTaskData
+{
+public:
+	CPhotometricDataFilePtr data_file;
+};
+typedef shared_ptr<CPhotometricData> CPhotometricDataPtr;
+
+struct CLightCurveGrid;
+
+/// \brief Photometric (light curve) data.
+///
+/// By default the model is rendered at every observed epoch. Dense light curves
+/// may instead be evaluated on an adaptive grid in orbital phase (for periodic
+/// scenes) or time. The grid is bisected wherever linear interpolation is worse
+/// than `tolerance`, which concentrates renders near eclipses, and the model
+/// magnitudes are interpolated to the observed epochs. The settings are stored
+/// in the "tasks/photometry" section of the save file:
+///
+///   "photometry" : { "evaluation" : "phase", "grid_points" : 32, "bin_width" : 0.1,
+///                    "tolerance" : 0.001, "max_refinements" : 6 }
 class CPhotometry: public CTask
 {
+public:
+	enum EvaluationModes
+	{
+		EVALUATE_EXACT,	///< Render at every observed epoch
+		EVALUATE_PHASE,	///< Interpolate from an adaptive grid in orbital phase
+		EVALUATE_TIME	///< Interpolate from an adaptive grid in time
+	};
+
 protected:
 	string mFilenameNoExtension;
 
+	EvaluationModes mEvaluationMode;
+	unsigned int mGridPoints;		///< Initial number of grid intervals per period (phase mode)
+	double mBinWidth;				///< Initial grid spacing in days (time mode)
+	double mTolerance;				///< Target interpolation error (mag)
+	unsigned int mMaxRefinements;	///< Maximum number of times an initial grid interval is bisected
+	double mInterpolationError;		///< Largest interpolation error estimated in the last evaluation
+	unsigned int mNRenders;			///< Number of renders in the last evaluation
+	bool mWarnedInterpolation;
+
 protected:
 	QGLFramebufferObject * mFBO_render;
 	QGLFramebufferObject * mFBO_storage;
@@ -85,18 +117,31 @@ public:
 	CDataInfo getDataInfo(CPhotometricDataFilePtr data_file);
 	virtual unsigned int GetNData();
 	virtual int GetNDataFiles();
+	virtual bool GetEpochs(CTaskDataPtr data, vector<double> & epochs);
 	virtual void GetUncertainties(double * residuals, unsigned int size);
 	double GetWavelength(const string & wavelength_or_band);
 
 	void InitBuffers();
 	virtual void InitGL();
-	virtual void InitCL();
 
 	CDataInfo OpenData(string filename);
+	CDataInfo OpenData(CTaskDataPtr data);
+	CTaskDataPtr ParseData(string filename);
+	CTaskDataPtr ReadSnapshot(const CSnapshotRecord & record);
+	void WriteSnapshot(CSnapshot & snapshot);
 
 	void RemoveData(unsigned int data_index);
+	void Restore(Json::Value input);
+	Json::Value Serialize();
+
+	double SimulatePhotometry(CModelListPtr model_list, double jd, double wavelength);
 
-	double SimulatePhotometry(CModelListPtr model_list, CPhotometricDataPointPtr data_point);
+protected:
+	void RefineLightCurve(CModelListPtr model_list, CLightCurveGrid & grid,
+			double x0, double mag0, double x1, double mag1, unsigned int depth);
+	double RenderPhotometry(CModelListPtr model_list);
+	double SimulateGridPoint(CModelListPtr model_list, CLightCurveGrid & grid, double x);
+	void SimulateLightCurve(CModelListPtr model_list, vector<double> & sim_mag);
 };
 
 #endif /* CPHOTOMETRY_H_ */
@@ -0,0 +1,579 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#include "CVisibilityEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <QtConcurrentMap>
+
+// Conversion from milliarcseconds to radians
+static const double MAS_TO_RAD = M_PI / (180.0 * 3600.0 * 1000.0);
+
+/// Returns the smallest power of two which is >= n.
+static unsigned int NextPowerOfTwo(double n)
+{
+	unsigned int size = 1;
+	while(size < n)
+		size <<= 1;
+
+	return size;
+}
+
+CVisibilityEngine::CVisibilityEngine()
+{
+	mWidth = 0;
+	mHeight = 0;
+	mScale = 0;
+
+	mMethod = METHOD_AUTO;
+	mOversampling = 2;
+	mKernelWidth = 6;
+	mUseNUFFT = false;
+
+	mCacheLimit = size_t(512) * 1024 * 1024;
+	mCacheDFT = true;
+
+	mGridWidth = 0;
+	mGridHeight = 0;
+}
+
+CVisibilityEngine::~CVisibilityEngine()
+{
+
+}
+
+/// In-place, radix-2, forward FFT of n (a power of two) values,
+///		X_k = \sum_j x_j exp(-2 pi i j k / n).
+/// `twiddle` holds exp(-2 pi i k / n) for k < n/2.
+void CVisibilityEngine::FFT(complex<double> * data, unsigned int n, const vector<complex<double> > & twiddle)
+{
+	// Bit-reversal permutation
+	for(unsigned int i = 1, j = 0; i < n; i++)
+	{
+		unsigned int bit = n >> 1;
+		for(; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+
+		if(i < j)
+			swap(data[i], data[j]);
+	}
+
+	for(unsigned int length = 2; length <= n; length <<= 1)
+	{
+		const unsigned int half = length / 2;
+		const unsigned int step = n / length;
+		for(unsigned int i = 0; i < n; i += length)
+		{
+			for(unsigned int k = 0; k < half; k++)
+			{
+				const complex<double> a = data[i + k];
+				const complex<double> b = data[i + k + half] * twiddle[k * step];
+				data[i + k] = a + b;
+				data[i + k + half] = a - b;
+			}
+		}
+	}
+}
+
+/// Computes the visibilities of the image at the (u,v) points given to
+/// SetGeometry, normalized by the total flux of the image.
+///
+/// Only the pixels within `region` (x, y, width, height) are summed, pixels
+/// outside of it must be zero. Within the region, leading and trailing zero
+/// pixels of each row are skipped.
+void CVisibilityEngine::GetVisibilities(const float * image, const int region[4],
+		vector<complex<double> > & vis)
+{
+	// (u,v) points per work item
+	const unsigned int chunk_size = 64;
+
+	const unsigned int n_uv = mUV.size();
+	vis.assign(n_uv, complex<double>(0, 0));
+
+	// Find the span of non-zero pixels in each row and the total flux, for
+	// normalization.
+	mSpans.clear();
+	double flux = 0;
+	for(int row = region[1]; row < region[1] + region[3]; row++)
+	{
+		const float * pixels = image + size_t(row) * mWidth;
+		CVisibilitySpan span = {row, region[0], region[0] + region[2]};
+		while(span.start < span.end && pixels[span.start] == 0)
+			span.start++;
+		while(span.end > span.start && pixels[span.end - 1] == 0)
+			span.end--;
+
+		if(span.start == span.end)
+			continue;
+
+		float row_flux = 0;
+		for(int i = span.start; i < span.end; i++)
+			row_flux += pixels[i];
+
+		flux += row_flux;
+		mSpans.push_back(span);
+	}
+
+	if(flux == 0)
+		return;
+
+	if(mUseNUFFT)
+		TransformNUFFT(image, vis);
+	else
+	{
+		vector<pair<unsigned int, unsigned int> > chunks;
+		for(unsigned int start = 0; start < n_uv; start += chunk_size)
+			chunks.push_back(make_pair(start, min(start + chunk_size, n_uv)));
+
+		QtConcurrent::blockingMap(chunks, [this, image, &vis](pair<unsigned int, unsigned int> & chunk)
+		{
+			TransformDFT(image, chunk.first, chunk.second, vis);
+		});
+	}
+
+	for(auto & value: vis)
+		value /= flux;
+}
+
+/// The Kaiser-Bessel kernel, I_0(beta sqrt(1 - (2x / width)^2)), of the
+/// given width (grid cells). Zero outside of |x| <= width / 2.
+double CVisibilityEngine::KaiserBessel(double x, double width, double beta)
+{
+	const double t = 2 * x / width;
+	if(fabs(t) > 1)
+		return 0;
+
+	// Power series of the modified Bessel function I_0
+	const double y = 0.25 * beta * beta * (1 - t * t);
+	double term = 1;
+	double sum = 1;
+	for(unsigned int k = 1; k < 100 && term > 1E-17 * sum; k++)
+	{
+		term *= y / (double(k) * k);
+		sum += term;
+	}
+
+	return sum;
+}
+
+/// The Fourier transform of `KaiserBessel` at frequency f (cycles per grid cell).
+double CVisibilityEngine::KaiserBesselTransform(double f, double width, double beta)
+{
+	const double a = M_PI * width * f;
+	const double b2 = beta * beta - a * a;
+
+	if(b2 > 1E-12)
+		return width * sinh(sqrt(b2)) / sqrt(b2);
+	if(b2 < -1E-12)
+		return width * sin(sqrt(-b2)) / sqrt(-b2);
+
+	return width;
+}
+
+/// Sets the (u,v) points (in units of wavelengths) and the image geometry.
+/// The transform tables are only recomputed if these changed.
+void CVisibilityEngine::SetGeometry(const vector<pair<double,double> > & uv, unsigned int width,
+		unsigned int height, double scale)
+{
+	if(uv == mUV && width == mWidth && height == mHeight && scale == mScale)
+		return;
+
+	mUV = uv;
+	mWidth = width;
+	mHeight = height;
+	mScale = scale;
+
+	Setup();
+}
+
+/// Sets the largest size (bytes) of the cached DFT twiddle factors. Larger
+/// tables are computed for every image instead.
+void CVisibilityEngine::SetCacheLimit(size_t bytes)
+{
+	if(bytes == mCacheLimit)
+		return;
+
+	mCacheLimit = bytes;
+
+	if(mWidth > 0 && mHeight > 0 && !mUseNUFFT)
+		SetupDFT();
+}
+
+/// Selects the transform. With METHOD_AUTO the cheaper transform is used.
+/// The NUFFT grid is at least `oversampling` times the image size and the
+/// kernel spans `kernel_width` grid cells.
+void CVisibilityEngine::SetMethod(Methods method, double oversampling, unsigned int kernel_width)
+{
+	oversampling = max(oversampling, 1.25);
+	kernel_width = max(kernel_width, 2u);
+
+	if(method == mMethod && oversampling == mOversampling && kernel_width == mKernelWidth)
+		return;
+
+	mMethod = method;
+	mOversampling = oversampling;
+	mKernelWidth = kernel_width;
+
+	if(mWidth > 0 && mHeight > 0)
+		Setup();
+}
+
+/// Chooses the transform for the current geometry and computes its tables.
+///
+/// The costs are rough operation counts: the (vectorized) direct transform
+/// needs W * H multiply-adds per (u,v) point, the NUFFT needs the FFTs of the
+/// occupied rows and of every grid column plus (w + 1)^2 taps per point.
+void CVisibilityEngine::Setup()
+{
+	const double n_uv = mUV.size();
+	const double grid_width = NextPowerOfTwo(mOversampling * mWidth);
+	const double grid_height = NextPowerOfTwo(mOversampling * mHeight);
+	const double taps = mKernelWidth + 1;
+
+	const double dft_cost = 0.25 * n_uv * mWidth * mHeight;
+	const double nufft_cost = 5 * (mHeight * grid_width * log2(grid_width) + grid_width * grid_height * log2(grid_height))
+			+ 2 * n_uv * taps * taps;
+
+	mUseNUFFT = (mMethod == METHOD_NUFFT) || (mMethod == METHOD_AUTO && nufft_cost < dft_cost);
+
+	// Only keep the tables of the transform in use.
+	if(mUseNUFFT)
+	{
+		vector<float>().swap(mCosX);
+		vector<float>().swap(mSinX);
+		vector<double>().swap(mCosY);
+		vector<double>().swap(mSinY);
+		SetupNUFFT();
+	}
+	else
+	{
+		vector<double>().swap(mTapsX);
+		vector<double>().swap(mTapsY);
+		vector<complex<double> >().swap(mGrid);
+		SetupDFT();
+	}
+}
+
+/// Computes the twiddle factors of the direct transform for (u,v) point k,
+/// exp(-2 pi i u x) for every column and exp(-2 pi i v y) for every row.
+void CVisibilityEngine::DFTTwiddles(unsigned int k, float * cos_x, float * sin_x, double * cos_y, double * sin_y)
+{
+	const double u = -2 * M_PI * mUV[k].first * mScale * MAS_TO_RAD;
+	const double v = -2 * M_PI * mUV[k].second * mScale * MAS_TO_RAD;
+
+	for(unsigned int i = 0; i < mWidth; i++)
+	{
+		const double phase = u * (i + 0.5 - 0.5 * mWidth);
+		cos_x[i] = cos(phase);
+		sin_x[i] = sin(phase);
+	}
+
+	for(unsigned int j = 0; j < mHeight; j++)
+	{
+		const double phase = v * (j + 0.5 - 0.5 * mHeight);
+		cos_y[j] = cos(phase);
+		sin_y[j] = sin(phase);
+	}
+}
+
+/// Computes the twiddle factors of the direct transform, unless they would
+/// exceed the cache limit.
+void CVisibilityEngine::SetupDFT()
+{
+	const unsigned int n_uv = mUV.size();
+	const size_t size = size_t(n_uv) * (mWidth * 2 * sizeof(float) + mHeight * 2 * sizeof(double));
+	mCacheDFT = (size <= mCacheLimit);
+
+	if(!mCacheDFT)
+	{
+		vector<float>().swap(mCosX);
+		vector<float>().swap(mSinX);
+		vector<double>().swap(mCosY);
+		vector<double>().swap(mSinY);
+		return;
+	}
+
+	mCosX.resize(size_t(n_uv) * mWidth);
+	mSinX.resize(size_t(n_uv) * mWidth);
+	mCosY.resize(size_t(n_uv) * mHeight);
+	mSinY.resize(size_t(n_uv) * mHeight);
+
+	for(unsigned int k = 0; k < n_uv; k++)
+		DFTTwiddles(k, &mCosX[size_t(k) * mWidth], &mSinX[size_t(k) * mWidth],
+				&mCosY[size_t(k) * mHeight], &mSinY[size_t(k) * mHeight]);
+}
+
+/// Computes the deconvolution factors, kernel taps, and FFT twiddle factors
+/// of the NUFFT.
+///
+/// Image column i is placed at grid position t = i - floor(W/2) (modulo the
+/// grid size), i.e. half a pixel from its true position when W is even. The
+/// difference is restored by the phase in mShift. The kernel shape parameter
+/// follows Beatty et al. (2005), IEEE Trans. Med. Imaging 24, 799.
+void CVisibilityEngine::SetupNUFFT()
+{
+	const unsigned int n_uv = mUV.size();
+	const unsigned int taps = mKernelWidth + 1;
+	const double width = mKernelWidth;
+
+	mGridWidth = NextPowerOfTwo(mOversampling * mWidth);
+	mGridHeight = NextPowerOfTwo(mOversampling * mHeight);
+
+	auto beta = [width](double oversampling)
+	{
+		const double t = width / oversampling * (oversampling - 0.5);
+		return M_PI * sqrt(max(t * t - 0.8, 0.0));
+	};
+	const double beta_x = beta(double(mGridWidth) / mWidth);
+	const double beta_y = beta(double(mGridHeight) / mHeight);
+
+	// Deconvolution factors
+	mCorrectionX.resize(mWidth);
+	for(unsigned int i = 0; i < mWidth; i++)
+	{
+		const double t = int(i) - int(mWidth / 2);
+		mCorrectionX[i] = 1 / KaiserBesselTransform(t / mGridWidth, width, beta_x);
+	}
+
+	mCorrectionY.resize(mHeight);
+	for(unsigned int j = 0; j < mHeight; j++)
+	{
+		const double t = int(j) - int(mHeight / 2);
+		mCorrectionY[j] = 1 / KaiserBesselTransform(t / mGridHeight, width, beta_y);
+	}
+
+	// FFT twiddle factors
+	mFFTTwiddleX.resize(mGridWidth / 2);
+	for(unsigned int k = 0; k < mGridWidth / 2; k++)
+		mFFTTwiddleX[k] = polar(1.0, -2 * M_PI * k / mGridWidth);
+
+	mFFTTwiddleY.resize(mGridHeight / 2);
+	for(unsigned int k = 0; k < mGridHeight / 2; k++)
+		mFFTTwiddleY[k] = polar(1.0, -2 * M_PI * k / mGridHeight);
+
+	// Kernel taps around each (u,v) point on the grid.
+	const double delta_x = int(mWidth / 2) - 0.5 * mWidth + 0.5;
+	const double delta_y = int(mHeight / 2) - 0.5 * mHeight + 0.5;
+
+	mTapStartX.resize(n_uv);
+	mTapStartY.resize(n_uv);
+	mTapsX.resize(size_t(n_uv) * taps);
+	mTapsY.resize(size_t(n_uv) * taps);
+	mShift.resize(n_uv);
+	for(unsigned int k = 0; k < n_uv; k++)
+	{
+		// Spatial frequency in cycles per pixel and its position on the grid
+		const double xi = mUV[k].first * mScale * MAS_TO_RAD;
+		const double eta = mUV[k].second * mScale * MAS_TO_RAD;
+		const double x = xi * mGridWidth;
+		const double y = eta * mGridHeight;
+
+		mTapStartX[k] = int(ceil(x - 0.5 * width));
+		mTapStartY[k] = int(ceil(y - 0.5 * width));
+		for(unsigned int tap = 0; tap < taps; tap++)
+		{
+			mTapsX[size_t(k) * taps + tap] = KaiserBessel(x - (mTapStartX[k] + int(tap)), width, beta_x);
+			mTapsY[size_t(k) * taps + tap] = KaiserBessel(y - (mTapStartY[k] + int(tap)), width, beta_y);
+		}
+
+		mShift[k] = polar(1.0, -2 * M_PI * (xi * delta_x + eta * delta_y));
+	}
+}
+
+/// Computes the (un-normalized) visibilities of (u,v) points [start, end)
+/// with the direct transform.
+///
+/// The transform is a pair of matrix products: the image rows are multiplied
+/// by the column twiddles, then the row sums by the row twiddles. The (u,v)
+/// points are processed in small blocks so each image row is loaded once per
+/// block. For each row and (u,v) point the product is a pair of dot products
+/// over contiguous floats, which use independent partial sums so the compiler
+/// can vectorize them without reordering floating point operations.
+void CVisibilityEngine::TransformDFT(const float * image, unsigned int start, unsigned int end,
+		vector<complex<double> > & vis)
+{
+	const int n_lanes = 8;
+	const unsigned int block_size = 4;
+
+	// Twiddle factors of one block, if they are not cached
+	vector<float> block_cos_x;
+	vector<float> block_sin_x;
+	vector<double> block_cos_y;
+	vector<double> block_sin_y;
+	if(!mCacheDFT)
+	{
+		block_cos_x.resize(block_size * mWidth);
+		block_sin_x.resize(block_size * mWidth);
+		block_cos_y.resize(block_size * mHeight);
+		block_sin_y.resize(block_size * mHeight);
+	}
+
+	for(unsigned int block = start; block < end; block += block_size)
+	{
+		const unsigned int n = min(block_size, end - block);
+
+		const float * cos_x[block_size];
+		const float * sin_x[block_size];
+		const double * cos_y[block_size];
+		const double * sin_y[block_size];
+		for(unsigned int b = 0; b < n; b++)
+		{
+			const unsigned int k = block + b;
+			if(mCacheDFT)
+			{
+				cos_x[b] = &mCosX[size_t(k) * mWidth];
+				sin_x[b] = &mSinX[size_t(k) * mWidth];
+				cos_y[b] = &mCosY[size_t(k) * mHeight];
+				sin_y[b] = &mSinY[size_t(k) * mHeight];
+			}
+			else
+			{
+				DFTTwiddles(k, &block_cos_x[b * mWidth], &block_sin_x[b * mWidth],
+						&block_cos_y[b * mHeight], &block_sin_y[b * mHeight]);
+				cos_x[b] = &block_cos_x[b * mWidth];
+				sin_x[b] = &block_sin_x[b * mWidth];
+				cos_y[b] = &block_cos_y[b * mHeight];
+				sin_y[b] = &block_sin_y[b * mHeight];
+			}
+		}
+
+		double real[block_size] = {0};
+		double imag[block_size] = {0};
+		for(const auto & span: mSpans)
+		{
+			const float * pixels = image + size_t(span.row) * mWidth;
+			const int n_vector = span.end - (span.end - span.start) % n_lanes;
+
+			for(unsigned int b = 0; b < n; b++)
+			{
+				float lane_real[n_lanes] = {0};
+				float lane_imag[n_lanes] = {0};
+				for(int i = span.start; i < n_vector; i += n_lanes)
+				{
+					for(int l = 0; l < n_lanes; l++)
+					{
+						lane_real[l] += pixels[i + l] * cos_x[b][i + l];
+						lane_imag[l] += pixels[i + l] * sin_x[b][i + l];
+					}
+				}
+
+				for(int i = n_vector; i < span.end; i++)
+				{
+					lane_real[0] += pixels[i] * cos_x[b][i];
+					lane_imag[0] += pixels[i] * sin_x[b][i];
+				}
+
+				double row_real = 0;
+				double row_imag = 0;
+				for(int l = 0; l < n_lanes; l++)
+				{
+					row_real += lane_real[l];
+					row_imag += lane_imag[l];
+				}
+
+				real[b] += row_real * cos_y[b][span.row] - row_imag * sin_y[b][span.row];
+				imag[b] += row_real * sin_y[b][span.row] + row_imag * cos_y[b][span.row];
+			}
+		}
+
+		for(unsigned int b = 0; b < n; b++)
+			vis[block + b] = complex<double>(real[b], imag[b]);
+	}
+}
+
+/// Computes the (un-normalized) visibilities of all (u,v) points with the NUFFT.
+void CVisibilityEngine::TransformNUFFT(const float * image, vector<complex<double> > & vis)
+{
+	// (u,v) points per work item
+	const unsigned int chunk_size = 256;
+
+	const unsigned int n_uv = mUV.size();
+	const unsigned int taps = mKernelWidth + 1;
+	const unsigned int grid_width = mGridWidth;
+	const unsigned int grid_height = mGridHeight;
+	// The grid sizes are powers of two, thus "& (size - 1)" wraps indices
+	// (including negative ones) onto the grid.
+	const int mask_x = grid_width - 1;
+	const int mask_y = grid_height - 1;
+
+	// Deconvolve the non-zero pixels and place them on the grid.
+	mGrid.assign(size_t(grid_width) * grid_height, complex<double>(0, 0));
+	vector<unsigned int> rows;
+	for(const auto & span: mSpans)
+	{
+		const unsigned int grid_row = (span.row - int(mHeight / 2)) & mask_y;
+		rows.push_back(grid_row);
+
+		const float * pixels = image + size_t(span.row) * mWidth;
+		complex<double> * grid = &mGrid[size_t(grid_row) * grid_width];
+		for(int i = span.start; i < span.end; i++)
+			grid[(i - int(mWidth / 2)) & mask_x] = double(pixels[i]) * mCorrectionX[i] * mCorrectionY[span.row];
+	}
+
+	// Two dimensional FFT. Only the occupied rows need to be transformed.
+	QtConcurrent::blockingMap(rows, [this, grid_width](unsigned int & row)
+	{
+		FFT(&mGrid[size_t(row) * grid_width], grid_width, mFFTTwiddleX);
+	});
+
+	vector<unsigned int> columns(grid_width);
+	iota(columns.begin(), columns.end(), 0);
+	QtConcurrent::blockingMap(columns, [this, grid_width, grid_height](unsigned int & column)
+	{
+		vector<complex<double> > values(grid_height);
+		for(unsigned int j = 0; j < grid_height; j++)
+			values[j] = mGrid[size_t(j) * grid_width + column];
+
+		FFT(&values[0], grid_height, mFFTTwiddleY);
+
+		for(unsigned int j = 0; j < grid_height; j++)
+			mGrid[size_t(j) * grid_width + column] = values[j];
+	});
+
+	// Interpolate onto the (u,v) points.
+	vector<pair<unsigned int, unsigned int> > chunks;
+	for(unsigned int start = 0; start < n_uv; start += chunk_size)
+		chunks.push_back(make_pair(start, min(start + chunk_size, n_uv)));
+
+	QtConcurrent::blockingMap(chunks, [&](pair<unsigned int, unsigned int> & chunk)
+	{
+		for(unsigned int k = chunk.first; k < chunk.second; k++)
+		{
+			const double * taps_x = &mTapsX[size_t(k) * taps];
+			const double * taps_y = &mTapsY[size_t(k) * taps];
+
+			complex<double> sum = 0;
+			for(unsigned int b = 0; b < taps; b++)
+			{
+				const complex<double> * grid = &mGrid[size_t((mTapStartY[k] + int(b)) & mask_y) * grid_width];
+
+				complex<double> row_sum = 0;
+				for(unsigned int a = 0; a < taps; a++)
+					row_sum += grid[(mTapStartX[k] + int(a)) & mask_x] * taps_x[a];
+
+				sum += row_sum * taps_y[b];
+			}
+
+			vis[k] = sum * mShift[k];
+		}
+	});
+}
@@ -0,0 +1,135 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2015 Brian Kloppenborg
+ */
+
+#ifndef CVISIBILITYENGINE_H_
+#define CVISIBILITYENGINE_H_
+
+#include <complex>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/// The non-zero pixels [start, end) of one image row.
+struct CVisibilitySpan
+{
+	int row;
+	int start;
+	int end;
+};
+
+/// \brief Computes the complex visibilities of an image on the CPU.
+///
+/// Two transforms are available:
+///  - A direct Fourier transform at each (u,v) point. The transform is
+///    separable, thus for each (u,v) point the exponentials along the image
+///    rows and columns (the twiddle factors) are precomputed.
+///  - A non-uniform FFT (type 2). The image is divided by the Fourier
+///    transform of a Kaiser-Bessel kernel, zero-padded onto a grid
+///    `oversampling` times larger, transformed with an FFT, and interpolated
+///    onto the (u,v) points with the kernel. The error decreases with the
+///    oversampling factor and the kernel width.
+/// By default the cheaper of the two is chosen from the image size and the
+/// number of (u,v) points. The geometry dependent tables are computed when
+/// the geometry is set and reused until it changes. The work is divided
+/// among the threads of the global thread pool.
+///
+/// Compact models fill only a small part of the image, so both transforms
+/// only visit the span of non-zero pixels in each row of the occupied region.
+/// The twiddle factors are indexed by absolute pixel position, thus skipping
+/// pixels needs no phase correction.
+///
+/// Pixels are centered at ((i + 0.5 - width/2) * scale, (j + 0.5 - height/2) * scale)
+/// (mas) and rows are stored bottom-up as returned by glReadPixels. The sign
+/// convention matches `CModel::AddVisibilities`.
+class CVisibilityEngine
+{
+public:
+	enum Methods
+	{
+		METHOD_AUTO,
+		METHOD_DFT,
+		METHOD_NUFFT
+	};
+
+protected:
+	unsigned int mWidth;
+	unsigned int mHeight;
+	double mScale;
+	vector<pair<double,double> > mUV;
+
+	Methods mMethod;
+	double mOversampling;
+	unsigned int mKernelWidth;
+	bool mUseNUFFT;	///< The transform selected for the current geometry
+
+	// DFT twiddle factors, [uv][column] and [uv][row], stored as separate
+	// real and imaginary arrays so the inner loops vectorize. If the tables
+	// would exceed mCacheLimit (bytes) they are computed on the fly instead.
+	size_t mCacheLimit;
+	bool mCacheDFT;
+	vector<float> mCosX;
+	vector<float> mSinX;
+	vector<double> mCosY;
+	vector<double> mSinY;
+
+	// NUFFT grid size, deconvolution factors for each image column and row,
+	// and the kernel taps ([uv][tap]) starting at grid index mTapStart[uv].
+	unsigned int mGridWidth;
+	unsigned int mGridHeight;
+	vector<double> mCorrectionX;
+	vector<double> mCorrectionY;
+	vector<int> mTapStartX;
+	vector<int> mTapStartY;
+	vector<double> mTapsX;
+	vector<double> mTapsY;
+	vector<complex<double> > mShift;	///< Phase of the pixel centers relative to the grid
+	vector<complex<double> > mFFTTwiddleX;
+	vector<complex<double> > mFFTTwiddleY;
+	vector<complex<double> > mGrid;
+
+	vector<CVisibilitySpan> mSpans;	///< Non-zero rows of the current image
+
+public:
+	CVisibilityEngine();
+	virtual ~CVisibilityEngine();
+
+	void GetVisibilities(const float * image, const int region[4], vector<complex<double> > & vis);
+
+	void SetGeometry(const vector<pair<double,double> > & uv, unsigned int width,
+			unsigned int height, double scale);
+	void SetMethod(Methods method, double oversampling, unsigned int kernel_width);
+	void SetCacheLimit(size_t bytes);
+
+	bool UsesNUFFT() { return mUseNUFFT; };
+
+protected:
+	static void FFT(complex<double> * data, unsigned int n, const vector<complex<double> > & twiddle);
+	static double KaiserBessel(double x, double width, double beta);
+	static double KaiserBesselTransform(double f, double width, double beta);
+
+	void DFTTwiddles(unsigned int k, float * cos_x, float * sin_x, double * cos_y, double * sin_y);
+	void Setup();
+	void SetupDFT();
+	void SetupNUFFT();
+	void TransformDFT(const float * image, unsigned int start, unsigned int end, vector<complex<double> > & vis);
+	void TransformNUFFT(const float * image, vector<complex<double> > & vis);
+};
+
+#endif /* CVISIBILITYENGINE_H_ */
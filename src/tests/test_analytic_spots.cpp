@@ -0,0 +1,190 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2015 Brian Kloppenborg
+ */
+
+// Compares the flux removed by an analytic spot evaluated in the fragment
+// shader (GPU) with the flux removed by a uniform spot of the same size
+// composed into the surface temperatures (CPU). Requires an OpenGL 3.2
+// context, i.e. a display.
+
+#include <QApplication>
+#include <QGLFormat>
+#include <QGLWidget>
+#include <QGLFramebufferObject>
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CModel.h"
+#include "CModelList.h"
+#include "models/load_models.h"
+#include "features/load_features.h"
+#include "positions/load_positions.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+// Normally defined in main.h
+string EXE_FOLDER;
+
+const unsigned int IMAGE_SIZE = 256;
+const double IMAGE_SCALE = 0.025;	// mas / pixel
+const double WAVELENGTH = 1.6E-6;	// meters
+
+/// Returns a parameter in the format read by CParameterMap::restore.
+Json::Value Parameter(double value, double min, double max)
+{
+	Json::Value parameter(Json::arrayValue);
+	parameter.append(value);
+	parameter.append(min);
+	parameter.append(max);
+	parameter.append(false);
+	parameter.append(1.0);
+	return parameter;
+}
+
+/// Creates a spherical Roche rotator carrying one spot of the specified
+/// type. An empty `feature_id` gives an unspotted star.
+CModelListPtr CreateModels(const string & feature_id)
+{
+	Json::Value model;
+	model["base_id"] = "roche_rotator";
+	model["base_data"]["r_pole"] = Parameter(2.0, 1, 10);
+	model["base_data"]["omega_rot"] = Parameter(0.0, 0, 1);
+	model["base_data"]["T_eff_pole"] = Parameter(6000, 2E3, 1E6);
+	model["base_data"]["n_side_power"] = Parameter(6, 1, 10);
+	model["base_data"]["inclination"] = Parameter(30, 0, 180);
+	model["position_id"] = "xy";
+	model["shader_id"] = "default";
+
+	if(feature_id.size() > 0)
+	{
+		model["feature_0_id"] = feature_id;
+		model["feature_0_data"]["theta"] = Parameter(60, 0, 180);
+		model["feature_0_data"]["phi"] = Parameter(20, 0, 180);
+		model["feature_0_data"]["radius"] = Parameter(15, 0, 90);
+		model["feature_0_data"]["delta_T"] = Parameter(-1500, -2000, 2000);
+	}
+
+	Json::Value input;
+	input["model_0"] = model;
+
+	CModelListPtr model_list = make_shared<CModelList>();
+	model_list->Restore(input);
+	model_list->SetImageScale(IMAGE_SCALE);
+	model_list->SetWavelength(WAVELENGTH);
+	model_list->SetTime(0);
+	return model_list;
+}
+
+/// Renders the models and returns the total flux of the image, computed as in
+/// CPhotometry::SimulatePhotometry.
+double RenderedFlux(CModelListPtr model_list)
+{
+	QGLFramebufferObject fbo(IMAGE_SIZE, IMAGE_SIZE, QGLFramebufferObject::Depth,
+			GL_TEXTURE_2D, GL_RGBA32F);
+	fbo.bind();
+
+	glViewport(0, 0, IMAGE_SIZE, IMAGE_SIZE);
+	const double half_width = IMAGE_SIZE * IMAGE_SCALE / 2;
+	const glm::mat4 view = glm::ortho(-half_width, half_width, -half_width, half_width, -500.0, 500.0);
+
+	const double max_flux = model_list->Render(view);
+
+	vector<float> pixels(IMAGE_SIZE * IMAGE_SIZE);
+	glReadPixels(0, 0, IMAGE_SIZE, IMAGE_SIZE, GL_RED, GL_FLOAT, &pixels[0]);
+	fbo.release();
+
+	double flux = 0;
+	for(auto pixel: pixels)
+		flux += pixel;
+
+	return max_flux * flux;
+}
+
+int main(int argc, char ** argv)
+{
+	QApplication app(argc, argv);
+	EXE_FOLDER = app.applicationDirPath().toStdString();
+
+	QGLFormat format;
+	format.setVersion(3, 2);
+	format.setProfile(QGLFormat::CoreProfile);
+	QGLFormat::setDefaultFormat(format);
+
+	QGLWidget widget;
+	widget.makeCurrent();
+	if(!widget.isValid())
+	{
+		cerr << "test_analytic_spots: could not create an OpenGL context" << endl;
+		return 1;
+	}
+
+	// The same state as CWorkerThread::run
+	glDisable(GL_DITHER);
+	glEnable(GL_DEPTH_TEST);
+	glFrontFace(GL_CCW);
+	glCullFace(GL_BACK);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	models::load();
+	features::load();
+	positions::load();
+
+	CModelListPtr unspotted = CreateModels("");
+	CModelListPtr cpu_spot = CreateModels("uniform_spot");
+	CModelListPtr gpu_spot = CreateModels("analytic_spot");
+
+	// Flux removed by the spot, rendered with the spot on the GPU and
+	// integrated with the spot composed on the CPU.
+	const double gpu_deficit = RenderedFlux(unspotted) - RenderedFlux(gpu_spot);
+	const double cpu_deficit = unspotted->GetFlux() - cpu_spot->GetFlux();
+	// The same spot on the CPU evaluated at the facet centers (IntegrateFlux)
+	const double cpu_analytic_deficit = unspotted->GetFlux() - gpu_spot->GetFlux();
+
+	cout << "Spot deficit (GPU, analytic spot): " << gpu_deficit << endl;
+	cout << "Spot deficit (CPU, uniform spot):  " << cpu_deficit << endl;
+	cout << "Spot deficit (CPU, analytic spot): " << cpu_analytic_deficit << endl;
+
+	// The CPU spots follow the facet boundaries, the GPU spot is exact.
+	const double tolerance = 0.05;
+	int errors = 0;
+	if(!(cpu_deficit > 0) || fabs(gpu_deficit - cpu_deficit) > tolerance * cpu_deficit)
+	{
+		cerr << "The GPU and CPU spots remove different amounts of flux" << endl;
+		errors++;
+	}
+
+	if(fabs(cpu_analytic_deficit - cpu_deficit) > tolerance * cpu_deficit)
+	{
+		cerr << "The analytic and uniform spots differ on the CPU" << endl;
+		errors++;
+	}
+
+	if(errors == 0)
+		cout << "test_analytic_spots: passed" << endl;
+
+	return (errors == 0) ? 0 : 1;
+}
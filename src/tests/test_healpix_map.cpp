@@ -0,0 +1,113 @@
+ /*
+ * This file is part of the SImulation and Modeling Tool for Optical
+ * Interferometry (SIMTOI).
+ *
+ * SIMTOI is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation version 3.
+ *
+ * SIMTOI is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SIMTOI.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2015 Brian Kloppenborg
+ */
+
+// Round-trips NESTED and RING ordered Healpix FITS maps through CHealpixMap.
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chealpix.h"
+#include "features/CHealpixMap.h"
+
+using namespace std;
+
+// Normally defined in main.h
+string EXE_FOLDER = ".";
+
+/// Exposes the source map read by CHealpixMap.
+class CHealpixMapTest : public CHealpixMap
+{
+public:
+	long nSide() { return mSourceNSide; }
+	long nPixels() { return mSourcePixels; }
+	const float * source() { return mSource; }
+};
+
+/// Writes a map with n_side = 8 in the specified ordering, reads it back, and
+/// checks the resolution and the (NESTED) pixel values. Returns the number of
+/// errors.
+int RoundTrip(bool nested)
+{
+	const long n_side = 8;
+	const long n_pixels = nside2npix(n_side);
+	const string filename = nested ? "test_healpix_map_nest.fits" : "test_healpix_map_ring.fits";
+
+	// The value of each pixel is its NESTED index.
+	vector<float> map(n_pixels);
+	long index = 0;
+	for(long i = 0; i < n_pixels; i++)
+	{
+		index = i;
+		if(!nested)
+			ring2nest(n_side, i, &index);
+
+		map[i] = index;
+	}
+
+	// The leading '!' asks cfitsio to overwrite an existing file.
+	char coordsys[] = "C";
+	write_healpix_map(map.data(), n_side, ("!" + filename).c_str(), nested ? 1 : 0, coordsys);
+
+	CHealpixMapTest feature;
+	int errors = 0;
+	try
+	{
+		feature.open(filename);
+	}
+	catch(exception & e)
+	{
+		cerr << filename << ": " << e.what() << endl;
+		remove(filename.c_str());
+		return 1;
+	}
+
+	if(feature.nSide() != n_side || feature.nPixels() != n_pixels)
+	{
+		cerr << filename << ": read n_side = " << feature.nSide() << ", n_pixels = "
+			 << feature.nPixels() << ", expected " << n_side << ", " << n_pixels << endl;
+		errors++;
+	}
+	else
+	{
+		for(long i = 0; i < n_pixels; i++)
+		{
+			if(feature.source()[i] != float(i))
+			{
+				cerr << filename << ": pixel " << i << " is " << feature.source()[i] << endl;
+				errors++;
+				break;
+			}
+		}
+	}
+
+	remove(filename.c_str());
+	return errors;
+}
+
+int main(int argc, char ** argv)
+{
+	int errors = RoundTrip(true) + RoundTrip(false);
+
+	if(errors == 0)
+		cout << "test_healpix_map: passed" << endl;
+
+	return (errors == 0) ? 0 : 1;
+}